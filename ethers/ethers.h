@@ -17,6 +17,7 @@ FOUNDATION_EXPORT const unsigned char ethersVersionString[];
 #import <ethers/Account.h>
 #import <ethers/Address.h>
 #import <ethers/BlockInfo.h>
+#import <ethers/CompactTransaction.h>
 #import <ethers/Hash.h>
 #import <ethers/Payment.h>
 #import <ethers/Signature.h>
@@ -27,14 +28,20 @@ FOUNDATION_EXPORT const unsigned char ethersVersionString[];
 //#import <ethers/EtherchainProvider.h>
 #import <ethers/EtherscanProvider.h>
 #import <ethers/InfuraProvider.h>
+#import <ethers/IpcProvider.h>
 #import <ethers/JsonRpcProvider.h>
+#import <ethers/WebSocketProvider.h>
 
+#import <ethers/CachingProvider.h>
 #import <ethers/FallbackProvider.h>
 //#import <ethers/LightClientProvider.h>
 #import <ethers/Provider.h>
+#import <ethers/ProviderMetrics.h>
 #import <ethers/RoundRobinProvider.h>
 
 #import <ethers/BigNumber.h>
+#import <ethers/InternTable.h>
 #import <ethers/Promise.h>
+#import <ethers/PromiseTracer.h>
 #import <ethers/RLPSerialization.h>
 #import <ethers/SecureData.h>
@@ -37,6 +37,8 @@
 
 #import <Foundation/Foundation.h>
 
+#import "InternTable.h"
+
 
 @interface Address : NSObject <NSCoding, NSCopying>
 
@@ -45,6 +47,11 @@
 + (instancetype)addressWithString: (NSString*)addressString;
 + (instancetype)addressWithData: (NSData*)addressData;
 
+// When enabled, equal addresses created by addressWithString: and addressWithData:
+// share a single instance (disabled by default)
++ (void)setInterningEnabled: (BOOL)enabled;
++ (InternTable*)internTable;
+
 @property (nonatomic, readonly) NSString *checksumAddress;
 @property (nonatomic, readonly) NSString *icapAddress;
 
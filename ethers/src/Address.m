@@ -29,6 +29,10 @@
 #import "RegEx.h"
 #import "SecureData.h"
 
+#include <stdatomic.h>
+
+#include "sha3.h"
+
 
 int ibanChecksum(NSString *address) {
     static BigNumber *constantNintySeven = nil;
@@ -70,56 +74,101 @@ int ibanChecksum(NSString *address) {
 }
 
 
-@implementation Address
+static const char HexLower[] = "0123456789abcdef";
+
+// Writes the EIP-55 checksum address (with 0x prefix and NUL terminator) into output
+static void checksumAddressBytes(const unsigned char *addressBytes, char *output) {
+    output[0] = '0';
+    output[1] = 'x';
+    for (int i = 0; i < 20; i++) {
+        output[2 + 2 * i] = HexLower[addressBytes[i] >> 4];
+        output[3 + 2 * i] = HexLower[addressBytes[i] & 0x0f];
+    }
+    output[42] = 0;
+    
+    unsigned char hashedBytes[32];
+    SHA3_CTX context;
+    keccak_256_Init(&context);
+    keccak_Update(&context, (const unsigned char*)&output[2], 40);
+    keccak_Final(&context, hashedBytes);
+
+    // Uppercase any letters that have its corresponding nibble >= 8 in the hash of the address
+    for (int i = 0; i < 40; i++) {
+        unsigned char nibble = (i & 1) ? (hashedBytes[i >> 1] & 0x0f): (hashedBytes[i >> 1] >> 4);
+        if (nibble >= 8 && output[2 + i] >= 'a') { output[2 + i] -= 0x20; }
+    }
+}
+
+static int hexNibble(char c) {
+    if (c >= '0' && c <= '9') { return c - '0'; }
+    if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+    if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+    return -1;
+}
+
+// Parses a 40 nibble hex address (with optional 0x prefix) into addressBytes, returning
+// the offset of the first nibble in the string, or -1 if the string is not a hex address
+static int parseHexAddress(NSString *addressString, unsigned char *addressBytes, BOOL *mixedCase) {
+    char buffer[43];
+    if (![addressString getCString:buffer maxLength:sizeof(buffer) encoding:NSASCIIStringEncoding]) { return -1; }
+    
+    size_t length = strlen(buffer);
+    int offset = 0;
+    if (length == 42 && buffer[0] == '0' && buffer[1] == 'x') {
+        offset = 2;
+    } else if (length != 40) {
+        return -1;
+    }
+    
+    BOOL hasLower = NO, hasUpper = NO;
+    for (int i = 0; i < 20; i++) {
+        char high = buffer[offset + 2 * i], low = buffer[offset + 2 * i + 1];
+        int highNibble = hexNibble(high), lowNibble = hexNibble(low);
+        if (highNibble < 0 || lowNibble < 0) { return -1; }
+        addressBytes[i] = (highNibble << 4) | lowNibble;
+        
+        if (high >= 'a' || low >= 'a') { hasLower = YES; }
+        if ((high >= 'A' && high <= 'F') || (low >= 'A' && low <= 'F')) { hasUpper = YES; }
+    }
+    
+    if (mixedCase) { *mixedCase = (hasLower && hasUpper); }
+    
+    return offset;
+}
+
+
+@implementation Address {
+    unsigned char _bytes[20];
+    
+    // Computed on first access; most addresses are only ever compared
+    NSString *_checksumAddress;
+}
 
 static Address *ZeroAddress = nil;
 
-static RegEx *HexAddressRegex = nil;
 static RegEx *IcapAddressRegex = nil;
-static RegEx *MixedCaseAddressRegex = nil;
+
+static InternTable *AddressInternTable = nil;
+static atomic_bool InterningEnabled = false;
 
 + (void)initialize {
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        HexAddressRegex = [RegEx regExWithPattern:@"^(0x)?[0-9A-Fa-f]{40}$"];
         IcapAddressRegex = [RegEx regExWithPattern:@"^XE[0-9]{2}[0-9A-Za-z]{30,31}$"];
-        MixedCaseAddressRegex = [RegEx regExWithPattern:@"^.*(([A-F].*[a-f])|([a-f].*[A-F])).*$"];
+        AddressInternTable = [InternTable internTable];
 
         unsigned char nullBytes[20];
         memset(nullBytes, 0, sizeof(nullBytes));
-        ZeroAddress = [Address addressWithData:[NSData dataWithBytes:nullBytes length:sizeof(nullBytes)]];
+        ZeroAddress = [[Address alloc] _initWithBytes:nullBytes];
     });
 }
 
 + (NSString*)_checksumAddressData: (NSData*)addressData {
     if (addressData.length != 20) { return nil; }
     
-    NSString *bareAddress = [[[SecureData dataToHexString:addressData] lowercaseString] substringFromIndex:2];
-    const unsigned char *addressBytes = (const unsigned char*)[bareAddress cStringUsingEncoding:NSASCIIStringEncoding];
-    
-    // With the new SecureData, refactor this
-    NSData *hashed = [SecureData KECCAK256:[[[SecureData dataToHexString:addressData] substringFromIndex:2] dataUsingEncoding:NSASCIIStringEncoding]];
-    const unsigned char *hashedBytes = hashed.bytes;
-    
-    unsigned char bytes[43];
-    bytes[0] = '0';
-    bytes[1] = 'x';
-    bytes[42] = 0;
-    
-    for (int i = 0; i < 40; i += 2) {
-        bytes[i + 2] = addressBytes[i];
-        bytes[i + 3] = addressBytes[i + 1];
-        
-        // Uppercase any bytes that have its corresponding byte >= 8 in the hash of the address
-        if ((hashedBytes[i >> 1] >> 4) >= 8 && bytes[i + 2] >= 'a') {
-            bytes[i + 2] -= 0x20;
-        }
-        if ((hashedBytes[i >> 1] & 0x0f) >= 8 && bytes[i + 3] >= 'a') {
-            bytes[i + 3] -= 0x20;
-        }
-    }
-    
-    return [NSString stringWithCString:(const char*)bytes encoding:NSASCIIStringEncoding];
+    char bytes[43];
+    checksumAddressBytes(addressData.bytes, bytes);
+    return [NSString stringWithCString:bytes encoding:NSASCIIStringEncoding];
 }
 
 
@@ -132,24 +181,25 @@ static RegEx *MixedCaseAddressRegex = nil;
 
     NSString *result = nil;
     
-    if ([HexAddressRegex matchesExactly:address]) {
-        
-        // Add the 0x prefix if not present
-        if (![address hasPrefix:@"0x"]) {
-            address = [@"0x" stringByAppendingString:address];
-        }
+    unsigned char addressBytes[20];
+    BOOL mixedCase = NO;
+    int offset = parseHexAddress(address, addressBytes, &mixedCase);
+    
+    if (offset >= 0) {
         
         // Compute the checksum address
-        NSString *checksumAddress = [Address _checksumAddressData:[SecureData hexStringToData:address]];
+        char checksumAddress[43];
+        checksumAddressBytes(addressBytes, checksumAddress);
         
         // If this address is checksummed, fail if the checksum if wrong
-        if ([MixedCaseAddressRegex matchesExactly:address]) {
-            if (![checksumAddress isEqualToString:address]) {
+        if (mixedCase) {
+            const char *addressString = [address cStringUsingEncoding:NSASCIIStringEncoding];
+            if (memcmp(&addressString[offset], &checksumAddress[2], 40)) {
                 return nil;
             }
         }
         
-        result = checksumAddress;
+        result = [NSString stringWithCString:checksumAddress encoding:NSASCIIStringEncoding];
         
     } else if ([IcapAddressRegex matchesExactly:address]) {
         
@@ -178,30 +228,85 @@ static RegEx *MixedCaseAddressRegex = nil;
 
 #pragma mark - Life-Cycle
 
-- (instancetype)initWithString: (NSString*)addressString {
+- (instancetype)_initWithBytes: (const unsigned char*)addressBytes {
     self = [super init];
     if (self) {
-        _checksumAddress = [Address normalizeAddress:addressString icap:NO];
-        if (!_checksumAddress) { return nil; }
+        memcpy(_bytes, addressBytes, sizeof(_bytes));
+    }
+    return self;
+}
+
+- (instancetype)initWithString: (NSString*)addressString {
+    if (!addressString) { return nil; }
+    
+    unsigned char addressBytes[20];
+    BOOL mixedCase = NO;
+    int offset = parseHexAddress(addressString, addressBytes, &mixedCase);
+    
+    // Checksummed and ICAP addresses must be verified up front; plain hex addresses
+    // defer the checksum until something asks for it
+    NSString *checksumAddress = nil;
+    if (offset < 0 || mixedCase) {
+        checksumAddress = [Address normalizeAddress:addressString icap:NO];
+        if (!checksumAddress) { return nil; }
+        if (offset < 0) { parseHexAddress(checksumAddress, addressBytes, NULL); }
+    }
+    
+    self = [self _initWithBytes:addressBytes];
+    if (self) {
+        _checksumAddress = checksumAddress;
     }
     return self;
 }
 
 + (instancetype)addressWithString:(NSString *)addressString {
-    return [[Address alloc] initWithString:addressString];
+    Address *address = [[Address alloc] initWithString:addressString];
+    if (!address || !atomic_load_explicit(&InterningEnabled, memory_order_relaxed)) { return address; }
+    
+    // The string still needs to be parsed (and possibly verified), so intern after
+    return [AddressInternTable internObject:address bytes:address->_bytes length:sizeof(address->_bytes)];
 }
 
 + (instancetype)addressWithData:(NSData *)addressData {
     if (addressData.length != 20) { return nil; }
-    return [[Address alloc] initWithString:[SecureData dataToHexString:addressData]];
+    
+    if (!atomic_load_explicit(&InterningEnabled, memory_order_relaxed)) {
+        return [[Address alloc] _initWithBytes:addressData.bytes];
+    }
+    
+    Address *address = [AddressInternTable objectForBytes:addressData.bytes length:20];
+    if (address) { return address; }
+    
+    address = [[Address alloc] _initWithBytes:addressData.bytes];
+    return [AddressInternTable internMissedObject:address bytes:address->_bytes length:sizeof(address->_bytes)];
+}
+
++ (void)setInterningEnabled: (BOOL)enabled {
+    atomic_store_explicit(&InterningEnabled, enabled, memory_order_relaxed);
+    if (!enabled) { [AddressInternTable removeAllObjects]; }
+}
+
++ (InternTable*)internTable {
+    return AddressInternTable;
 }
 
 + (Address*)zeroAddress {
     return ZeroAddress;
 }
 
+- (NSString*)checksumAddress {
+    @synchronized (self) {
+        if (!_checksumAddress) {
+            char bytes[43];
+            checksumAddressBytes(_bytes, bytes);
+            _checksumAddress = [NSString stringWithCString:bytes encoding:NSASCIIStringEncoding];
+        }
+        return _checksumAddress;
+    }
+}
+
 - (NSString*)icapAddress {
-    return [Address normalizeAddress:_checksumAddress icap:YES];
+    return [Address normalizeAddress:self.checksumAddress icap:YES];
 }
 
 - (BOOL)isZeroAddress {
@@ -209,7 +314,7 @@ static RegEx *MixedCaseAddressRegex = nil;
 }
 
 - (NSData*)data {
-    return [SecureData hexStringToData:_checksumAddress];
+    return [NSData dataWithBytes:_bytes length:sizeof(_bytes)];
 }
 
 
@@ -228,19 +333,23 @@ static RegEx *MixedCaseAddressRegex = nil;
 }
 
 - (void)encodeWithCoder:(NSCoder *)aCoder {
-    [aCoder encodeObject:_checksumAddress forKey:@"address"];
+    [aCoder encodeObject:self.checksumAddress forKey:@"address"];
 }
 
 
 #pragma mark - NSObject
 
 - (NSUInteger)hash {
-    return [_checksumAddress hash];
+    // Addresses are (effectively) uniformly distributed, so any 8 bytes make a good hash
+    NSUInteger hash;
+    memcpy(&hash, &_bytes[12], sizeof(hash));
+    return hash;
 }
 
 - (BOOL)isEqual:(id)object {
+    if (object == self) { return YES; }
     if (![object isKindOfClass:[Address class]]) { return NO; }
-    return [_checksumAddress isEqualToString:((Address*)object).checksumAddress];
+    return (memcmp(_bytes, ((Address*)object)->_bytes, sizeof(_bytes)) == 0);
 }
 
 - (BOOL)isEqualToAddress:(Address*)address {
@@ -248,7 +357,7 @@ static RegEx *MixedCaseAddressRegex = nil;
 }
 
 - (NSString*)description {
-    return _checksumAddress;
+    return self.checksumAddress;
 }
 
 @end
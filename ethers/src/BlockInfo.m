@@ -31,59 +31,78 @@
 
 static NSData *NullData = nil;
 
+// Compiled once; every block fetched is parsed with these
+static QueryPath *HashPath = nil;
+static QueryPath *NumberPath = nil;
+static QueryPath *ParentHashPath = nil;
+static QueryPath *TimestampPath = nil;
+static QueryPath *NoncePath = nil;
+static QueryPath *ExtraDataPath = nil;
+static QueryPath *GasLimitPath = nil;
+static QueryPath *GasUsedPath = nil;
+
 + (void)initialize {
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
         NullData = [NSData data];
+
+        HashPath = [QueryPath queryPathWithString:@"dictionary:hash/hash"];
+        NumberPath = [QueryPath queryPathWithString:@"dictionary:number/integer"];
+        ParentHashPath = [QueryPath queryPathWithString:@"dictionary:parentHash/hash"];
+        TimestampPath = [QueryPath queryPathWithString:@"dictionary:timestamp/integer"];
+        NoncePath = [QueryPath queryPathWithString:@"dictionary:nonce/integer"];
+        ExtraDataPath = [QueryPath queryPathWithString:@"dictionary:extraData/data"];
+        GasLimitPath = [QueryPath queryPathWithString:@"dictionary:gasLimit/bigNumber"];
+        GasUsedPath = [QueryPath queryPathWithString:@"dictionary:gasUsed/bigNumber"];
     });
 }
 
 - (instancetype)initWithDictionary: (NSDictionary*)info {
     self = [super init];
     if (self) {        
-        _blockHash = queryPath(info, @"dictionary:hash/hash");
+        _blockHash = [HashPath queryObject:info];
         if (!_blockHash) {
             NSLog(@"ERROR: Missing hash");
             return nil;
         }
         
-        NSNumber *blockNumber = queryPath(info, @"dictionary:number/integer");
+        NSNumber *blockNumber = [NumberPath queryObject:info];
         if (!blockNumber) {
             NSLog(@"ERROR: Missing blockNumber");
             return nil;
         }
         _blockNumber = [blockNumber integerValue];
         
-        _parentHash = queryPath(info, @"dictionary:parentHash/hash");
+        _parentHash = [ParentHashPath queryObject:info];
         if (!_blockHash) {
             NSLog(@"ERROR: Missing hash");
             return nil;
         }
 
-        NSNumber *timestamp = queryPath(info, @"dictionary:timestamp/integer");
+        NSNumber *timestamp = [TimestampPath queryObject:info];
         if (!timestamp) {
             NSLog(@"ERROR: Missing timestamp");
             return nil;
         }
         _timestamp = [timestamp longLongValue];
 
-        NSNumber *nonce = queryPath(info, @"dictionary:nonce/integer");
+        NSNumber *nonce = [NoncePath queryObject:info];
         if (!nonce) {
             NSLog(@"ERROR: Missing nonce");
             return nil;
         }
         _nonce = [nonce integerValue];
         
-        _extraData = queryPath(info, @"dictionary:extraData/data");
+        _extraData = [ExtraDataPath queryObject:info];
         if (!_extraData) { _extraData = NullData; }
 
-        _gasLimit = queryPath(info, @"dictionary:gasLimit/bigNumber");
+        _gasLimit = [GasLimitPath queryObject:info];
         if (!_gasLimit) {
             NSLog(@"ERROR: Missing gasLimit");
             return nil;
         }
         
-        _gasUsed = queryPath(info, @"dictionary:gasUsed/bigNumber");
+        _gasUsed = [GasUsedPath queryObject:info];
         if (!_gasUsed) {
             NSLog(@"ERROR: Missing gasUsed");
             return nil;
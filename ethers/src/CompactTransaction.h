@@ -0,0 +1,110 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ *  CompactTransaction
+ *
+ *  An immutable, memory-compact representation of a Transaction, intended for
+ *  holding large numbers of transactions in memory (e.g. a pool of pending
+ *  transactions).
+ *
+ *  The fixed-size fields are stored inline in the object (256-bit quantities
+ *  as 32 big-endian bytes, addresses as 20 bytes and the signature as 65 bytes)
+ *  rather than as BigNumber, Address and Signature objects. The variable length
+ *  data payload is stored as a slice of a shared TransactionDataArena, so
+ *  many transactions share a few large allocations.
+ *
+ *  The richer objects (BigNumber, Address, ...) are created on demand from the
+ *  inline fields, so this is best suited to storage, not heavy computation.
+ */
+
+#import <Foundation/Foundation.h>
+
+#import "Address.h"
+#import "BigNumber.h"
+#import "Hash.h"
+#import "Signature.h"
+#import "Transaction.h"
+
+
+#pragma mark -
+#pragma mark - TransactionDataArena
+
+/**
+ *  An append-only arena of transaction data payloads. Slices are never moved or
+ *  freed individually; the memory is released once the arena and every
+ *  CompactTransaction referencing it have been released.
+ *
+ *  All operations are thread-safe.
+ */
+
+@interface TransactionDataArena : NSObject
+
++ (instancetype)arena;
++ (instancetype)arenaWithChunkSize: (NSUInteger)chunkSize;
+
+// The default arena, used when no arena is specified
++ (TransactionDataArena*)sharedArena;
+
+@property (nonatomic, readonly) NSUInteger chunkSize;
+
+// Total bytes allocated from the system and total bytes used by slices
+@property (atomic, readonly) NSUInteger allocatedBytes;
+@property (atomic, readonly) NSUInteger usedBytes;
+
+@end
+
+
+#pragma mark -
+#pragma mark - CompactTransaction
+
+@interface CompactTransaction : NSObject <NSCopying>
+
++ (instancetype)compactTransactionWithTransaction: (Transaction*)transaction;
++ (instancetype)compactTransactionWithTransaction: (Transaction*)transaction arena: (TransactionDataArena*)arena;
+
+// Returns a new (mutable) Transaction, with the same signature and from address
+- (Transaction*)transaction;
+
+@property (nonatomic, readonly) NSUInteger nonce;
+
+@property (nonatomic, readonly) BigNumber *gasPrice;
+@property (nonatomic, readonly) BigNumber *gasLimit;
+
+@property (nonatomic, readonly) Address *toAddress;
+@property (nonatomic, readonly) BigNumber *value;
+@property (nonatomic, readonly) NSData *data;
+@property (nonatomic, readonly) NSUInteger dataLength;
+
+@property (nonatomic, readonly) Signature *signature;
+@property (nonatomic, readonly) Address *fromAddress;
+
+@property (nonatomic, readonly) ChainId chainId;
+
+- (NSData*)serialize;
+
+- (Hash*)transactionHash;
+
+@end
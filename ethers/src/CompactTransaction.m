@@ -0,0 +1,376 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import "CompactTransaction.h"
+
+
+#define DefaultChunkSize            (64 * 1024)
+
+// Payloads larger than this fraction of a chunk get a dedicated allocation
+#define DedicatedChunkDivisor       4
+
+
+#pragma mark -
+#pragma mark - Signature
+
+@interface Signature (private)
+
++ (instancetype)signatureWithData: (NSData*)data v: (char)v;
+
+@end
+
+
+#pragma mark -
+#pragma mark - Transaction
+
+@interface Transaction (private)
+
+- (void)_setSignature: (Signature*)signature;
+
+@end
+
+
+#pragma mark -
+#pragma mark - TransactionDataArena
+
+@interface TransactionDataArena (private)
+
+- (NSData*)_storeBytes: (const void*)bytes length: (NSUInteger)length offset: (uint32_t*)offset;
+
+@end
+
+
+@implementation TransactionDataArena {
+    NSMutableData *_currentChunk;
+    NSUInteger _currentOffset;
+}
+
+- (instancetype)initWithChunkSize: (NSUInteger)chunkSize {
+    self = [super init];
+    if (self) {
+        _chunkSize = (chunkSize ? chunkSize: DefaultChunkSize);
+    }
+    return self;
+}
+
++ (instancetype)arena {
+    return [[TransactionDataArena alloc] initWithChunkSize:DefaultChunkSize];
+}
+
++ (instancetype)arenaWithChunkSize: (NSUInteger)chunkSize {
+    return [[TransactionDataArena alloc] initWithChunkSize:chunkSize];
+}
+
++ (TransactionDataArena*)sharedArena {
+    static TransactionDataArena *sharedArena = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedArena = [TransactionDataArena arena];
+    });
+    return sharedArena;
+}
+
+// Copies bytes into the arena, returning the chunk that holds them. The chunk
+// length is fixed at allocation, so its bytes never move.
+- (NSData*)_storeBytes: (const void*)bytes length: (NSUInteger)length offset: (uint32_t*)offset {
+    if (length == 0) { return nil; }
+    
+    @synchronized (self) {
+        _usedBytes += length;
+        
+        if (length > _chunkSize / DedicatedChunkDivisor) {
+            _allocatedBytes += length;
+            *offset = 0;
+            return [NSData dataWithBytes:bytes length:length];
+        }
+        
+        if (!_currentChunk || _currentOffset + length > _chunkSize) {
+            _currentChunk = [NSMutableData dataWithLength:_chunkSize];
+            _currentOffset = 0;
+            _allocatedBytes += _chunkSize;
+        }
+        
+        memcpy(&((uint8_t*)_currentChunk.mutableBytes)[_currentOffset], bytes, length);
+        *offset = (uint32_t)_currentOffset;
+        _currentOffset += length;
+        
+        return _currentChunk;
+    }
+}
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<TransactionDataArena chunkSize=%d allocated=%d used=%d>",
+            (int)_chunkSize, (int)self.allocatedBytes, (int)self.usedBytes];
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - CompactTransaction
+
+typedef NS_OPTIONS(uint8_t, CompactTransactionFlag) {
+    CompactTransactionFlagToAddress      = (1 << 0),
+    CompactTransactionFlagFromAddress    = (1 << 1),
+    CompactTransactionFlagSignature      = (1 << 2),
+};
+
+// Writes a non-negative BigNumber as 32 big-endian bytes
+static BOOL exportBigNumber(BigNumber *value, uint8_t *output) {
+    if (value.isNegative) { return NO; }
+    
+    NSData *data = value.data;
+    
+    // Strip any leading zero padding
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    while (length && bytes[0] == 0) { bytes++; length--; }
+    
+    if (length > 32) { return NO; }
+    
+    memset(output, 0, 32);
+    if (length) { memcpy(&output[32 - length], bytes, length); }
+    
+    return YES;
+}
+
+static BigNumber *importBigNumber(const uint8_t *input) {
+    NSUInteger offset = 0;
+    while (offset < 32 && input[offset] == 0) { offset++; }
+    if (offset == 32) { return [BigNumber constantZero]; }
+    return [BigNumber bigNumberWithData:[NSData dataWithBytes:&input[offset] length:32 - offset]];
+}
+
+
+@implementation CompactTransaction {
+    uint64_t _nonceValue;
+
+    NSData *_dataChunk;
+    uint32_t _dataOffset;
+    uint32_t _dataLength;
+    
+    uint8_t _gasPriceBytes[32];
+    uint8_t _gasLimitBytes[32];
+    uint8_t _valueBytes[32];
+    
+    uint8_t _toAddressBytes[20];
+    uint8_t _fromAddressBytes[20];
+    
+    // r (32 bytes) || s (32 bytes) || v (recovery id)
+    uint8_t _signatureBytes[65];
+    
+    ChainId _chainIdValue;
+    CompactTransactionFlag _flags;
+    
+    // Cached encodings, computed on first use (the fields never change); guarded by @synchronized (self)
+    NSData *_serialized;
+    Hash *_transactionHash;
+}
+
+#pragma mark - Life-Cycle
+
+- (instancetype)initWithTransaction: (Transaction*)transaction arena: (TransactionDataArena*)arena {
+    if (!transaction) { return nil; }
+    
+    self = [super init];
+    if (self) {
+        _nonceValue = transaction.nonce;
+        _chainIdValue = transaction.chainId;
+        
+        if (!exportBigNumber(transaction.gasPrice, _gasPriceBytes)) { return nil; }
+        if (!exportBigNumber(transaction.gasLimit, _gasLimitBytes)) { return nil; }
+        if (!exportBigNumber(transaction.value, _valueBytes)) { return nil; }
+        
+        if (transaction.toAddress) {
+            NSData *toAddress = transaction.toAddress.data;
+            if (toAddress.length != 20) { return nil; }
+            [toAddress getBytes:_toAddressBytes length:20];
+            _flags |= CompactTransactionFlagToAddress;
+        }
+
+        if (transaction.fromAddress) {
+            NSData *fromAddress = transaction.fromAddress.data;
+            if (fromAddress.length != 20) { return nil; }
+            [fromAddress getBytes:_fromAddressBytes length:20];
+            _flags |= CompactTransactionFlagFromAddress;
+        }
+        
+        Signature *signature = transaction.signature;
+        if (signature) {
+            if (signature.r.length != 32 || signature.s.length != 32) { return nil; }
+            [signature.r getBytes:&_signatureBytes[0] length:32];
+            [signature.s getBytes:&_signatureBytes[32] length:32];
+            _signatureBytes[64] = signature.v;
+            _flags |= CompactTransactionFlagSignature;
+        }
+        
+        NSData *data = transaction.data;
+        if (data.length > UINT32_MAX) { return nil; }
+        _dataLength = (uint32_t)data.length;
+        _dataChunk = [arena _storeBytes:data.bytes length:data.length offset:&_dataOffset];
+    }
+    return self;
+}
+
++ (instancetype)compactTransactionWithTransaction: (Transaction*)transaction {
+    return [[CompactTransaction alloc] initWithTransaction:transaction arena:[TransactionDataArena sharedArena]];
+}
+
++ (instancetype)compactTransactionWithTransaction: (Transaction*)transaction arena: (TransactionDataArena*)arena {
+    if (!arena) { arena = [TransactionDataArena sharedArena]; }
+    return [[CompactTransaction alloc] initWithTransaction:transaction arena:arena];
+}
+
+- (Transaction*)transaction {
+    Transaction *transaction = [Transaction transactionWithFromAddress:self.fromAddress];
+    transaction.nonce = self.nonce;
+    transaction.gasPrice = self.gasPrice;
+    transaction.gasLimit = self.gasLimit;
+    transaction.toAddress = self.toAddress;
+    transaction.value = self.value;
+    transaction.data = self.data;
+    transaction.chainId = _chainIdValue;
+    [transaction _setSignature:self.signature];
+    
+    return transaction;
+}
+
+
+#pragma mark - Getters
+
+- (NSUInteger)nonce {
+    return (NSUInteger)_nonceValue;
+}
+
+- (BigNumber*)gasPrice {
+    return importBigNumber(_gasPriceBytes);
+}
+
+- (BigNumber*)gasLimit {
+    return importBigNumber(_gasLimitBytes);
+}
+
+- (BigNumber*)value {
+    return importBigNumber(_valueBytes);
+}
+
+- (Address*)toAddress {
+    if (!(_flags & CompactTransactionFlagToAddress)) { return nil; }
+    return [Address addressWithData:[NSData dataWithBytes:_toAddressBytes length:20]];
+}
+
+- (Address*)fromAddress {
+    if (!(_flags & CompactTransactionFlagFromAddress)) { return nil; }
+    return [Address addressWithData:[NSData dataWithBytes:_fromAddressBytes length:20]];
+}
+
+- (NSData*)data {
+    if (!_dataChunk) { return [NSData data]; }
+    return [_dataChunk subdataWithRange:NSMakeRange(_dataOffset, _dataLength)];
+}
+
+- (NSUInteger)dataLength {
+    return _dataLength;
+}
+
+- (Signature*)signature {
+    if (!(_flags & CompactTransactionFlagSignature)) { return nil; }
+    return [Signature signatureWithData:[NSData dataWithBytes:_signatureBytes length:64] v:_signatureBytes[64]];
+}
+
+- (ChainId)chainId {
+    return _chainIdValue;
+}
+
+- (NSData*)serialize {
+    @synchronized (self) {
+        if (!_serialized) { _serialized = [[self transaction] serialize]; }
+        return _serialized;
+    }
+}
+
+- (Hash*)transactionHash {
+    if (!(_flags & CompactTransactionFlagSignature)) { return nil; }
+    
+    @synchronized (self) {
+        if (!_transactionHash) {
+            NSData *serialized = [self serialize];
+            
+            eth_hash32 hash32;
+            eth_keccak256(serialized.bytes, serialized.length, &hash32);
+            _transactionHash = [Hash hashWithHash32:&hash32];
+        }
+        return _transactionHash;
+    }
+}
+
+
+#pragma mark - NSCopying
+
+- (instancetype)copyWithZone:(NSZone *)zone {
+    return self;
+}
+
+
+#pragma mark - NSObject
+
+- (NSUInteger)hash {
+    NSUInteger result = 0;
+    if (_flags & CompactTransactionFlagSignature) {
+        memcpy(&result, _signatureBytes, sizeof(result));
+    } else {
+        memcpy(&result, _toAddressBytes, sizeof(result));
+    }
+    return result ^ (NSUInteger)_nonceValue;
+}
+
+- (BOOL)isEqual:(id)object {
+    if (object == self) { return YES; }
+    if (![object isKindOfClass:[CompactTransaction class]]) { return NO; }
+    
+    CompactTransaction *other = (CompactTransaction*)object;
+    if (_nonceValue != other->_nonceValue || _chainIdValue != other->_chainIdValue) { return NO; }
+    if (_flags != other->_flags || _dataLength != other->_dataLength) { return NO; }
+    
+    if (memcmp(_gasPriceBytes, other->_gasPriceBytes, 32)) { return NO; }
+    if (memcmp(_gasLimitBytes, other->_gasLimitBytes, 32)) { return NO; }
+    if (memcmp(_valueBytes, other->_valueBytes, 32)) { return NO; }
+    if (memcmp(_toAddressBytes, other->_toAddressBytes, 20)) { return NO; }
+    if (memcmp(_fromAddressBytes, other->_fromAddressBytes, 20)) { return NO; }
+    if (memcmp(_signatureBytes, other->_signatureBytes, 65)) { return NO; }
+    
+    if (_dataLength == 0) { return YES; }
+    
+    return (memcmp(&((const uint8_t*)_dataChunk.bytes)[_dataOffset],
+                   &((const uint8_t*)other->_dataChunk.bytes)[other->_dataOffset], _dataLength) == 0);
+}
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<CompactTransaction to=%@ from=%@ nonce=%d gasPrice=%@ gasLimit=%@ value=%@ dataLength=%d chainId=%d signed=%@>",
+            self.toAddress, self.fromAddress, (int)self.nonce, [self.gasPrice decimalString], [self.gasLimit decimalString],
+            [self.value decimalString], (int)_dataLength, _chainIdValue, ((_flags & CompactTransactionFlagSignature) ? @"YES": @"NO")];
+}
+
+@end
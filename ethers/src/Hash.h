@@ -25,6 +25,33 @@
 
 #import <Foundation/Foundation.h>
 
+#import "InternTable.h"
+
+
+#pragma mark - eth_hash32
+
+// A 32 byte hash (e.g. a Keccak256 digest) as a plain value, for code that would
+// rather not create Objective-C objects per hash
+
+typedef struct eth_hash32 {
+    uint8_t bytes[32];
+} eth_hash32;
+
+static inline BOOL eth_hash32_equal(const eth_hash32 *a, const eth_hash32 *b) {
+    return (memcmp(a->bytes, b->bytes, sizeof(a->bytes)) == 0);
+}
+
+static inline BOOL eth_hash32_is_zero(const eth_hash32 *hash) {
+    uint8_t result = 0;
+    for (size_t i = 0; i < sizeof(hash->bytes); i++) { result |= hash->bytes[i]; }
+    return (result == 0);
+}
+
+void eth_keccak256(const void *bytes, size_t length, eth_hash32 *result);
+
+
+#pragma mark - Hash
+
 @interface Hash : NSObject <NSCopying>
 
 // 0x0000000000000000000000000000000000000000000000000000000000000000 (i.e. 32 bytes of 0; 64 nibbles)
@@ -33,9 +60,16 @@
 
 + (instancetype)hashWithData: (NSData*)data;
 + (instancetype)hashWithHexString: (NSString*)hexString;
++ (instancetype)hashWithHash32: (const eth_hash32*)hash32;
+
+// When enabled, equal hashes created by hashWithData: and hashWithHexString: share
+// a single instance (disabled by default)
++ (void)setInterningEnabled: (BOOL)enabled;
++ (InternTable*)internTable;
 
 @property (nonatomic, readonly) NSData *data;
 @property (nonatomic, readonly) NSString *hexString;
+@property (nonatomic, readonly) eth_hash32 hash32;
 
 - (BOOL)isEqualToHash: (Hash*)hash;
 
@@ -25,50 +25,112 @@
 
 #import "Hash.h"
 
+#include <stdatomic.h>
+
+#include "sha3.h"
+
 #import "SecureData.h"
 
 
+void eth_keccak256(const void *bytes, size_t length, eth_hash32 *result) {
+    SHA3_CTX context;
+    keccak_256_Init(&context);
+    keccak_Update(&context, bytes, length);
+    keccak_Final(&context, result->bytes);
+}
+
+
 static Hash *ZeroHash = nil;
 
+static InternTable *HashInternTable = nil;
+static atomic_bool InterningEnabled = false;
+
 
-@implementation Hash
+@implementation Hash {
+    eth_hash32 _hash32;
+    
+    // Computed on first access; most hashes are only ever compared
+    NSString *_hexString;
+}
 
 + (void)initialize {
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        unsigned char nullBytes[32];
-        memset(nullBytes, 0, sizeof(nullBytes));
-        ZeroHash = [Hash hashWithData:[NSData dataWithBytes:nullBytes length:sizeof(nullBytes)]];
+        eth_hash32 nullHash;
+        memset(&nullHash, 0, sizeof(nullHash));
+        ZeroHash = [[Hash alloc] _initWithHash32:&nullHash];
+        HashInternTable = [InternTable internTable];
     });
 }
 
-- (instancetype)initWithData: (NSData*)data {
-    if (data.length != 32) { return nil; }
-    
+- (instancetype)_initWithHash32: (const eth_hash32*)hash32 {
     self = [super init];
     if (self) {
-        _data = [data copy];
-        _hexString = [SecureData dataToHexString:_data];
+        _hash32 = *hash32;
     }
     return self;
 }
 
+- (instancetype)initWithData: (NSData*)data {
+    if (data.length != 32) { return nil; }
+    return [self _initWithHash32:data.bytes];
+}
+
 - (BOOL)isZeroHash {
-    return [self isEqualToHash:ZeroHash];
+    return eth_hash32_is_zero(&_hash32);
+}
+
++ (instancetype)hashWithHash32: (const eth_hash32*)hash32 {
+    if (!atomic_load_explicit(&InterningEnabled, memory_order_relaxed)) {
+        return [[Hash alloc] _initWithHash32:hash32];
+    }
+    
+    Hash *hash = [HashInternTable objectForBytes:hash32->bytes length:32];
+    if (hash) { return hash; }
+    
+    hash = [[Hash alloc] _initWithHash32:hash32];
+    return [HashInternTable internMissedObject:hash bytes:hash->_hash32.bytes length:32];
 }
 
 + (instancetype)hashWithData: (NSData*)data {
-    return [[Hash alloc] initWithData:data];
+    if (data.length != 32) { return nil; }
+    return [Hash hashWithHash32:data.bytes];
 }
 
 + (instancetype)hashWithHexString: (NSString*)hexString {
-    return [[Hash alloc] initWithData:[SecureData hexStringToData:hexString]];
+    return [Hash hashWithData:[SecureData hexStringToData:hexString]];
+}
+
++ (void)setInterningEnabled: (BOOL)enabled {
+    atomic_store_explicit(&InterningEnabled, enabled, memory_order_relaxed);
+    if (!enabled) { [HashInternTable removeAllObjects]; }
+}
+
++ (InternTable*)internTable {
+    return HashInternTable;
 }
 
 + (Hash*)zeroHash {
     return ZeroHash;
 }
 
+- (eth_hash32)hash32 {
+    return _hash32;
+}
+
+- (NSData*)data {
+    return [NSData dataWithBytes:_hash32.bytes length:sizeof(_hash32.bytes)];
+}
+
+- (NSString*)hexString {
+    @synchronized (self) {
+        if (!_hexString) {
+            _hexString = [SecureData dataToHexString:self.data];
+        }
+        return _hexString;
+    }
+}
+
 
 #pragma mark - NSCopying
 
@@ -84,16 +146,20 @@ static Hash *ZeroHash = nil;
 }
 
 - (BOOL)isEqual:(id)object {
+    if (object == self) { return YES; }
     if (![object isKindOfClass:[Hash class]]) { return NO; }
-    return [_hexString isEqualToString:((Hash*)object).hexString];
+    return eth_hash32_equal(&_hash32, &((Hash*)object)->_hash32);
 }
 
 - (NSUInteger)hash {
-    return [_hexString hash];
+    // Hashes are uniformly distributed, so any word of it is a good hash
+    NSUInteger hash;
+    memcpy(&hash, _hash32.bytes, sizeof(hash));
+    return hash;
 }
 
 - (NSString*)description {
-    return [NSString stringWithFormat:@"<Hash %@>", _hexString];
+    return [NSString stringWithFormat:@"<Hash %@>", self.hexString];
 }
 
 @end
@@ -32,6 +32,7 @@
  */
 
 #import "Provider.h"
+#import "ProviderMetrics.h"
 
 // @TODO: Refactor all thise to be more internal and use queryPath instead. Add (? option all allow nil)
 
@@ -66,6 +67,13 @@ typedef NS_OPTIONS(NSUInteger, ApiProviderFetchType) {
 };
 
 
+typedef NS_ENUM(NSInteger, ApiProviderPriority) {
+    ApiProviderPriorityBackground               = 0,
+    ApiProviderPriorityDefault,
+    ApiProviderPriorityHigh,
+};
+
+
 Class getPromiseClass(ApiProviderFetchType fetchType);
 id coerceValue(NSObject *value, ApiProviderFetchType fetchType);
 
@@ -74,10 +82,109 @@ id coerceValue(NSObject *value, ApiProviderFetchType fetchType);
 //                  bigNumberHex, bigNumberDecimal, data, hash, object
 id queryPath(NSObject *object, NSString *path);
 
+
+// A path (see queryPath) parsed once into its steps, for querying many objects
+@interface QueryPath : NSObject
+
+// Compiled paths are cached, so each path is only parsed once; nil if path is invalid
++ (instancetype)queryPathWithString: (NSString*)path;
+
+@property (nonatomic, readonly) NSString *path;
+
+- (id)queryObject: (NSObject*)object;
+
+@end
+
 @interface ApiProvider : Provider
 
 @property (nonatomic, readonly) NSUInteger requestCount;
 
+
+#pragma mark - Connections
+
+// All requests share one long-lived session, so connections and TLS sessions are reused.
+// Changing these applies to a new session; requests already in flight finish on the old one.
+@property (atomic, assign) NSInteger maximumConnectionsPerHost;     // Default: 6
+@property (atomic, assign) NSTimeInterval requestTimeout;           // Default: 30 seconds
+
+// Lets outstanding requests finish, then releases the session (the next request creates a new one)
+- (void)invalidateSession;
+
+// Cancels outstanding requests (which fail with ProviderErrorServerUnknownError) and releases the session
+- (void)cancelAllRequests;
+
+
+#pragma mark - Scheduling
+
+/**
+ *  Requests wait in a queue until a token is available (a token bucket refilled at
+ *  requestsPerSecond, holding up to burstSize) and fewer than maximumConcurrentRequests
+ *  are in flight. Higher priority requests are started first, and requests of the same
+ *  priority in order. A throttled response (HTTP 429, or a provider's rate limit error)
+ *  pauses the queue for the response's Retry-After (or 1 second).
+ *
+ *  Sending a transaction is always high priority; otherwise, requests take the priority
+ *  of the thread that made the call (see performWithPriority:block:).
+ */
+
+// Default: 0 (unlimited)
+@property (atomic, assign) double requestsPerSecond;
+
+// Default: 0 (one second's worth of requests)
+@property (atomic, assign) NSUInteger burstSize;
+
+// Default: 0 (unlimited)
+@property (atomic, assign) NSUInteger maximumConcurrentRequests;
+
+@property (atomic, readonly) NSUInteger queuedRequestCount;
+@property (atomic, readonly) NSUInteger activeRequestCount;
+
+// The most requests ever waiting at once, and how many responses were throttled
+@property (atomic, readonly) NSUInteger peakQueuedRequestCount;
+@property (atomic, readonly) NSUInteger throttledCount;
+
+// Calls made within block (on this thread) have priority; e.g. background history sync
++ (void)performWithPriority: (ApiProviderPriority)priority block: (void (^)(void))block;
+
+// The priority calls made on this thread get (default: ApiProviderPriorityDefault)
++ (ApiProviderPriority)currentPriority;
+
+
+#pragma mark - Metrics
+
+/**
+ *  Every call is recorded by method (its count, latency, errors and, for single-flight,
+ *  how many joined a call in flight), along with the bytes sent to and received from the
+ *  backend and the latency of each HTTP request (a batch is one request). The gauges
+ *  queued_requests and active_requests follow the scheduler.
+ */
+
+@property (nonatomic, readonly) ProviderMetrics *metrics;
+
+
+#pragma mark - Single-flight
+
+/**
+ *  While a call is in flight, identical calls (the same method and parameters, including
+ *  the block tag) share its request rather than sending another. Methods are named by their
+ *  JSON-RPC method (e.g. eth_getBalance); writes (eth_sendRawTransaction) must never be
+ *  included, since every call must reach the network.
+ */
+
+// All read-only methods
++ (NSSet<NSString*>*)defaultSingleFlightMethods;
+
+// Default: defaultSingleFlightMethods; an empty set disables single-flight
+@property (atomic, copy) NSSet<NSString*> *singleFlightMethods;
+
+// For subclasses; returns a promise which follows the request in flight for method and key,
+// calling createPromise to start one if there is none (or method is not single-flight). The
+// request is recorded in metrics under method (or "unknown", if nil).
+- (id)singleFlightMethod: (NSString*)method key: (NSString*)key promise: (Promise* (^)(void))createPromise;
+
+
+#pragma mark - Fetching
+
 - (id)promiseFetch: (NSURL*)url
               body: (NSData*)body
          fetchType: (ApiProviderFetchType)fetchType
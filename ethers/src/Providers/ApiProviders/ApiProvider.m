@@ -25,9 +25,12 @@
 
 #import "ApiProvider.h"
 
+#import "PromiseTracer.h"
 #import "SecureData.h"
 #import "Utilities.h"
 
+#include <os/lock.h>
+
 
 NSObject *ensureFloat(NSObject *object) {
     if ([object isKindOfClass:[NSNumber class]]) {
@@ -269,33 +272,122 @@ static ApiProviderFetchType fetchTypeForPathString(NSString *pathComponent) {
     
     return ApiProviderFetchTypeNil;
 }
-                                                   
-id queryPath(NSObject* object, NSString *path) {
+
+
+#pragma mark -
+#pragma mark - QueryPath
+
+// The argument of a dictionary: or array: step, as both a key and an index
+typedef struct QueryPathStep {
+    ApiProviderFetchType fetchType;
+    BOOL hasArgument;
+    NSInteger index;
+} QueryPathStep;
+
+static os_unfair_lock CompiledPathsLock = OS_UNFAIR_LOCK_INIT;
+static NSMutableDictionary<NSString*, QueryPath*> *CompiledPaths = nil;
+
+@implementation QueryPath {
+    QueryPathStep *_steps;
+    NSUInteger _stepCount;
     
-    for (NSString *pathComponent in [path componentsSeparatedByString:@"/"]) {
-        NSArray *components = [pathComponent componentsSeparatedByString:@":"];
-        if (components.count > 2) { return nil; }
+    // Each step's key (or NSNull, if it has no argument)
+    NSArray *_keys;
+}
+
++ (instancetype)queryPathWithString: (NSString*)path {
+    if (!path) { return nil; }
+    
+    os_unfair_lock_lock(&CompiledPathsLock);
+    QueryPath *queryPath = [CompiledPaths objectForKey:path];
+    os_unfair_lock_unlock(&CompiledPathsLock);
+    if (queryPath) { return queryPath; }
+    
+    queryPath = [[QueryPath alloc] initWithString:path];
+    if (!queryPath) { return nil; }
+    
+    // Paths are almost always literals, so the cache stays small
+    os_unfair_lock_lock(&CompiledPathsLock);
+    if (!CompiledPaths) { CompiledPaths = [NSMutableDictionary dictionary]; }
+    QueryPath *existing = [CompiledPaths objectForKey:path];
+    if (existing) {
+        queryPath = existing;
+    } else {
+        [CompiledPaths setObject:queryPath forKey:path];
+    }
+    os_unfair_lock_unlock(&CompiledPathsLock);
+    
+    return queryPath;
+}
+
+- (instancetype)initWithString: (NSString*)path {
+    self = [super init];
+    if (self) {
+        _path = [path copy];
+        
+        NSArray<NSString*> *pathComponents = [path componentsSeparatedByString:@"/"];
+        
+        _stepCount = pathComponents.count;
+        _steps = calloc(_stepCount, sizeof(QueryPathStep));
+        
+        NSMutableArray *keys = [NSMutableArray arrayWithCapacity:_stepCount];
+        for (NSUInteger i = 0; i < _stepCount; i++) {
+            NSArray<NSString*> *components = [[pathComponents objectAtIndex:i] componentsSeparatedByString:@":"];
+            if (components.count > 2) { return nil; }
+            
+            QueryPathStep *step = &_steps[i];
+            step->fetchType = fetchTypeForPathString([components firstObject]);
+            step->hasArgument = (components.count == 2);
+            
+            if (step->hasArgument) {
+                NSString *key = [components lastObject];
+                step->index = [key integerValue];
+                [keys addObject:key];
+            } else {
+                [keys addObject:[NSNull null]];
+            }
+        }
+        _keys = keys;
+    }
+    return self;
+}
 
-        object = coerceValue(object, fetchTypeForPathString([components firstObject]));
+- (void)dealloc {
+    free(_steps);
+}
 
+- (id)queryObject: (NSObject*)object {
+    for (NSUInteger i = 0; i < _stepCount; i++) {
+        const QueryPathStep *step = &_steps[i];
+        
+        object = coerceValue(object, step->fetchType);
+        
         if ([object isKindOfClass:[NSDictionary class]]) {
-            if (components.count == 1) { return object; }
-            object = [(NSDictionary*)object objectForKey:[components lastObject]];
+            if (!step->hasArgument) { return object; }
+            object = [(NSDictionary*)object objectForKey:[_keys objectAtIndex:i]];
             if (!object) { return nil; }
-        
+            
         } else if ([object isKindOfClass:[NSArray class]]) {
-            if (components.count == 1) { return object; }
-            NSInteger index = [[components lastObject] integerValue];
-            if (index >= [(NSArray*)object count]) { return nil; }
-            object = [(NSArray*)object objectAtIndex:index];
-        
+            if (!step->hasArgument) { return object; }
+            if (step->index < 0 || step->index >= [(NSArray*)object count]) { return nil; }
+            object = [(NSArray*)object objectAtIndex:step->index];
+            
         } else {
             return object;
         }
     }
     
     return object;
+}
 
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<QueryPath path=%@>", _path];
+}
+
+@end
+
+id queryPath(NSObject* object, NSString *path) {
+    return [[QueryPath queryPathWithString:path] queryObject:object];
 }
 
 NSMutableDictionary *transactionObject(Transaction *transaction) {
@@ -312,14 +404,175 @@ NSMutableDictionary *transactionObject(Transaction *transaction) {
 }
 
 
+#pragma mark -
+#pragma mark - ApiProviderSessionDelegate
+
+// Adds the phases of traced requests (DNS, connect, TLS, time-to-first-byte) to the trace.
+// The session retains its delegate, so this must not reference the provider.
+@interface ApiProviderSessionDelegate : NSObject <NSURLSessionTaskDelegate>
+
+- (void)traceTask: (NSURLSessionTask*)task traceId: (uint64_t)traceId;
+
+@end
+
+@implementation ApiProviderSessionDelegate {
+    NSMutableDictionary<NSNumber*, NSNumber*> *_traceIds;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _traceIds = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (void)traceTask: (NSURLSessionTask*)task traceId: (uint64_t)traceId {
+    @synchronized (_traceIds) {
+        [_traceIds setObject:@(traceId) forKey:@(task.taskIdentifier)];
+    }
+}
+
+- (void)URLSession: (NSURLSession*)session task: (NSURLSessionTask*)task didFinishCollectingMetrics: (NSURLSessionTaskMetrics*)metrics {
+    uint64_t traceId = 0;
+    @synchronized (_traceIds) {
+        NSNumber *taskIdentifier = @(task.taskIdentifier);
+        traceId = [[_traceIds objectForKey:taskIdentifier] unsignedLongLongValue];
+        [_traceIds removeObjectForKey:taskIdentifier];
+    }
+    if (!traceId) { return; }
+    
+    PromiseTracer *tracer = [PromiseTracer sharedTracer];
+    
+    [tracer recordIntervalWithName:@"http"
+                          category:@"network"
+                             start:metrics.taskInterval.startDate
+                               end:metrics.taskInterval.endDate
+                           traceId:traceId];
+    
+    // Phases are missing (nil) when a connection is reused, and are skipped
+    for (NSURLSessionTaskTransactionMetrics *transaction in metrics.transactionMetrics) {
+        [tracer recordIntervalWithName:@"dns"
+                              category:@"network"
+                                 start:transaction.domainLookupStartDate
+                                   end:transaction.domainLookupEndDate
+                               traceId:traceId];
+        
+        [tracer recordIntervalWithName:@"connect"
+                              category:@"network"
+                                 start:transaction.connectStartDate
+                                   end:transaction.connectEndDate
+                               traceId:traceId];
+        
+        [tracer recordIntervalWithName:@"tls"
+                              category:@"network"
+                                 start:transaction.secureConnectionStartDate
+                                   end:transaction.secureConnectionEndDate
+                               traceId:traceId];
+        
+        [tracer recordIntervalWithName:@"ttfb"
+                              category:@"network"
+                                 start:transaction.requestStartDate
+                                   end:transaction.responseStartDate
+                               traceId:traceId];
+        
+        [tracer recordIntervalWithName:@"download"
+                              category:@"network"
+                                 start:transaction.responseStartDate
+                                   end:transaction.responseEndDate
+                               traceId:traceId];
+    }
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - ApiProviderFlight
+
+// A request shared by identical calls; guarded by the provider's @synchronized (_flights)
+@interface ApiProviderFlight : NSObject
+
+@property (nonatomic, strong) Promise *promise;
+@property (nonatomic, assign) NSUInteger followerCount;
+
+@end
+
+@implementation ApiProviderFlight
+@end
+
+
+#pragma mark -
+#pragma mark - ApiProviderQueuedRequest
+
+// A request waiting for the scheduler; guarded by the provider's @synchronized (_queuedRequests)
+@interface ApiProviderQueuedRequest : NSObject
+
+@property (nonatomic, strong) CancellationToken *cancellationToken;
+
+// Called with NO instead if the request was cancelled while it waited
+@property (nonatomic, copy) void (^start)(BOOL);
+
+@end
+
+@implementation ApiProviderQueuedRequest
+@end
+
+
 #pragma mark -
 #pragma mark - ApiProvider
 
+#define DefaultMaximumConnectionsPerHost       6
+#define DefaultRequestTimeout                  30.0
+
+// How long to pause after a throttled response without a Retry-After
+#define DefaultThrottleDelay                   1.0
+
+static __thread ApiProviderPriority CurrentPriority = ApiProviderPriorityDefault;
+
 @implementation ApiProvider {
     NSTimer *_statsTimer;
     NSTimeInterval _startTime;
     
     NSUInteger _requestCount, _errorCount;
+    
+    // Created on first use and shared by every request, so connections are kept alive
+    NSURLSession *_session;
+    
+    NSInteger _maximumConnectionsPerHost;
+    NSTimeInterval _requestTimeout;
+    
+    // Calls in flight, by method and key
+    NSMutableDictionary<NSString*, ApiProviderFlight*> *_flights;
+    
+    // Requests waiting to start, indexed by priority; guarded by @synchronized (_queuedRequests),
+    // as are the token bucket and the counts
+    NSArray<NSMutableArray<ApiProviderQueuedRequest*>*> *_queuedRequests;
+    double _tokens;
+    NSTimeInterval _tokensUpdated;
+    NSTimeInterval _pausedUntil;
+    BOOL _startScheduled;
+}
+
++ (NSSet<NSString*>*)defaultSingleFlightMethods {
+    static NSSet<NSString*> *defaultSingleFlightMethods = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        defaultSingleFlightMethods = [NSSet setWithArray:@[
+                                                           @"eth_blockNumber",
+                                                           @"eth_call",
+                                                           @"eth_estimateGas",
+                                                           @"eth_gasPrice",
+                                                           @"eth_getBalance",
+                                                           @"eth_getBlockByHash",
+                                                           @"eth_getBlockByNumber",
+                                                           @"eth_getCode",
+                                                           @"eth_getStorageAt",
+                                                           @"eth_getTransactionByHash",
+                                                           @"eth_getTransactionCount",
+                                                           ]];
+    });
+    return defaultSingleFlightMethods;
 }
 
 - (instancetype)initWithChainId:(ChainId)chainId {
@@ -327,6 +580,24 @@ NSMutableDictionary *transactionObject(Transaction *transaction) {
     if (self) {
         _startTime = [NSDate timeIntervalSinceReferenceDate];
         
+        _maximumConnectionsPerHost = DefaultMaximumConnectionsPerHost;
+        _requestTimeout = DefaultRequestTimeout;
+        
+        _flights = [NSMutableDictionary dictionary];
+        _singleFlightMethods = [ApiProvider defaultSingleFlightMethods];
+        
+        _queuedRequests = @[ [NSMutableArray array], [NSMutableArray array], [NSMutableArray array] ];
+        
+        _metrics = [[ProviderMetrics alloc] initWithName:NSStringFromClass([self class])];
+        
+        __weak ApiProvider *weakSelf = self;
+        [_metrics setGaugeWithName:@"queued_requests" value:^double() {
+            return weakSelf.queuedRequestCount;
+        }];
+        [_metrics setGaugeWithName:@"active_requests" value:^double() {
+            return weakSelf.activeRequestCount;
+        }];
+        
         _statsTimer = [NSTimer scheduledTimerWithTimeInterval:(5 * 60.0f) repeats:YES block:^(NSTimer *timer) {
             float dt = ([NSDate timeIntervalSinceReferenceDate] - _startTime) / 60.0f;
             NSLog(@"%@: %d calls/min (total: %d; errors: %d)", self, (int)(((float) _requestCount) / dt), (int)_requestCount, (int)_errorCount);
@@ -338,11 +609,340 @@ NSMutableDictionary *transactionObject(Transaction *transaction) {
 - (void)dealloc {
     [_statsTimer invalidate];
     _statsTimer = nil;
+    
+    [_session finishTasksAndInvalidate];
 }
 
+
+#pragma mark - Session
+
+- (NSURLSession*)_sharedSession {
+    @synchronized (self) {
+        if (!_session) {
+            NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+            
+            // Over TLS, NSURLSession negotiates HTTP/2 (multiplexing every request over one
+            // connection per host) when the server supports it
+            configuration.HTTPMaximumConnectionsPerHost = _maximumConnectionsPerHost;
+            configuration.timeoutIntervalForRequest = _requestTimeout;
+            
+            // JSON-RPC responses depend on the current block, so must never come from a cache
+            configuration.requestCachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+            configuration.URLCache = nil;
+            
+            ApiProviderSessionDelegate *sessionDelegate = [[ApiProviderSessionDelegate alloc] init];
+            _session = [NSURLSession sessionWithConfiguration:configuration delegate:sessionDelegate delegateQueue:nil];
+        }
+        return _session;
+    }
+}
+
+// Created and started under the same lock that guards _session, so the session cannot be
+// invalidated in between (creating a task on an invalidated session throws); if it is
+// invalidated afterwards, the task finishes or is cancelled along with the session
+- (NSURLSessionDataTask*)_startTaskWithRequest: (NSURLRequest*)request
+                                       traceId: (uint64_t)traceId
+                             completionHandler: (void (^)(NSData*, NSURLResponse*, NSError*))completionHandler {
+    @synchronized (self) {
+        NSURLSession *session = [self _sharedSession];
+        NSURLSessionDataTask *task = [session dataTaskWithRequest:request completionHandler:completionHandler];
+        if (traceId) { [(ApiProviderSessionDelegate*)session.delegate traceTask:task traceId:traceId]; }
+        [task resume];
+        return task;
+    }
+}
+
+- (NSInteger)maximumConnectionsPerHost {
+    @synchronized (self) {
+        return _maximumConnectionsPerHost;
+    }
+}
+
+- (NSTimeInterval)requestTimeout {
+    @synchronized (self) {
+        return _requestTimeout;
+    }
+}
+
+- (void)setMaximumConnectionsPerHost: (NSInteger)maximumConnectionsPerHost {
+    @synchronized (self) {
+        _maximumConnectionsPerHost = maximumConnectionsPerHost;
+    }
+    [self invalidateSession];
+}
+
+- (void)setRequestTimeout: (NSTimeInterval)requestTimeout {
+    @synchronized (self) {
+        _requestTimeout = requestTimeout;
+    }
+    [self invalidateSession];
+}
+
+- (void)invalidateSession {
+    NSURLSession *session = nil;
+    @synchronized (self) {
+        session = _session;
+        _session = nil;
+    }
+    [session finishTasksAndInvalidate];
+}
+
+- (void)cancelAllRequests {
+    NSURLSession *session = nil;
+    @synchronized (self) {
+        session = _session;
+        _session = nil;
+    }
+    [session invalidateAndCancel];
+}
+
+
+#pragma mark - Scheduling
+
++ (void)performWithPriority: (ApiProviderPriority)priority block: (void (^)(void))block {
+    ApiProviderPriority previousPriority = CurrentPriority;
+    CurrentPriority = priority;
+    block();
+    CurrentPriority = previousPriority;
+}
+
++ (ApiProviderPriority)currentPriority {
+    return CurrentPriority;
+}
+
+- (void)_enqueueRequest: (ApiProviderQueuedRequest*)request priority: (ApiProviderPriority)priority {
+    priority = MAX(ApiProviderPriorityBackground, MIN(ApiProviderPriorityHigh, priority));
+    
+    @synchronized (_queuedRequests) {
+        [[_queuedRequests objectAtIndex:priority] addObject:request];
+        _queuedRequestCount++;
+        _peakQueuedRequestCount = MAX(_peakQueuedRequestCount, _queuedRequestCount);
+    }
+    
+    [self _startQueuedRequests];
+}
+
+- (void)_requestDidFinish {
+    @synchronized (_queuedRequests) {
+        _activeRequestCount--;
+    }
+    
+    [self _startQueuedRequests];
+}
+
+- (void)_throttledWithRetryAfter: (NSTimeInterval)retryAfter {
+    if (retryAfter <= 0) { retryAfter = DefaultThrottleDelay; }
+    
+    @synchronized (_queuedRequests) {
+        _throttledCount++;
+        _pausedUntil = MAX(_pausedUntil, [NSDate timeIntervalSinceReferenceDate] + retryAfter);
+    }
+}
+
+// Starts every queued request the limits allow, highest priority first
+- (void)_startQueuedRequests {
+    NSMutableArray<ApiProviderQueuedRequest*> *started = [NSMutableArray array];
+    NSMutableArray<ApiProviderQueuedRequest*> *cancelled = [NSMutableArray array];
+    NSTimeInterval retryDelay = 0;
+    BOOL scheduleRetry = NO;
+    
+    @synchronized (_queuedRequests) {
+        NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+        
+        double requestsPerSecond = self.requestsPerSecond;
+        double burstSize = (self.burstSize ? self.burstSize: MAX(1.0, requestsPerSecond));
+        NSUInteger maximumConcurrentRequests = self.maximumConcurrentRequests;
+        
+        if (requestsPerSecond > 0) {
+            _tokens = MIN(burstSize, _tokens + (now - _tokensUpdated) * requestsPerSecond);
+        }
+        _tokensUpdated = now;
+        
+        for (NSInteger priority = ApiProviderPriorityHigh; priority >= ApiProviderPriorityBackground; priority--) {
+            NSMutableArray<ApiProviderQueuedRequest*> *queue = [_queuedRequests objectAtIndex:priority];
+            
+            while (queue.count) {
+                ApiProviderQueuedRequest *request = [queue firstObject];
+                
+                // Cancelled requests leave without using a token
+                if (request.cancellationToken.cancelled) {
+                    [cancelled addObject:request];
+                
+                } else {
+                    if (now < _pausedUntil) {
+                        retryDelay = _pausedUntil - now;
+                        break;
+                    }
+                    
+                    // A request finishing will start the next
+                    if (maximumConcurrentRequests && _activeRequestCount >= maximumConcurrentRequests) { break; }
+                    
+                    if (requestsPerSecond > 0) {
+                        if (_tokens < 1.0) {
+                            retryDelay = (1.0 - _tokens) / requestsPerSecond;
+                            break;
+                        }
+                        _tokens -= 1.0;
+                    }
+                    
+                    _activeRequestCount++;
+                    [started addObject:request];
+                }
+                
+                [queue removeObjectAtIndex:0];
+                _queuedRequestCount--;
+            }
+            
+            // Lower priorities wait until this one is drained
+            if (queue.count) { break; }
+        }
+        
+        if (retryDelay > 0 && !_startScheduled) {
+            _startScheduled = YES;
+            scheduleRetry = YES;
+        }
+    }
+    
+    if (scheduleRetry) {
+        __weak ApiProvider *weakSelf = self;
+        dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(retryDelay * NSEC_PER_SEC));
+        dispatch_after(when, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^() {
+            ApiProvider *provider = weakSelf;
+            if (!provider) { return; }
+            
+            @synchronized (provider->_queuedRequests) {
+                provider->_startScheduled = NO;
+            }
+            [provider _startQueuedRequests];
+        });
+    }
+    
+    for (ApiProviderQueuedRequest *request in cancelled) { request.start(NO); }
+    for (ApiProviderQueuedRequest *request in started) { request.start(YES); }
+}
+
+
+#pragma mark - Single-flight
+
+// Returns a promise (of the same class) which follows request, whose callbacks run inline;
+// cancelling it calls cancel rather than cancelling request
+static Promise *followRequest(Promise *request, void (^cancel)(void)) {
+    return [[[request class] alloc] initWithSetup:^(Promise *promise) {
+        [request onCompletion:^(Promise *request) {
+            if (request.error) {
+                [promise reject:request.error];
+            } else {
+                NSObject *result = request.result;
+                [promise resolve:([result isEqual:[NSNull null]] ? nil: result)];
+            }
+        }];
+        
+        [promise.cancellationToken onCancel:cancel];
+    }];
+}
+
+- (id)singleFlightMethod: (NSString*)method key: (NSString*)key promise: (Promise* (^)(void))createPromise {
+    ProviderMetrics *metrics = _metrics;
+    NSString *metricsMethod = (method ?: @"unknown");
+    
+    // Callbacks run inline, so the request is measured (and any flight removed) the moment it
+    // completes; callers get a promise which follows it, so their callbacks are unaffected
+    Promise* (^startRequest)(void) = ^Promise*() {
+        NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
+        [metrics requestDidStartForMethod:metricsMethod];
+        
+        Promise *request = createPromise();
+        request.callbackQueue = nil;
+        [request onCompletion:^(Promise *request) {
+            [metrics requestDidFinishForMethod:metricsMethod
+                                      duration:([NSDate timeIntervalSinceReferenceDate] - startTime)
+                                         error:request.error];
+        }];
+        return request;
+    };
+    
+    if (!method || ![self.singleFlightMethods containsObject:method]) {
+        Promise *request = startRequest();
+        return followRequest(request, ^() {
+            [request cancel];
+        });
+    }
+    
+    NSString *flightKey = [NSString stringWithFormat:@"%@:%@", method, key];
+    
+    ApiProviderFlight *flight = nil;
+    @synchronized (_flights) {
+        flight = [_flights objectForKey:flightKey];
+        if (!flight) {
+            flight = [[ApiProviderFlight alloc] init];
+            flight.promise = startRequest();
+            [_flights setObject:flight forKey:flightKey];
+            
+            [flight.promise onCompletion:^(Promise *promise) {
+                @synchronized (_flights) {
+                    if ([_flights objectForKey:flightKey] == flight) { [_flights removeObjectForKey:flightKey]; }
+                }
+            }];
+        
+        } else {
+            [metrics recordSharedRequestForMethod:method];
+        }
+        flight.followerCount++;
+    }
+    
+    // Each caller gets its own promise, so cancelling one does not affect the others; the
+    // request itself is only cancelled once every caller has cancelled
+    Promise *shared = flight.promise;
+    return followRequest(shared, ^() {
+        BOOL abandoned = NO;
+        @synchronized (_flights) {
+            flight.followerCount--;
+            abandoned = (flight.followerCount == 0);
+            if (abandoned && [_flights objectForKey:flightKey] == flight) { [_flights removeObjectForKey:flightKey]; }
+        }
+        if (abandoned) { [shared cancel]; }
+    });
+}
+
+
+#pragma mark - Fetching
+
 - (void)fetch: (NSURL*)url body: (NSData*)body callback: (void (^)(NSData*, NSError*))callback {
+    [self fetch:url body:body cancellationToken:nil callback:callback];
+}
+
+- (void)fetch: (NSURL*)url
+         body: (NSData*)body
+cancellationToken: (CancellationToken*)cancellationToken
+     callback: (void (^)(NSData*, NSError*))callback {
+    
+    // The Promise (if any) this request is on behalf of, for tracing
+    uint64_t traceId = [PromiseTracer currentTraceId];
+    
+    ApiProviderPriority priority = [ApiProvider currentPriority];
+    
+    ProviderMetrics *metrics = _metrics;
+    __block NSTimeInterval startTime = 0;
+    
     void (^handleResponse)(NSData*, NSURLResponse*, NSError*) = ^(NSData *data, NSURLResponse *response, NSError *error) {
+        [metrics recordTransferWithDuration:([NSDate timeIntervalSinceReferenceDate] - startTime)];
+        [metrics recordBytesReceived:data.length];
+        
+        // Pause the queue before the slot this request held lets the next one start
+        NSInteger statusCode = ([response isKindOfClass:[NSHTTPURLResponse class]] ? [(NSHTTPURLResponse*)response statusCode]: 0);
+        if (statusCode == 429) {
+            NSObject *retryAfter = [[(NSHTTPURLResponse*)response allHeaderFields] objectForKey:@"Retry-After"];
+            [self _throttledWithRetryAfter:([retryAfter isKindOfClass:[NSString class]] ? [(NSString*)retryAfter doubleValue]: 0)];
+        }
+        [self _requestDidFinish];
+        
         if (error) {
+            if (cancellationToken.cancelled) {
+                NSDictionary *userInfo = @{@"reason": @"cancelled", @"url": url};
+                callback(nil, [NSError errorWithDomain:PromiseErrorDomain code:PromiseErrorCancelled userInfo:userInfo]);
+                return;
+            }
+            
             _errorCount++;
             NSDictionary *userInfo = @{@"error": error, @"url": url};
             callback(nil, [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorServerUnknownError userInfo:userInfo]);
@@ -356,18 +956,38 @@ NSMutableDictionary *transactionObject(Transaction *transaction) {
             return;
         }
         
-        NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse*)response;
-        if (httpResponse.statusCode != 200) {
+        if (statusCode != 200) {
             _errorCount++;
-            NSDictionary *userInfo = @{@"statusCode": @(httpResponse.statusCode), @"url": url};
-            callback(nil, [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo]);
+            NSDictionary *userInfo = @{@"statusCode": @(statusCode), @"url": url};
+            ProviderError code = (statusCode == 429) ? ProviderErrorThrottled: ProviderErrorBadResponse;
+            callback(nil, [NSError errorWithDomain:ProviderErrorDomain code:code userInfo:userInfo]);
             return;
         }
         
         callback(data, nil);
     };
     
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^() {
+    NSDate *queuedDate = [NSDate date];
+    
+    ApiProviderQueuedRequest *queuedRequest = [[ApiProviderQueuedRequest alloc] init];
+    queuedRequest.cancellationToken = cancellationToken;
+    queuedRequest.start = ^(BOOL start) {
+        
+        // Cancelled before we even started
+        if (!start) {
+            NSDictionary *userInfo = @{@"reason": @"cancelled", @"url": url};
+            callback(nil, [NSError errorWithDomain:PromiseErrorDomain code:PromiseErrorCancelled userInfo:userInfo]);
+            return;
+        }
+        
+        if (traceId) {
+            [[PromiseTracer sharedTracer] recordIntervalWithName:@"queued"
+                                                        category:@"network"
+                                                           start:queuedDate
+                                                             end:[NSDate date]
+                                                         traceId:traceId];
+        }
+        
         _requestCount++;
         
         NSMutableURLRequest *request = [[NSMutableURLRequest alloc] initWithURL:url];
@@ -379,61 +999,87 @@ NSMutableDictionary *transactionObject(Transaction *transaction) {
             [request setHTTPBody:body];
         }
         
-        NSURLSession *session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]];
-        NSURLSessionDataTask *task = [session dataTaskWithRequest:request completionHandler:handleResponse];
-        [task resume];
+        // Headers are not counted
+        [metrics recordBytesSent:(url.absoluteString.length + body.length)];
+        startTime = [NSDate timeIntervalSinceReferenceDate];
+        
+        NSURLSessionDataTask *task = [self _startTaskWithRequest:request traceId:traceId completionHandler:handleResponse];
+        
+        // Abandon the request (and free its connection) if the result is no longer needed
+        [cancellationToken onCancel:^() {
+            [task cancel];
+        }];
+    };
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^() {
+        [self _enqueueRequest:queuedRequest priority:priority];
     });
+}
+
+// Resolves promise with the processed response (coerced to fetchType), or rejects it if processed
+// is nil, an NSError or cannot be coerced
+- (void)completePromise: (Promise*)promise
+              processed: (NSObject*)processed
+              fetchType: (ApiProviderFetchType)fetchType
+                    url: (NSURL*)url
+                   body: (NSData*)body
+               response: (NSData*)response {
+    
+    if (!processed) {
+        _errorCount++;
+        NSMutableDictionary *userInfo = [@{@"reason": @"processed value is nil", @"url": url} mutableCopy];
+        if (body) { [userInfo setObject:[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] forKey:@"body"]; }
+        if (response) { [userInfo setObject:[[NSString alloc] initWithData:response encoding:NSUTF8StringEncoding] forKey:@"response"]; }
+        [promise reject:[NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo]];
+        return;
+        
+    } else if ([processed isKindOfClass:[NSError class]]) {
+        _errorCount++;
+        NSError *error = (NSError*)processed;
+        
+        // e.g. a rate limit reported in the body of a successful response
+        if ([error.domain isEqualToString:ProviderErrorDomain] && error.code == ProviderErrorThrottled) {
+            [self _throttledWithRetryAfter:0];
+        }
+        
+        NSMutableDictionary *userInfo = [error.userInfo mutableCopy];
+        [userInfo setObject:url forKey:@"url"];
+        if (body) { [userInfo setObject:[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] forKey:@"body"]; }
+        if (response) { [userInfo setObject:[[NSString alloc] initWithData:response encoding:NSUTF8StringEncoding] forKey:@"response"]; }
+        [promise reject:[NSError errorWithDomain:error.domain code:error.code userInfo:userInfo]];
+        return;
+    }
     
+    //NSLog(@"RESULT: %@", NSStringFromClass([processed class]));
+    
+    NSObject *result = nil;
+    if (![processed isEqual:[NSNull null]]) {
+        result = coerceValue(processed, fetchType);
+        
+        if (!result) {
+            _errorCount++;
+            NSMutableDictionary *userInfo = [@{@"reason": @"coerced value is nil", @"url": url} mutableCopy];
+            if (body) { [userInfo setObject:[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] forKey:@"body"]; }
+            if (response) { [userInfo setObject:[[NSString alloc] initWithData:response encoding:NSUTF8StringEncoding] forKey:@"response"]; }
+            [promise reject:[NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo]];
+            return;
+        }
+    }
+    
+    [promise resolve:result];
 }
 
 - (id)promiseFetch:(NSURL *)url body:(NSData *)body fetchType:(ApiProviderFetchType)fetchType process:(NSObject *(^)(NSData*))process {
     Class promiseClass = getPromiseClass(fetchType);
     
     return [(Promise*)[promiseClass alloc] initWithSetup:^(Promise *promise) {
-        [self fetch:url body:body callback:^(NSData *response, NSError *error) {
+        [self fetch:url body:body cancellationToken:promise.cancellationToken callback:^(NSData *response, NSError *error) {
             if (error) {
                 [promise reject:error];
                 return;
             }
             
-            NSObject *processed = process(response);
-
-            if (!processed) {
-                _errorCount++;
-                NSMutableDictionary *userInfo = [@{@"reason": @"processed value is nil", @"url": url} mutableCopy];
-                if (body) { [userInfo setObject:[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] forKey:@"body"]; }
-                if (response) { [userInfo setObject:[[NSString alloc] initWithData:response encoding:NSUTF8StringEncoding] forKey:@"response"]; }
-                [promise reject:[NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo]];
-                return;
-            
-            } else if ([processed isKindOfClass:[NSError class]]) {
-                _errorCount++;
-                NSError *error = (NSError*)processed;
-                NSMutableDictionary *userInfo = [error.userInfo mutableCopy];
-                [userInfo setObject:url forKey:@"url"];
-                if (body) { [userInfo setObject:[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] forKey:@"body"]; }
-                if (response) { [userInfo setObject:[[NSString alloc] initWithData:response encoding:NSUTF8StringEncoding] forKey:@"response"]; }
-                [promise reject:[NSError errorWithDomain:error.domain code:error.code userInfo:userInfo]];
-                return;
-            }
-            
-            //NSLog(@"RESULT: %@", NSStringFromClass([processed class]));
-            
-            NSObject *result = nil;
-            if (![processed isEqual:[NSNull null]]) {
-                result = coerceValue(processed, fetchType);
-
-                if (!result) {
-                    _errorCount++;
-                    NSMutableDictionary *userInfo = [@{@"reason": @"coerced value is nil", @"url": url} mutableCopy];
-                    if (body) { [userInfo setObject:[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] forKey:@"body"]; }
-                    if (response) { [userInfo setObject:[[NSString alloc] initWithData:response encoding:NSUTF8StringEncoding] forKey:@"response"]; }
-                    [promise reject:[NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo]];
-                    return;
-                }
-            }
-            
-            [promise resolve:result];
+            [self completePromise:promise processed:process(response) fetchType:fetchType url:url body:body response:response];
         }];
     }];
 }
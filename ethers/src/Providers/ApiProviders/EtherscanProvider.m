@@ -163,21 +163,48 @@ NSString* queryifyTransaction(Transaction *transaction) {
     return [self urlForPath:[NSString stringWithFormat:@"/api?module=proxy&%@", action]];
 }
 
-- (id)promiseFetch: (NSString*)path fetchType:(ApiProviderFetchType)fetchType {
-    return [self promiseFetchJSON:[self urlForPath:path] body:nil fetchType:fetchType process:^NSObject*(NSDictionary *response) {
-        if (![@"OK" isEqual:[response objectForKey:@"message"]]) {
-            NSDictionary *userInfo = @{@"reason": @"response NOTOK"};
-            return [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo];
-        }
-        
-        return [response objectForKey:@"result"];;
+// Etherscan reports its rate limit as a NOTOK response, e.g. "Max rate limit reached"
+static NSError *rateLimitError(NSDictionary *response) {
+    if ([@"OK" isEqual:[response objectForKey:@"message"]]) { return nil; }
+    
+    NSString *result = [response objectForKey:@"result"];
+    if (![result isKindOfClass:[NSString class]] || [result rangeOfString:@"rate limit" options:NSCaseInsensitiveSearch].location == NSNotFound) {
+        return nil;
+    }
+    
+    return [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorThrottled userInfo:@{@"reason": result}];
+}
+
+// The method names the call for single-flight (see ApiProvider); nil never shares
+- (id)promiseFetch: (NSString*)path method: (NSString*)method fetchType:(ApiProviderFetchType)fetchType {
+    return [self singleFlightMethod:method key:path promise:^Promise*() {
+        return [self promiseFetchJSON:[self urlForPath:path] body:nil fetchType:fetchType process:^NSObject*(NSDictionary *response) {
+            NSError *throttled = rateLimitError(response);
+            if (throttled) { return throttled; }
+            
+            if (![@"OK" isEqual:[response objectForKey:@"message"]]) {
+                NSDictionary *userInfo = @{@"reason": @"response NOTOK"};
+                return [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo];
+            }
+            
+            return [response objectForKey:@"result"];;
+        }];
     }];
 }
 
 - (id)promiseFetchProxyAction: (NSString*)action fetchType: (ApiProviderFetchType)fetchType {
-    NSURL *url = [self urlForProxyAction:action];
-    return [self promiseFetchJSON:url body:nil fetchType:fetchType process:^NSObject*(NSDictionary *response) {
-        return [response objectForKey:@"result"];
+    
+    // Proxy actions are named by their JSON-RPC method (e.g. "action=eth_call&...")
+    NSString *method = [[[action substringFromIndex:7] componentsSeparatedByString:@"&"] firstObject];
+    
+    return [self singleFlightMethod:method key:action promise:^Promise*() {
+        NSURL *url = [self urlForProxyAction:action];
+        return [self promiseFetchJSON:url body:nil fetchType:fetchType process:^NSObject*(NSDictionary *response) {
+            NSError *throttled = rateLimitError(response);
+            if (throttled) { return throttled; }
+            
+            return [response objectForKey:@"result"];
+        }];
     }];
 }
 
@@ -192,6 +219,7 @@ NSString* queryifyTransaction(Transaction *transaction) {
     }
     
     return [self promiseFetch:[NSString stringWithFormat:@"/api?module=account&action=balance&address=%@&tag=%@", address, tag]
+                       method:@"eth_getBalance"
                     fetchType:ApiProviderFetchTypeBigNumberDecimal];
 }
 
@@ -254,7 +282,12 @@ NSString* queryifyTransaction(Transaction *transaction) {
     }
     
     NSString *action = [NSString stringWithFormat:@"action=eth_sendRawTransaction&hex=%@", [SecureData dataToHexString:signedTransaction]];
-    return [self promiseFetchProxyAction:action fetchType:ApiProviderFetchTypeHash];
+    
+    __block HashPromise *promise = nil;
+    [ApiProvider performWithPriority:ApiProviderPriorityHigh block:^() {
+        promise = [self promiseFetchProxyAction:action fetchType:ApiProviderFetchTypeHash];
+    }];
+    return promise;
 }
 
 //- (BlockInfoPromise*)getBlockByBlockHash: (Hash*)blockHash {
@@ -375,10 +408,13 @@ NSString* queryifyTransaction(Transaction *transaction) {
     NSString *path = [NSString stringWithFormat:@"/api?module=account&action=txlist&address=%@&startblock=%@&endblock=99999999&sort=asc",
                       address, getBlockTag(blockTag)];
     
-    return [self promiseFetchJSON:[self urlForPath:path]
-                             body:nil
-                        fetchType:ApiProviderFetchTypeArray
-                          process:processTransactions];
+    // Named for metrics only; the history is never shared, as it changes with every block
+    return [self singleFlightMethod:@"account_txlist" key:path promise:^Promise*() {
+        return [self promiseFetchJSON:[self urlForPath:path]
+                                 body:nil
+                            fetchType:ApiProviderFetchTypeArray
+                              process:processTransactions];
+    }];
 }
 
 - (FloatPromise*)getEtherPrice {
@@ -401,10 +437,13 @@ NSString* queryifyTransaction(Transaction *transaction) {
             return [(NSDictionary*)result objectForKey:@"ethusd"];
         };
         
-        etherPricePromise = [self promiseFetchJSON:[self urlForPath:@"/api?module=stats&action=ethprice"]
-                                              body:nil
-                                         fetchType:ApiProviderFetchTypeFloat
-                                           process:processEtherPrice];
+        NSString *path = @"/api?module=stats&action=ethprice";
+        etherPricePromise = [self singleFlightMethod:@"stats_ethprice" key:path promise:^Promise*() {
+            return [self promiseFetchJSON:[self urlForPath:path]
+                                     body:nil
+                                fetchType:ApiProviderFetchTypeFloat
+                                  process:processEtherPrice];
+        }];
     }
     
     return etherPricePromise;
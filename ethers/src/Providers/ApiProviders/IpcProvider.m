@@ -0,0 +1,309 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import "IpcProvider.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+static NSError *connectionFailed(NSString *reason) {
+    return [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorConnectionFailed userInfo:@{@"reason": reason}];
+}
+
+
+#pragma mark -
+#pragma mark - IpcRequest
+
+// A request waiting for its response; shared by every id in a batch
+@interface IpcRequest : NSObject
+
+- (instancetype)initWithRequestIds: (NSArray<NSNumber*>*)requestIds callback: (void (^)(NSObject*, NSData*, NSError*))callback;
+
+@property (nonatomic, readonly) NSArray<NSNumber*> *requestIds;
+@property (nonatomic, readonly) void (^callback)(NSObject*, NSData*, NSError*);
+
+@end
+
+@implementation IpcRequest
+
+- (instancetype)initWithRequestIds: (NSArray<NSNumber*>*)requestIds callback: (void (^)(NSObject*, NSData*, NSError*))callback {
+    self = [super init];
+    if (self) {
+        _requestIds = requestIds;
+        _callback = [callback copy];
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - IpcProvider
+
+@implementation IpcProvider {
+    
+    // The superclass polls during init, so the queue is created on first use; everything
+    // else is only touched on it
+    dispatch_queue_t _queue;
+    
+    dispatch_source_t _readSource;
+    dispatch_source_t _writeSource;
+    BOOL _writeSourceSuspended;
+    int _fd;
+    
+    NSMutableData *_readBuffer;
+    NSMutableData *_writeBuffer;
+    NSMutableDictionary<NSNumber*, IpcRequest*> *_requests;
+}
+
+- (instancetype)initWithChainId: (ChainId)chainId path: (NSString*)path {
+    return [super initWithChainId:chainId url:[NSURL fileURLWithPath:path]];
+}
+
+- (void)dealloc {
+    
+    // Releasing a suspended source is an error
+    if (_writeSourceSuspended) { dispatch_resume(_writeSource); }
+    if (_writeSource) { dispatch_source_cancel(_writeSource); }
+    if (_readSource) { dispatch_source_cancel(_readSource); }
+}
+
+- (NSString*)path {
+    return self.url.path;
+}
+
+- (dispatch_queue_t)queue {
+    @synchronized (self) {
+        if (!_queue) {
+            _queue = dispatch_queue_create("io.ethers.IpcProvider", DISPATCH_QUEUE_SERIAL);
+        }
+        return _queue;
+    }
+}
+
+
+#pragma mark - Connection
+
+// Returns nil once connected; must be called on the queue
+- (NSError*)_connect {
+    if (_readSource) { return nil; }
+    
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    
+    const char *path = self.path.fileSystemRepresentation;
+    if (!path || strlen(path) >= sizeof(address.sun_path)) {
+        return connectionFailed(@"invalid path");
+    }
+    strlcpy(address.sun_path, path, sizeof(address.sun_path));
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) { return connectionFailed(@"socket failed"); }
+    
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return connectionFailed(@"connect failed");
+    }
+    
+    int noSigPipe = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    
+    _fd = fd;
+    _readBuffer = [NSMutableData data];
+    _writeBuffer = [NSMutableData data];
+    if (!_requests) { _requests = [NSMutableDictionary dictionary]; }
+    
+    // Both sources watch the socket, so it is closed once both are cancelled
+    __block int openSources = 2;
+    void (^cancelHandler)(void) = ^() {
+        if (--openSources == 0) { close(fd); }
+    };
+    
+    __weak IpcProvider *weakSelf = self;
+    
+    _readSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, _queue);
+    dispatch_source_set_event_handler(_readSource, ^() {
+        [weakSelf _readAvailable];
+    });
+    dispatch_source_set_cancel_handler(_readSource, cancelHandler);
+    dispatch_resume(_readSource);
+    
+    // Only resumed while there is something left to write
+    _writeSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_WRITE, fd, 0, _queue);
+    dispatch_source_set_event_handler(_writeSource, ^() {
+        [weakSelf _writeAvailable];
+    });
+    dispatch_source_set_cancel_handler(_writeSource, cancelHandler);
+    _writeSourceSuspended = YES;
+    
+    return nil;
+}
+
+- (void)_connectionFailed: (NSString*)reason {
+    if (!_readSource) { return; }
+    
+    if (_writeSourceSuspended) {
+        dispatch_resume(_writeSource);
+        _writeSourceSuspended = NO;
+    }
+    dispatch_source_cancel(_writeSource);
+    dispatch_source_cancel(_readSource);
+    _writeSource = nil;
+    _readSource = nil;
+    
+    _readBuffer = nil;
+    _writeBuffer = nil;
+    
+    NSSet<IpcRequest*> *requests = [NSSet setWithArray:[_requests allValues]];
+    [_requests removeAllObjects];
+    
+    for (IpcRequest *request in requests) {
+        request.callback(nil, nil, connectionFailed(reason));
+    }
+}
+
+- (void)_writeAvailable {
+    while (_writeBuffer.length) {
+        ssize_t written = write(_fd, _writeBuffer.bytes, _writeBuffer.length);
+        if (written < 0 && errno == EINTR) { continue; }
+        if (written < 0 && errno == EAGAIN) { break; }
+        if (written <= 0) {
+            [self _connectionFailed:@"write failed"];
+            return;
+        }
+        [_writeBuffer replaceBytesInRange:NSMakeRange(0, written) withBytes:NULL length:0];
+        [self.metrics recordBytesSent:written];
+    }
+    
+    BOOL suspend = (_writeBuffer.length == 0);
+    if (suspend != _writeSourceSuspended) {
+        if (suspend) {
+            dispatch_suspend(_writeSource);
+        } else {
+            dispatch_resume(_writeSource);
+        }
+        _writeSourceSuspended = suspend;
+    }
+}
+
+- (void)_readAvailable {
+    uint8_t chunk[65536];
+    while (YES) {
+        ssize_t length = read(_fd, chunk, sizeof(chunk));
+        if (length < 0 && errno == EINTR) { continue; }
+        if (length < 0 && errno == EAGAIN) { break; }
+        if (length <= 0) {
+            [self _connectionFailed:(length == 0 ? @"connection closed": @"read failed")];
+            return;
+        }
+        [_readBuffer appendBytes:chunk length:length];
+        [self.metrics recordBytesReceived:length];
+    }
+    
+    // Handle every complete line, then drop them from the buffer at once
+    const uint8_t *bytes = _readBuffer.bytes;
+    NSUInteger offset = 0;
+    while (offset < _readBuffer.length) {
+        const uint8_t *newline = memchr(&bytes[offset], '\n', _readBuffer.length - offset);
+        if (!newline) { break; }
+        
+        NSUInteger lineLength = newline - &bytes[offset];
+        if (lineLength) {
+            [self _handleResponse:[NSData dataWithBytes:&bytes[offset] length:lineLength]];
+        }
+        offset += lineLength + 1;
+        
+        // A callback may have failed the connection
+        if (!_readBuffer) { return; }
+    }
+    
+    [_readBuffer replaceBytesInRange:NSMakeRange(0, offset) withBytes:NULL length:0];
+}
+
+- (void)_handleResponse: (NSData*)line {
+    NSObject *json = [NSJSONSerialization JSONObjectWithData:line options:0 error:nil];
+    
+    // Any one id of a response (or batch of responses) finds its request
+    IpcRequest *request = nil;
+    NSArray *responses = ([json isKindOfClass:[NSArray class]] ? (NSArray*)json: (json ? @[ json ]: @[]));
+    for (NSDictionary *response in responses) {
+        if (![response isKindOfClass:[NSDictionary class]]) { continue; }
+        NSObject *requestId = [response objectForKey:@"id"];
+        if (![requestId isKindOfClass:[NSNumber class]]) { continue; }
+        
+        request = [_requests objectForKey:(NSNumber*)requestId];
+        if (request) { break; }
+    }
+    
+    if (!request) {
+        NSLog(@"IpcProvider: unmatched response=%@", [[NSString alloc] initWithData:line encoding:NSUTF8StringEncoding]);
+        return;
+    }
+    
+    [_requests removeObjectsForKeys:request.requestIds];
+    request.callback(json, line, nil);
+}
+
+
+#pragma mark - Transport
+
+- (void)sendRequest: (NSData*)request
+         requestIds: (NSArray<NSNumber*>*)requestIds
+  cancellationToken: (CancellationToken*)cancellationToken
+           callback: (void (^)(NSObject*, NSData*, NSError*))callback {
+    
+    dispatch_async([self queue], ^() {
+        NSError *error = [self _connect];
+        if (error) {
+            callback(nil, nil, error);
+            return;
+        }
+        
+        IpcRequest *pending = [[IpcRequest alloc] initWithRequestIds:requestIds callback:callback];
+        for (NSNumber *requestId in requestIds) {
+            [_requests setObject:pending forKey:requestId];
+        }
+        
+        // Serialized JSON never contains a raw newline, so it delimits requests
+        [_writeBuffer appendData:request];
+        [_writeBuffer appendBytes:"\n" length:1];
+        [self _writeAvailable];
+    });
+}
+
+
+#pragma mark - NSObject
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<IpcProvider chainId=%d path=%@>", self.chainId, self.path];
+}
+
+@end
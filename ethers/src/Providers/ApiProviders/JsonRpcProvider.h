@@ -41,4 +41,41 @@
 
 @property (nonatomic, readonly) NSURL *url;
 
+
+#pragma mark - Batching
+
+/**
+ *  Calls made within batchWindow of the first pending call are sent together, as a single
+ *  JSON-RPC batch (one HTTP request), and each response is matched to its call by id. A
+ *  batch is sent early once it reaches maximumBatchCount calls or maximumBatchBytes.
+ */
+
+// Default: 5ms; 0 sends each call immediately (unless inside beginBatch)
+@property (atomic, assign) NSTimeInterval batchWindow;
+
+@property (atomic, assign) NSUInteger maximumBatchCount;    // Default: 100
+@property (atomic, assign) NSUInteger maximumBatchBytes;    // Default: 512kb
+
+// Holds calls made on the calling thread (other than those over the limits above) until
+// flush; calls from other threads are still sent within batchWindow
+- (void)beginBatch;
+
+// Sends all pending calls now, ending any batch the calling thread started with beginBatch
+- (void)flush;
+
+
+#pragma mark - Subclassing
+
+// Returns a promise of the class for fetchType, for the result of a JSON-RPC call
+- (id)sendMethod: (NSString*)method params: (NSObject*)params fetchType: (ApiProviderFetchType)fetchType;
+
+// Sends a request (a single call, or a batch of the calls with requestIds) and calls back with
+// the parsed response (nil if it is not valid JSON) and its raw bytes, or an error if the
+// request failed. The default posts the request to url over HTTP; subclasses may replace
+// the transport.
+- (void)sendRequest: (NSData*)request
+         requestIds: (NSArray<NSNumber*>*)requestIds
+  cancellationToken: (CancellationToken*)cancellationToken
+           callback: (void (^)(NSObject *json, NSData *response, NSError *error))callback;
+
 @end
@@ -25,6 +25,9 @@
 
 #import "JsonRpcProvider.h"
 
+#include <stdatomic.h>
+
+#import "PromiseTracer.h"
 #import "SecureData.h"
 #import "Utilities.h"
 
@@ -34,6 +37,93 @@
 
 @end
 
+@interface ApiProvider (private)
+
+- (void)fetch: (NSURL*)url
+         body: (NSData*)body
+cancellationToken: (CancellationToken*)cancellationToken
+     callback: (void (^)(NSData*, NSError*))callback;
+
+- (void)completePromise: (Promise*)promise
+              processed: (NSObject*)processed
+              fetchType: (ApiProviderFetchType)fetchType
+                    url: (NSURL*)url
+                   body: (NSData*)body
+               response: (NSData*)response;
+
+@end
+
+
+#define DefaultBatchWindow              0.005
+#define DefaultMaximumBatchCount        100
+#define DefaultMaximumBatchBytes        (512 * 1024)
+
+
+// Returns the result of a JSON-RPC response object, or an NSError
+static NSObject *processResponse(NSDictionary *response) {
+    if (![response isKindOfClass:[NSDictionary class]]) {
+        NSDictionary *userInfo = @{@"reason": @"invalid response"};
+        return [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo];
+    }
+    
+    NSDictionary *rpcError = [response objectForKey:@"error"];
+    if (rpcError) {
+        NSString *message = ([rpcError isKindOfClass:[NSDictionary class]] ? [rpcError objectForKey:@"message"]: rpcError);
+        NSDictionary *userInfo = @{@"reason": [NSString stringWithFormat:@"%@", message]};
+        
+        // -32005 is "limit exceeded" (e.g. Infura's request rate limit)
+        BOOL throttled = ([rpcError isKindOfClass:[NSDictionary class]] && [[rpcError objectForKey:@"code"] isEqual:@(-32005)]);
+        return [NSError errorWithDomain:ProviderErrorDomain code:(throttled ? ProviderErrorThrottled: ProviderErrorBadResponse) userInfo:userInfo];
+    }
+    
+    NSObject *result = [response objectForKey:@"result"];
+    if (!result) {
+        NSDictionary *userInfo = @{@"reason": @"invalid result"};
+        return [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo];
+    }
+    
+    return result;
+}
+
+
+#pragma mark -
+#pragma mark - JsonRpcCall
+
+// A call waiting to be sent
+@interface JsonRpcCall : NSObject
+
+- (instancetype)initWithRequestId: (NSNumber*)requestId
+                             body: (NSData*)body
+                        fetchType: (ApiProviderFetchType)fetchType
+                          promise: (Promise*)promise;
+
+@property (nonatomic, readonly) NSNumber *requestId;
+@property (nonatomic, assign) ApiProviderPriority priority;
+@property (nonatomic, assign) uint64_t traceId;
+@property (nonatomic, readonly) NSData *body;
+@property (nonatomic, readonly) ApiProviderFetchType fetchType;
+@property (nonatomic, readonly) Promise *promise;
+
+@end
+
+@implementation JsonRpcCall
+
+- (instancetype)initWithRequestId: (NSNumber*)requestId
+                             body: (NSData*)body
+                        fetchType: (ApiProviderFetchType)fetchType
+                          promise: (Promise*)promise {
+    self = [super init];
+    if (self) {
+        _requestId = requestId;
+        _body = body;
+        _fetchType = fetchType;
+        _promise = promise;
+    }
+    return self;
+}
+
+@end
+
 
 #pragma mark -
 #pragma mark - JsonRpcProvider
@@ -41,12 +131,32 @@
 @implementation JsonRpcProvider {
     NSUInteger _requestCount;
     NSTimer *_poller;
+    
+    atomic_uint_fast64_t _nextRequestId;
+    
+    // Guarded by @synchronized (_pendingCalls)
+    NSMutableArray<JsonRpcCall*> *_pendingCalls;
+    NSUInteger _pendingBytes;
+    NSUInteger _batchGeneration;
+    
+    // Calls held by beginBatch, for each thread inside a batch (also guarded by _pendingCalls)
+    NSMapTable<NSThread*, NSMutableArray<JsonRpcCall*>*> *_threadBatches;
 }
 
 - (instancetype)initWithChainId:(ChainId)chainId url:(NSURL *)url {
     self = [super initWithChainId:chainId];
     if (self) {
         _url = url;
+        
+        atomic_init(&_nextRequestId, 1);
+        
+        _pendingCalls = [NSMutableArray array];
+        _threadBatches = [NSMapTable mapTableWithKeyOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)
+                                               valueOptions:NSPointerFunctionsStrongMemory];
+        _batchWindow = DefaultBatchWindow;
+        _maximumBatchCount = DefaultMaximumBatchCount;
+        _maximumBatchBytes = DefaultMaximumBatchBytes;
+        
         [self doPoll];
     }
     return self;
@@ -86,45 +196,254 @@
 }
 
 
-#pragma mark - Methods
+#pragma mark - Batching
 
-- (id)sendMethod: (NSString*)method params: (NSObject*)params fetchType: (ApiProviderFetchType)fetchType {
-    
-    NSDictionary *request = @{
-                              @"jsonrpc": @"2.0",
-                              @"method": method,
-                              @"id": @(42),
-                              @"params": params,
-                              };
+// Takes every pending call; the caller must hold the lock (which is _pendingCalls, so it
+// is emptied in place rather than replaced)
+- (NSArray<JsonRpcCall*>*)_takePendingCalls {
+    NSArray<JsonRpcCall*> *calls = [_pendingCalls copy];
+    [_pendingCalls removeAllObjects];
+    _pendingBytes = 0;
+    _batchGeneration++;
+    return calls;
+}
 
-    NSError *error = nil;
-    NSData *body = [NSJSONSerialization dataWithJSONObject:request options:0 error:&error];
+static NSUInteger getBatchBytes(NSArray<JsonRpcCall*> *calls) {
+    NSUInteger bytes = 0;
+    for (JsonRpcCall *call in calls) { bytes += call.body.length + 1; }
+    return bytes;
+}
+
+- (void)_enqueueCall: (JsonRpcCall*)call {
+    NSArray<JsonRpcCall*> *fullBatch = nil, *readyBatch = nil;
+    NSTimeInterval batchWindow = self.batchWindow;
+    NSUInteger batchGeneration = 0;
+    BOOL scheduleFlush = NO;
     
-    if (error) {
-        NSDictionary *userInfo = @{@"reason": @"invalid JSON values", @"error": error};
-        return [Promise rejected:[NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorInvalidParameters userInfo:userInfo]];
+    @synchronized (_pendingCalls) {
+        
+        // Inside beginBatch on this thread; hold the call for flush, but still honour the limits
+        NSMutableArray<JsonRpcCall*> *threadBatch = [_threadBatches objectForKey:[NSThread currentThread]];
+        if (threadBatch) {
+            if (threadBatch.count && getBatchBytes(threadBatch) + call.body.length + 1 > self.maximumBatchBytes) {
+                fullBatch = [threadBatch copy];
+                [threadBatch removeAllObjects];
+            }
+            
+            [threadBatch addObject:call];
+            
+            if (threadBatch.count >= self.maximumBatchCount) {
+                readyBatch = [threadBatch copy];
+                [threadBatch removeAllObjects];
+            }
+        
+        } else {
+            
+            // Adding this call would exceed the byte limit, so send what we have first
+            if (_pendingCalls.count && _pendingBytes + call.body.length + 1 > self.maximumBatchBytes) {
+                fullBatch = [self _takePendingCalls];
+            }
+            
+            [_pendingCalls addObject:call];
+            _pendingBytes += call.body.length + 1;
+            
+            if (_pendingCalls.count >= self.maximumBatchCount || batchWindow <= 0) {
+                readyBatch = [self _takePendingCalls];
+            
+            } else if (_pendingCalls.count == 1) {
+                scheduleFlush = YES;
+                batchGeneration = _batchGeneration;
+            }
+        }
     }
+    
+    if (fullBatch) { [self _sendCalls:fullBatch]; }
+    if (readyBatch) { [self _sendCalls:readyBatch]; }
+    
+    if (scheduleFlush) {
+        dispatch_time_t when = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(batchWindow * NSEC_PER_SEC));
+        dispatch_after(when, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^() {
+            NSArray<JsonRpcCall*> *calls = nil;
+            @synchronized (_pendingCalls) {
+                
+                // Already sent (by the limits or flush)
+                if (_batchGeneration != batchGeneration) { return; }
+                calls = [self _takePendingCalls];
+            }
+            [self _sendCalls:calls];
+        });
+    }
+}
 
-    NSObject* (^processResponse)(NSDictionary*) = ^NSObject*(NSDictionary *response) {
-        NSDictionary *rpcError = [response objectForKey:@"error"];
-        if (rpcError) {
-            NSDictionary *userInfo = @{@"reason": [NSString stringWithFormat:@"%@", [rpcError objectForKey:@"message"]]};
-            return [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo];
+- (void)beginBatch {
+    @synchronized (_pendingCalls) {
+        NSThread *thread = [NSThread currentThread];
+        if (![_threadBatches objectForKey:thread]) {
+            [_threadBatches setObject:[NSMutableArray array] forKey:thread];
         }
+    }
+}
+
+- (void)flush {
+    NSArray<JsonRpcCall*> *threadCalls = nil, *calls = nil;
+    @synchronized (_pendingCalls) {
+        NSThread *thread = [NSThread currentThread];
+        threadCalls = [_threadBatches objectForKey:thread];
+        [_threadBatches removeObjectForKey:thread];
+        calls = [self _takePendingCalls];
+    }
+    if (threadCalls) { [self _sendCalls:threadCalls]; }
+    [self _sendCalls:calls];
+}
 
-        NSObject *result = [response objectForKey:@"result"];
-        if (!result) {
-            NSDictionary *userInfo = @{@"reason": @"invalid result"};
-            return [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo];
+- (void)_sendCalls: (NSArray<JsonRpcCall*>*)calls {
+    
+    // Skip calls cancelled while they were waiting
+    NSMutableArray<JsonRpcCall*> *liveCalls = [NSMutableArray arrayWithCapacity:calls.count];
+    for (JsonRpcCall *call in calls) {
+        if (!call.promise.complete) { [liveCalls addObject:call]; }
+    }
+    if (liveCalls.count == 0) { return; }
+    
+    // A lone call is sent as a plain request, and can be cancelled on its own
+    NSData *body = nil;
+    CancellationToken *cancellationToken = nil;
+    if (liveCalls.count == 1) {
+        body = [liveCalls firstObject].body;
+        cancellationToken = [liveCalls firstObject].promise.cancellationToken;
+        
+    } else {
+        NSMutableData *batchBody = [NSMutableData dataWithCapacity:liveCalls.count * 128];
+        [batchBody appendBytes:"[" length:1];
+        for (JsonRpcCall *call in liveCalls) {
+            if (batchBody.length > 1) { [batchBody appendBytes:"," length:1]; }
+            [batchBody appendData:call.body];
+        }
+        [batchBody appendBytes:"]" length:1];
+        body = batchBody;
+    }
+    
+    // A batch is as urgent as its most urgent call, and is traced as its first traced call
+    NSMutableArray<NSNumber*> *requestIds = [NSMutableArray arrayWithCapacity:liveCalls.count];
+    ApiProviderPriority priority = ApiProviderPriorityBackground;
+    uint64_t traceId = 0;
+    for (JsonRpcCall *call in liveCalls) {
+        [requestIds addObject:call.requestId];
+        priority = MAX(priority, call.priority);
+        if (!traceId) { traceId = call.traceId; }
+    }
+    
+    void (^handleResponse)(NSObject*, NSData*, NSError*) = ^(NSObject *json, NSData *response, NSError *error) {
+        if (error) {
+            for (JsonRpcCall *call in liveCalls) { [call.promise reject:error]; }
+            return;
         }
         
-        return result; //coerceValue(result, fetchType);
+        // Responses may arrive in any order, so match them by id
+        NSMutableDictionary<NSNumber*, NSDictionary*> *responses = [NSMutableDictionary dictionaryWithCapacity:liveCalls.count];
+        if ([json isKindOfClass:[NSArray class]]) {
+            for (NSDictionary *callResponse in (NSArray*)json) {
+                if (![callResponse isKindOfClass:[NSDictionary class]]) { continue; }
+                NSNumber *requestId = [callResponse objectForKey:@"id"];
+                if ([requestId isKindOfClass:[NSNumber class]]) { [responses setObject:callResponse forKey:requestId]; }
+            }
+        
+        } else if ([json isKindOfClass:[NSDictionary class]] && liveCalls.count == 1) {
+            [responses setObject:(NSDictionary*)json forKey:[liveCalls firstObject].requestId];
+        }
+        
+        for (JsonRpcCall *call in liveCalls) {
+            NSObject *processed = nil;
+            if (!json) {
+                NSDictionary *userInfo = @{@"reason": @"invalid JSON"};
+                processed = [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo];
+                
+            } else {
+                NSDictionary *callResponse = [responses objectForKey:call.requestId];
+                if (callResponse) {
+                    processed = processResponse(callResponse);
+                } else {
+                    
+                    // e.g. a server which does not support batches answers with a single error
+                    NSObject *rpcError = ([json isKindOfClass:[NSDictionary class]] ? processResponse((NSDictionary*)json): nil);
+                    if ([rpcError isKindOfClass:[NSError class]]) {
+                        processed = rpcError;
+                    } else {
+                        NSDictionary *userInfo = @{@"reason": @"missing response"};
+                        processed = [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo];
+                    }
+                }
+            }
+            
+            [self completePromise:call.promise
+                        processed:processed
+                        fetchType:call.fetchType
+                              url:_url
+                             body:call.body
+                         response:response];
+        }
     };
     
-    return [self promiseFetchJSON:_url
-                             body:body
-                        fetchType:fetchType
-                          process:processResponse];
+    // Batches are usually sent from the batch window timer, where no trace is current
+    [ApiProvider performWithPriority:priority block:^() {
+        uint64_t previousTraceId = (traceId ? PromiseTraceSetCurrent(traceId): 0);
+        [self sendRequest:body requestIds:requestIds cancellationToken:cancellationToken callback:handleResponse];
+        if (traceId) { PromiseTraceSetCurrent(previousTraceId); }
+    }];
+}
+
+
+#pragma mark - Transport
+
+- (void)sendRequest: (NSData*)request
+         requestIds: (NSArray<NSNumber*>*)requestIds
+  cancellationToken: (CancellationToken*)cancellationToken
+           callback: (void (^)(NSObject*, NSData*, NSError*))callback {
+    
+    [self fetch:_url body:request cancellationToken:cancellationToken callback:^(NSData *response, NSError *error) {
+        if (error) {
+            callback(nil, nil, error);
+            return;
+        }
+        
+        callback([NSJSONSerialization JSONObjectWithData:response options:0 error:nil], response, nil);
+    }];
+}
+
+
+#pragma mark - Methods
+
+- (id)sendMethod: (NSString*)method params: (NSObject*)params fetchType: (ApiProviderFetchType)fetchType {
+    
+    NSError *error = nil;
+    NSData *paramsData = [NSJSONSerialization dataWithJSONObject:params options:0 error:&error];
+    
+    if (error) {
+        NSDictionary *userInfo = @{@"reason": @"invalid JSON values", @"error": error};
+        return [Promise rejected:[NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorInvalidParameters userInfo:userInfo]];
+    }
+    
+    // The serialized params (which include any block tag) identify identical calls
+    NSString *paramsString = [[NSString alloc] initWithData:paramsData encoding:NSUTF8StringEncoding];
+    
+    return [self singleFlightMethod:method key:paramsString promise:^Promise*() {
+        
+        // Method names are plain identifiers, so need no escaping
+        NSNumber *requestId = @(atomic_fetch_add(&_nextRequestId, 1));
+        NSString *request = [NSString stringWithFormat:@"{\"jsonrpc\":\"2.0\",\"method\":\"%@\",\"id\":%@,\"params\":%@}",
+                             method, requestId, paramsString];
+        NSData *body = [request dataUsingEncoding:NSUTF8StringEncoding];
+        
+        Class promiseClass = getPromiseClass(fetchType);
+        return [(Promise*)[promiseClass alloc] initWithSetup:^(Promise *promise) {
+            if (promise.traceId) { promise.traceName = method; }
+            
+            JsonRpcCall *call = [[JsonRpcCall alloc] initWithRequestId:requestId body:body fetchType:fetchType promise:promise];
+            call.priority = ([method isEqualToString:@"eth_sendRawTransaction"] ? ApiProviderPriorityHigh: [ApiProvider currentPriority]);
+            call.traceId = [PromiseTracer currentTraceId];
+            [self _enqueueCall:call];
+        }];
+    }];
 }
 
 - (BigNumberPromise*)getBalance:(Address *)address blockTag:(BlockTag)blockTag {
@@ -0,0 +1,59 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ *   WebSocketProvider
+ *
+ *   A JsonRpcProvider which talks to its node over a single persistent WebSocket (ws://
+ *   or wss://). Requests are multiplexed over the connection by id, and new blocks are
+ *   pushed by an eth_subscribe("newHeads") subscription rather than polled, so
+ *   ProviderDidReceiveNewBlockNotification is posted as soon as the node sees a block.
+ *
+ *   If the connection drops, outstanding requests fail with ProviderErrorConnectionFailed
+ *   and the provider reconnects (backing off up to maximumReconnectDelay), re-creating
+ *   every subscription. Polling only sends requests while there is no subscription.
+ */
+
+
+#import "JsonRpcProvider.h"
+
+API_AVAILABLE(ios(13.0))
+@interface WebSocketProvider : JsonRpcProvider
+
+@property (nonatomic, readonly) BOOL connected;
+
+// Default: 30 seconds
+@property (atomic, assign) NSTimeInterval maximumReconnectDelay;
+
+// Calls logCallback (on the main thread) with each log matching filter (e.g. address and
+// topics; see eth_subscribe). The returned identifier stays valid across reconnects.
+- (NSString*)subscribeLogs: (NSDictionary*)filter callback: (void (^)(NSDictionary *log))logCallback;
+
+- (void)unsubscribe: (NSString*)identifier;
+
+// Closes the connection, without reconnecting (until the next request)
+- (void)disconnect;
+
+@end
@@ -0,0 +1,473 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import "WebSocketProvider.h"
+
+#import "BigNumber.h"
+
+
+@interface Provider (private)
+
+- (void)setBlockNumber: (NSInteger)blockNumber;
+
+@end
+
+@interface JsonRpcProvider (private)
+
+- (void)doPoll;
+
+@end
+
+
+#define DefaultMaximumReconnectDelay             30.0
+
+static NSError *connectionFailed(NSError *error) {
+    NSMutableDictionary *userInfo = [@{@"reason": @"connection failed"} mutableCopy];
+    if (error) { [userInfo setObject:error forKey:@"error"]; }
+    return [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorConnectionFailed userInfo:userInfo];
+}
+
+
+#pragma mark -
+#pragma mark - WebSocketRequest
+
+// A request waiting for its response; shared by every id in a batch
+@interface WebSocketRequest : NSObject
+
+- (instancetype)initWithRequestIds: (NSArray<NSNumber*>*)requestIds callback: (void (^)(NSObject*, NSData*, NSError*))callback;
+
+@property (nonatomic, readonly) NSArray<NSNumber*> *requestIds;
+@property (nonatomic, readonly) void (^callback)(NSObject*, NSData*, NSError*);
+
+@end
+
+@implementation WebSocketRequest
+
+- (instancetype)initWithRequestIds: (NSArray<NSNumber*>*)requestIds callback: (void (^)(NSObject*, NSData*, NSError*))callback {
+    self = [super init];
+    if (self) {
+        _requestIds = requestIds;
+        _callback = [callback copy];
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - WebSocketSubscription
+
+// A subscription outlives any one connection; the node assigns it a new id on each
+@interface WebSocketSubscription : NSObject
+
+- (instancetype)initWithParams: (NSArray*)params callback: (void (^)(NSDictionary*))callback;
+
+@property (nonatomic, readonly) NSString *identifier;
+@property (nonatomic, readonly) NSArray *params;
+@property (nonatomic, readonly) void (^callback)(NSDictionary*);
+
+@property (nonatomic, copy) NSString *subscriptionId;
+
+@end
+
+@implementation WebSocketSubscription
+
+- (instancetype)initWithParams: (NSArray*)params callback: (void (^)(NSDictionary*))callback {
+    self = [super init];
+    if (self) {
+        _identifier = [[NSUUID UUID] UUIDString];
+        _params = params;
+        _callback = [callback copy];
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - WebSocketProviderDelegate
+
+API_AVAILABLE(ios(13.0))
+@interface WebSocketProvider (private)
+
+- (void)didOpen: (NSURLSessionWebSocketTask*)task;
+
+@end
+
+// The session retains its delegate, so this only holds the provider weakly
+API_AVAILABLE(ios(13.0))
+@interface WebSocketProviderDelegate : NSObject <NSURLSessionWebSocketDelegate>
+
+@property (nonatomic, weak) WebSocketProvider *provider;
+
+@end
+
+@implementation WebSocketProviderDelegate
+
+- (void)URLSession: (NSURLSession*)session webSocketTask: (NSURLSessionWebSocketTask*)webSocketTask didOpenWithProtocol: (NSString*)protocol {
+    [_provider didOpen:webSocketTask];
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - WebSocketProvider
+
+@implementation WebSocketProvider {
+    
+    // Created on first use (the superclass polls during init); guarded by @synchronized (self)
+    NSURLSession *_session;
+    NSURLSessionWebSocketTask *_task;
+    NSMutableDictionary<NSNumber*, WebSocketRequest*> *_requests;
+    
+    NSMutableDictionary<NSString*, WebSocketSubscription*> *_subscriptions;
+    NSMutableDictionary<NSString*, WebSocketSubscription*> *_activeSubscriptions;
+    WebSocketSubscription *_newHeads;
+    
+    NSTimeInterval _reconnectDelay;
+    BOOL _disconnected;
+}
+
+- (instancetype)initWithChainId: (ChainId)chainId url: (NSURL*)url {
+    self = [super initWithChainId:chainId url:url];
+    if (self) {
+        _maximumReconnectDelay = DefaultMaximumReconnectDelay;
+        
+        __weak WebSocketProvider *weakSelf = self;
+        WebSocketSubscription *newHeads = [[WebSocketSubscription alloc] initWithParams:@[ @"newHeads" ] callback:^(NSDictionary *head) {
+            NSString *blockNumber = [head objectForKey:@"number"];
+            if (![blockNumber isKindOfClass:[NSString class]]) { return; }
+            [weakSelf setBlockNumber:[[BigNumber bigNumberWithHexString:blockNumber] integerValue]];
+        }];
+        
+        @synchronized (self) {
+            [self _prepare];
+            _newHeads = newHeads;
+        }
+        [self _addSubscription:newHeads];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_task cancelWithCloseCode:NSURLSessionWebSocketCloseCodeGoingAway reason:nil];
+    [_session invalidateAndCancel];
+}
+
+// The caller must hold the lock
+- (void)_prepare {
+    if (_requests) { return; }
+    
+    _requests = [NSMutableDictionary dictionary];
+    _subscriptions = [NSMutableDictionary dictionary];
+    _activeSubscriptions = [NSMutableDictionary dictionary];
+    
+    WebSocketProviderDelegate *delegate = [[WebSocketProviderDelegate alloc] init];
+    delegate.provider = self;
+    _session = [NSURLSession sessionWithConfiguration:[NSURLSessionConfiguration defaultSessionConfiguration]
+                                             delegate:delegate
+                                        delegateQueue:nil];
+}
+
+
+#pragma mark - Connection
+
+- (NSURLSessionWebSocketTask*)_connect {
+    NSURLSessionWebSocketTask *task = nil;
+    NSArray<WebSocketSubscription*> *subscriptions = nil;
+    
+    @synchronized (self) {
+        [self _prepare];
+        if (_task) { return _task; }
+        
+        _task = [_session webSocketTaskWithURL:self.url];
+        task = _task;
+        subscriptions = [_subscriptions allValues];
+    }
+    
+    [task resume];
+    [self _receive:task];
+    
+    for (WebSocketSubscription *subscription in subscriptions) {
+        [self _subscribe:subscription];
+    }
+    
+    return task;
+}
+
+- (void)didOpen: (NSURLSessionWebSocketTask*)task {
+    @synchronized (self) {
+        if (task != _task) { return; }
+        _connected = YES;
+        _reconnectDelay = 0;
+    }
+}
+
+- (void)_connectionFailed: (NSURLSessionWebSocketTask*)task error: (NSError*)error {
+    NSMutableSet<WebSocketRequest*> *requests = nil;
+    BOOL reconnect = NO;
+    NSTimeInterval reconnectDelay = 0;
+    
+    @synchronized (self) {
+        if (task != _task) { return; }
+        _task = nil;
+        _connected = NO;
+        
+        requests = [NSMutableSet setWithArray:[_requests allValues]];
+        [_requests removeAllObjects];
+        
+        // The node forgets subscriptions with the connection
+        [_activeSubscriptions removeAllObjects];
+        for (WebSocketSubscription *subscription in [_subscriptions allValues]) {
+            subscription.subscriptionId = nil;
+        }
+        
+        reconnect = !_disconnected;
+        _reconnectDelay = MIN(MAX(_reconnectDelay * 2.0, 1.0), self.maximumReconnectDelay);
+        reconnectDelay = _reconnectDelay;
+    }
+    
+    for (WebSocketRequest *request in requests) {
+        request.callback(nil, nil, connectionFailed(error));
+    }
+    
+    if (!reconnect) { return; }
+    
+    __weak WebSocketProvider *weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(reconnectDelay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^() {
+        WebSocketProvider *provider = weakSelf;
+        @synchronized (provider) {
+            if (!provider || provider->_disconnected) { return; }
+        }
+        [provider _connect];
+        
+        // Catch up on any blocks missed while disconnected
+        [provider doPoll];
+    });
+}
+
+- (void)disconnect {
+    NSURLSessionWebSocketTask *task = nil;
+    @synchronized (self) {
+        _disconnected = YES;
+        task = _task;
+    }
+    [task cancelWithCloseCode:NSURLSessionWebSocketCloseCodeNormalClosure reason:nil];
+}
+
+- (void)_receive: (NSURLSessionWebSocketTask*)task {
+    __weak WebSocketProvider *weakSelf = self;
+    [task receiveMessageWithCompletionHandler:^(NSURLSessionWebSocketMessage *message, NSError *error) {
+        WebSocketProvider *provider = weakSelf;
+        if (!provider) { return; }
+        
+        if (error) {
+            [provider _connectionFailed:task error:error];
+            return;
+        }
+        
+        NSData *data = (message.type == NSURLSessionWebSocketMessageTypeString ? [message.string dataUsingEncoding:NSUTF8StringEncoding]: message.data);
+        [provider.metrics recordBytesReceived:data.length];
+        [provider _handleMessage:data];
+        
+        [provider _receive:task];
+    }];
+}
+
+- (void)_handleMessage: (NSData*)message {
+    NSObject *json = [NSJSONSerialization JSONObjectWithData:message options:0 error:nil];
+    
+    // A subscription notification
+    if ([json isKindOfClass:[NSDictionary class]] && [[(NSDictionary*)json objectForKey:@"method"] isEqual:@"eth_subscription"]) {
+        NSDictionary *params = [(NSDictionary*)json objectForKey:@"params"];
+        if (![params isKindOfClass:[NSDictionary class]]) { return; }
+        
+        WebSocketSubscription *subscription = nil;
+        @synchronized (self) {
+            subscription = [_activeSubscriptions objectForKey:[params objectForKey:@"subscription"]];
+        }
+        
+        NSDictionary *result = [params objectForKey:@"result"];
+        if (subscription && [result isKindOfClass:[NSDictionary class]]) {
+            dispatch_async(dispatch_get_main_queue(), ^() {
+                subscription.callback(result);
+            });
+        }
+        return;
+    }
+    
+    // A response (or batch of responses); any one of its ids finds the request
+    NSArray *responses = ([json isKindOfClass:[NSArray class]] ? (NSArray*)json: (json ? @[ json ]: @[]));
+    
+    WebSocketRequest *request = nil;
+    @synchronized (self) {
+        for (NSDictionary *response in responses) {
+            if (![response isKindOfClass:[NSDictionary class]]) { continue; }
+            NSObject *requestId = [response objectForKey:@"id"];
+            if (![requestId isKindOfClass:[NSNumber class]]) { continue; }
+            
+            request = [_requests objectForKey:(NSNumber*)requestId];
+            if (request) { break; }
+        }
+        
+        if (request) { [_requests removeObjectsForKeys:request.requestIds]; }
+    }
+    
+    if (!request) {
+        NSLog(@"WebSocketProvider: unmatched message=%@", [[NSString alloc] initWithData:message encoding:NSUTF8StringEncoding]);
+        return;
+    }
+    
+    request.callback(json, message, nil);
+}
+
+
+#pragma mark - Transport
+
+- (void)sendRequest: (NSData*)request
+         requestIds: (NSArray<NSNumber*>*)requestIds
+  cancellationToken: (CancellationToken*)cancellationToken
+           callback: (void (^)(NSObject*, NSData*, NSError*))callback {
+    
+    WebSocketRequest *pending = [[WebSocketRequest alloc] initWithRequestIds:requestIds callback:callback];
+    
+    @synchronized (self) {
+        _disconnected = NO;
+    }
+    
+    NSURLSessionWebSocketTask *task = [self _connect];
+    
+    @synchronized (self) {
+        for (NSNumber *requestId in requestIds) {
+            [_requests setObject:pending forKey:requestId];
+        }
+    }
+    
+    [self.metrics recordBytesSent:request.length];
+    
+    NSString *message = [[NSString alloc] initWithData:request encoding:NSUTF8StringEncoding];
+    [task sendMessage:[[NSURLSessionWebSocketMessage alloc] initWithString:message] completionHandler:^(NSError *error) {
+        if (!error) { return; }
+        
+        // Unless the connection failing has already failed it
+        BOOL failed = NO;
+        @synchronized (self) {
+            failed = ([_requests objectForKey:[requestIds firstObject]] == pending);
+            if (failed) { [_requests removeObjectsForKeys:requestIds]; }
+        }
+        if (failed) { callback(nil, nil, connectionFailed(error)); }
+    }];
+}
+
+
+#pragma mark - Subscriptions
+
+- (void)_subscribe: (WebSocketSubscription*)subscription {
+    StringPromise *subscribePromise = [self sendMethod:@"eth_subscribe" params:subscription.params fetchType:ApiProviderFetchTypeString];
+    [subscribePromise onCompletion:^(StringPromise *promise) {
+        
+        // Retried when the connection is re-established
+        if (promise.error) {
+            NSLog(@"WebSocketProvider: subscribe failed params=%@ error=%@", subscription.params, promise.error);
+            return;
+        }
+        
+        BOOL unsubscribed = NO;
+        @synchronized (self) {
+            unsubscribed = ([_subscriptions objectForKey:subscription.identifier] != subscription);
+            if (!unsubscribed) {
+                subscription.subscriptionId = promise.value;
+                [_activeSubscriptions setObject:subscription forKey:promise.value];
+            }
+        }
+        
+        // Unsubscribed while we were subscribing
+        if (unsubscribed) {
+            [self sendMethod:@"eth_unsubscribe" params:@[ promise.value ] fetchType:ApiProviderFetchTypeObject];
+        }
+    }];
+}
+
+- (void)_addSubscription: (WebSocketSubscription*)subscription {
+    BOOL connected = NO;
+    @synchronized (self) {
+        [self _prepare];
+        [_subscriptions setObject:subscription forKey:subscription.identifier];
+        connected = (_task != nil);
+    }
+    
+    // Otherwise, connecting subscribes
+    if (connected) {
+        [self _subscribe:subscription];
+    } else {
+        [self _connect];
+    }
+}
+
+- (NSString*)subscribeLogs: (NSDictionary*)filter callback: (void (^)(NSDictionary*))logCallback {
+    WebSocketSubscription *subscription = [[WebSocketSubscription alloc] initWithParams:@[ @"logs", (filter ? filter: @{}) ]
+                                                                               callback:logCallback];
+    [self _addSubscription:subscription];
+    return subscription.identifier;
+}
+
+- (void)unsubscribe: (NSString*)identifier {
+    NSString *subscriptionId = nil;
+    @synchronized (self) {
+        WebSocketSubscription *subscription = [_subscriptions objectForKey:identifier];
+        if (!subscription || subscription == _newHeads) { return; }
+        
+        [_subscriptions removeObjectForKey:identifier];
+        subscriptionId = subscription.subscriptionId;
+        if (subscriptionId) { [_activeSubscriptions removeObjectForKey:subscriptionId]; }
+    }
+    
+    if (subscriptionId) {
+        [self sendMethod:@"eth_unsubscribe" params:@[ subscriptionId ] fetchType:ApiProviderFetchTypeObject];
+    }
+}
+
+
+#pragma mark - Polling
+
+// New blocks are pushed while subscribed, so only poll while we are not
+- (void)doPoll {
+    @synchronized (self) {
+        if (_connected && _newHeads.subscriptionId) { return; }
+    }
+    [super doPoll];
+}
+
+
+#pragma mark - NSObject
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<WebSocketProvider chainId=%d url=%@>", self.chainId, self.url];
+}
+
+@end
@@ -0,0 +1,72 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ *  CachingProvider
+ *
+ *  This provider wraps another provider, answering repeated calls from a cache.
+ *
+ *  Results which can never change (a block by hash, a mined transaction, or values at a
+ *  block at least `confirmations` deep) are kept until evicted, least-recently-used first,
+ *  once the cache exceeds `maximumBytes`. Results for the latest block (balances, nonces,
+ *  code, storage, calls, gas price) are kept until the wrapped provider receives a new
+ *  block, and only while it is polling: they are not cached before its first block, nor
+ *  once `maximumBlockAge` has passed without one. Pending-tag calls and writes are never
+ *  cached.
+ */
+
+#import "Provider.h"
+#import "ProviderMetrics.h"
+
+@interface CachingProvider : Provider
+
+- (instancetype)initWithProvider: (Provider*)provider;
+
+@property (nonatomic, readonly) Provider *provider;
+
+// Default: 4mb (an estimate, covering immutable results only)
+@property (atomic, assign) NSUInteger maximumBytes;
+
+// Blocks this deep are treated as final (default: 12)
+@property (atomic, assign) NSUInteger confirmations;
+
+// Latest-block results are dropped if no new block has arrived for this long (default: 30 seconds)
+@property (atomic, assign) NSTimeInterval maximumBlockAge;
+
+
+#pragma mark - Statistics
+
+@property (nonatomic, readonly) NSUInteger hitCount;
+@property (nonatomic, readonly) NSUInteger missCount;
+
+// Hits and misses by method (e.g. getBalance)
+@property (nonatomic, readonly) ProviderMetrics *metrics;
+
+// The estimated size of the immutable results held
+@property (nonatomic, readonly) NSUInteger cachedBytes;
+
+- (void)removeAllObjects;
+
+@end
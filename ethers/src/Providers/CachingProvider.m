@@ -0,0 +1,479 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import "CachingProvider.h"
+
+#include <stdatomic.h>
+
+#import "SecureData.h"
+
+
+@interface Provider (private)
+
+- (void)setBlockNumber: (NSInteger)blockNumber;
+- (void)setEtherPrice: (float)etherPrice;
+
+@end
+
+
+#define DefaultMaximumBytes              (4 * 1024 * 1024)
+#define DefaultConfirmations             12
+#define DefaultMaximumBlockAge           30.0
+
+typedef enum CacheLifetime {
+    CacheLifetimeNone = 0,
+    CacheLifetimeBlock,                  // Until the next block
+    CacheLifetimeForever                 // Until evicted
+} CacheLifetime;
+
+// A rough estimate of the memory held by a result
+static NSUInteger estimateCost(NSObject *result) {
+    if ([result isKindOfClass:[NSData class]]) {
+        return 64 + [(NSData*)result length];
+    } else if ([result isKindOfClass:[TransactionInfo class]]) {
+        return 512 + [(TransactionInfo*)result data].length;
+    } else if ([result isKindOfClass:[BlockInfo class]]) {
+        return 512 + 48 * [(BlockInfo*)result transactionHashes].count;
+    }
+    return 64;
+}
+
+
+#pragma mark -
+#pragma mark - CachingProviderEntry
+
+// An immutable result, in a list from most to least recently used
+@interface CachingProviderEntry : NSObject
+
+- (instancetype)initWithKey: (NSString*)key result: (NSObject*)result;
+
+@property (nonatomic, readonly) NSString *key;
+@property (nonatomic, readonly) NSObject *result;
+@property (nonatomic, readonly) NSUInteger cost;
+
+@property (nonatomic, strong) CachingProviderEntry *next;
+@property (nonatomic, unsafe_unretained) CachingProviderEntry *previous;
+
+@end
+
+@implementation CachingProviderEntry
+
+- (instancetype)initWithKey: (NSString*)key result: (NSObject*)result {
+    self = [super init];
+    if (self) {
+        _key = key;
+        _result = result;
+        _cost = key.length + estimateCost(result);
+    }
+    return self;
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - CachingProvider
+
+@implementation CachingProvider {
+    
+    // Guarded by @synchronized (_entries)
+    NSMutableDictionary<NSString*, CachingProviderEntry*> *_entries;
+    CachingProviderEntry *_mostRecentlyUsed, *_leastRecentlyUsed;
+    NSUInteger _cachedBytes;
+    
+    NSMutableDictionary<NSString*, NSObject*> *_blockResults;
+    NSUInteger _blockGeneration;
+    NSInteger _latestBlockNumber;
+    NSTimeInterval _latestBlockTime;
+    
+    atomic_ulong _hitCount, _missCount;
+}
+
+- (instancetype)initWithProvider: (Provider*)provider {
+    self = [super initWithChainId:provider.chainId];
+    if (self) {
+        _provider = provider;
+        
+        _maximumBytes = DefaultMaximumBytes;
+        _confirmations = DefaultConfirmations;
+        _maximumBlockAge = DefaultMaximumBlockAge;
+        
+        _entries = [NSMutableDictionary dictionary];
+        _blockResults = [NSMutableDictionary dictionary];
+        _latestBlockNumber = -1;
+        
+        _metrics = [[ProviderMetrics alloc] initWithName:NSStringFromClass([self class])];
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(noticeNewBlock:)
+                                                     name:ProviderDidReceiveNewBlockNotification
+                                                   object:provider];
+        
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(noticeEtherPrice:)
+                                                     name:ProviderEtherPriceChangedNotification
+                                                   object:provider];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+}
+
+- (void)noticeNewBlock: (NSNotification*)note {
+    NSInteger blockNumber = [[note.userInfo objectForKey:@"blockNumber"] integerValue];
+    
+    @synchronized (_entries) {
+        _latestBlockNumber = blockNumber;
+        _latestBlockTime = [NSDate timeIntervalSinceReferenceDate];
+        _blockGeneration++;
+        [_blockResults removeAllObjects];
+    }
+    
+    [self setBlockNumber:blockNumber];
+}
+
+- (void)noticeEtherPrice: (NSNotification*)note {
+    [self setEtherPrice:[[note.userInfo objectForKey:@"price"] floatValue]];
+}
+
+- (void)reset {
+    [self removeAllObjects];
+    [_provider reset];
+}
+
+- (void)startPolling {
+    [super startPolling];
+    [_provider startPolling];
+}
+
+- (void)stopPolling {
+    [super stopPolling];
+    [_provider stopPolling];
+}
+
+
+#pragma mark - Cache
+
+- (NSUInteger)hitCount {
+    return atomic_load(&_hitCount);
+}
+
+- (NSUInteger)missCount {
+    return atomic_load(&_missCount);
+}
+
+- (NSUInteger)cachedBytes {
+    @synchronized (_entries) {
+        return _cachedBytes;
+    }
+}
+
+- (void)removeAllObjects {
+    @synchronized (_entries) {
+        [_entries removeAllObjects];
+        _mostRecentlyUsed = nil;
+        _leastRecentlyUsed = nil;
+        _cachedBytes = 0;
+        
+        _blockGeneration++;
+        [_blockResults removeAllObjects];
+    }
+}
+
+// Whether a new block would (as far as we know) have arrived to invalidate latest-block results,
+// which is only while the wrapped provider is polling; the caller must hold the lock
+- (BOOL)_isTrackingBlocks {
+    if (_latestBlockNumber < 0) { return NO; }
+    return ([NSDate timeIntervalSinceReferenceDate] - _latestBlockTime) <= self.maximumBlockAge;
+}
+
+// Results at a block are only final once it is confirmations deep; the caller must hold the lock
+- (CacheLifetime)_lifetimeForBlockNumber: (NSInteger)blockNumber {
+    if (_latestBlockNumber < 0) { return CacheLifetimeNone; }
+    if (blockNumber >= 0 && blockNumber + (NSInteger)self.confirmations <= _latestBlockNumber) {
+        return CacheLifetimeForever;
+    }
+    return ([self _isTrackingBlocks] ? CacheLifetimeBlock: CacheLifetimeNone);
+}
+
+- (CacheLifetime)_lifetimeForBlockTag: (BlockTag)blockTag {
+    if (blockTag == BLOCK_TAG_PENDING) { return CacheLifetimeNone; }
+    @synchronized (_entries) {
+        return [self _lifetimeForBlockNumber:blockTag];
+    }
+}
+
+- (void)_unlinkEntry: (CachingProviderEntry*)entry {
+    if (entry.previous) { entry.previous.next = entry.next; } else { _mostRecentlyUsed = entry.next; }
+    if (entry.next) { entry.next.previous = entry.previous; } else { _leastRecentlyUsed = entry.previous; }
+    entry.next = nil;
+    entry.previous = nil;
+}
+
+- (void)_linkEntry: (CachingProviderEntry*)entry {
+    entry.next = _mostRecentlyUsed;
+    if (_mostRecentlyUsed) { _mostRecentlyUsed.previous = entry; } else { _leastRecentlyUsed = entry; }
+    _mostRecentlyUsed = entry;
+}
+
+- (NSObject*)_resultForKey: (NSString*)key {
+    @synchronized (_entries) {
+        CachingProviderEntry *entry = [_entries objectForKey:key];
+        if (entry) {
+            if (entry != _mostRecentlyUsed) {
+                [self _unlinkEntry:entry];
+                [self _linkEntry:entry];
+            }
+            return entry.result;
+        }
+        
+        // Without new blocks, nothing else would ever drop these
+        if (_blockResults.count && ![self _isTrackingBlocks]) {
+            _blockGeneration++;
+            [_blockResults removeAllObjects];
+        }
+        
+        return [_blockResults objectForKey:key];
+    }
+}
+
+- (void)_storeResult: (NSObject*)result
+              forKey: (NSString*)key
+            lifetime: (CacheLifetime)lifetime
+     blockGeneration: (NSUInteger)blockGeneration {
+    
+    @synchronized (_entries) {
+        if (lifetime == CacheLifetimeBlock) {
+            
+            // A new block arrived while the request was in flight, so the result may be stale
+            if (blockGeneration != _blockGeneration) { return; }
+            [_blockResults setObject:result forKey:key];
+            
+        } else if (lifetime == CacheLifetimeForever) {
+            CachingProviderEntry *existing = [_entries objectForKey:key];
+            if (existing) {
+                [self _unlinkEntry:existing];
+                _cachedBytes -= existing.cost;
+            }
+            
+            CachingProviderEntry *entry = [[CachingProviderEntry alloc] initWithKey:key result:result];
+            [_entries setObject:entry forKey:key];
+            [self _linkEntry:entry];
+            _cachedBytes += entry.cost;
+            
+            NSUInteger maximumBytes = self.maximumBytes;
+            while (_cachedBytes > maximumBytes && _leastRecentlyUsed) {
+                CachingProviderEntry *evict = _leastRecentlyUsed;
+                [self _unlinkEntry:evict];
+                [_entries removeObjectForKey:evict.key];
+                _cachedBytes -= evict.cost;
+            }
+        }
+    }
+}
+
+// Returns a cached result, or fetches it (caching it for as long as lifetime says, given the result)
+- (id)promiseForKey: (NSString*)key
+       promiseClass: (Class)promiseClass
+           lifetime: (CacheLifetime (^)(NSObject*))lifetime
+              fetch: (Promise* (^)(Provider*))fetch {
+    
+    NSUInteger blockGeneration = 0;
+    NSObject *result = nil;
+    @synchronized (_entries) {
+        result = [self _resultForKey:key];
+        blockGeneration = _blockGeneration;
+    }
+    
+    // Keys start with the method (e.g. "getBalance/0x...")
+    NSString *method = [[key componentsSeparatedByString:@"/"] firstObject];
+    
+    if (result) {
+        atomic_fetch_add_explicit(&_hitCount, 1, memory_order_relaxed);
+        [_metrics recordCacheHit:YES forMethod:method];
+        return [promiseClass resolved:([result isEqual:[NSNull null]] ? nil: result)];
+    }
+    
+    atomic_fetch_add_explicit(&_missCount, 1, memory_order_relaxed);
+    [_metrics recordCacheHit:NO forMethod:method];
+    
+    Promise *promise = fetch(_provider);
+    [promise onCompletion:^(Promise *promise) {
+        if (promise.error) { return; }
+        
+        // A JSON null result resolves to nil, so is stored as NSNull (which a hit unwraps)
+        NSObject *result = (promise.result ?: [NSNull null]);
+        CacheLifetime resultLifetime = CacheLifetimeNone;
+        @synchronized (_entries) {
+            resultLifetime = lifetime(result);
+        }
+        [self _storeResult:result forKey:key lifetime:resultLifetime blockGeneration:blockGeneration];
+    }];
+    
+    return promise;
+}
+
+- (id)promiseForKey: (NSString*)key
+       promiseClass: (Class)promiseClass
+           blockTag: (BlockTag)blockTag
+              fetch: (Promise* (^)(Provider*))fetch {
+    
+    CacheLifetime lifetime = [self _lifetimeForBlockTag:blockTag];
+    if (lifetime == CacheLifetimeNone) { return fetch(_provider); }
+    
+    return [self promiseForKey:[NSString stringWithFormat:@"%@/%d", key, (int)blockTag]
+                  promiseClass:promiseClass
+                      lifetime:^CacheLifetime(NSObject *result) { return lifetime; }
+                         fetch:fetch];
+}
+
+
+#pragma mark - Methods
+
+- (BigNumberPromise*)getBalance: (Address*)address blockTag: (BlockTag)blockTag {
+    return [self promiseForKey:[@"getBalance/" stringByAppendingString:address.checksumAddress]
+                  promiseClass:[BigNumberPromise class]
+                      blockTag:blockTag
+                         fetch:^Promise*(Provider *provider) {
+                             return [provider getBalance:address blockTag:blockTag];
+                         }];
+}
+
+- (IntegerPromise*)getTransactionCount: (Address*)address blockTag: (BlockTag)blockTag {
+    return [self promiseForKey:[@"getTransactionCount/" stringByAppendingString:address.checksumAddress]
+                  promiseClass:[IntegerPromise class]
+                      blockTag:blockTag
+                         fetch:^Promise*(Provider *provider) {
+                             return [provider getTransactionCount:address blockTag:blockTag];
+                         }];
+}
+
+- (DataPromise*)getCode: (Address*)address {
+    return [self promiseForKey:[@"getCode/" stringByAppendingString:address.checksumAddress]
+                  promiseClass:[DataPromise class]
+                      blockTag:BLOCK_TAG_LATEST
+                         fetch:^Promise*(Provider *provider) {
+                             return [provider getCode:address];
+                         }];
+}
+
+- (IntegerPromise*)getBlockNumber {
+    return [_provider getBlockNumber];
+}
+
+- (BigNumberPromise*)getGasPrice {
+    return [self promiseForKey:@"getGasPrice"
+                  promiseClass:[BigNumberPromise class]
+                      blockTag:BLOCK_TAG_LATEST
+                         fetch:^Promise*(Provider *provider) {
+                             return [provider getGasPrice];
+                         }];
+}
+
+- (DataPromise*)call: (Transaction*)transaction {
+    NSString *key = [NSString stringWithFormat:@"call/%@/%@/%@/%@/%@",
+                     transaction.toAddress.checksumAddress, transaction.fromAddress.checksumAddress,
+                     [transaction.value hexString], [transaction.gasLimit hexString],
+                     [SecureData dataToHexString:transaction.data]];
+    
+    return [self promiseForKey:key
+                  promiseClass:[DataPromise class]
+                      blockTag:BLOCK_TAG_LATEST
+                         fetch:^Promise*(Provider *provider) {
+                             return [provider call:transaction];
+                         }];
+}
+
+- (BigNumberPromise*)estimateGas: (Transaction*)transaction {
+    return [_provider estimateGas:transaction];
+}
+
+- (HashPromise*)sendTransaction: (NSData*)signedTransaction {
+    return [_provider sendTransaction:signedTransaction];
+}
+
+- (BlockInfoPromise*)getBlockByBlockHash: (Hash*)blockHash {
+    return [self promiseForKey:[@"getBlock/" stringByAppendingString:blockHash.hexString]
+                  promiseClass:[BlockInfoPromise class]
+                      lifetime:^CacheLifetime(NSObject *result) {
+                          if (![result isKindOfClass:[BlockInfo class]]) { return CacheLifetimeNone; }
+                          return [self _lifetimeForBlockNumber:((BlockInfo*)result).blockNumber];
+                      }
+                         fetch:^Promise*(Provider *provider) {
+                             return [provider getBlockByBlockHash:blockHash];
+                         }];
+}
+
+- (BlockInfoPromise*)getBlockByBlockTag: (BlockTag)blockTag {
+    return [self promiseForKey:@"getBlock"
+                  promiseClass:[BlockInfoPromise class]
+                      blockTag:blockTag
+                         fetch:^Promise*(Provider *provider) {
+                             return [provider getBlockByBlockTag:blockTag];
+                         }];
+}
+
+- (HashPromise*)getStorageAt: (Address*)address position: (BigNumber*)position {
+    NSString *key = [NSString stringWithFormat:@"getStorageAt/%@/%@", address.checksumAddress, [position hexString]];
+    return [self promiseForKey:key
+                  promiseClass:[HashPromise class]
+                      blockTag:BLOCK_TAG_LATEST
+                         fetch:^Promise*(Provider *provider) {
+                             return [provider getStorageAt:address position:position];
+                         }];
+}
+
+- (TransactionInfoPromise*)getTransaction: (Hash*)transactionHash {
+    return [self promiseForKey:[@"getTransaction/" stringByAppendingString:transactionHash.hexString]
+                  promiseClass:[TransactionInfoPromise class]
+                      lifetime:^CacheLifetime(NSObject *result) {
+                          
+                          // Unmined (or unknown) transactions may change at any moment
+                          if (![result isKindOfClass:[TransactionInfo class]]) { return CacheLifetimeNone; }
+                          TransactionInfo *transactionInfo = (TransactionInfo*)result;
+                          if (!transactionInfo.blockHash || transactionInfo.blockNumber < 0) { return CacheLifetimeNone; }
+                          
+                          return [self _lifetimeForBlockNumber:transactionInfo.blockNumber];
+                      }
+                         fetch:^Promise*(Provider *provider) {
+                             return [provider getTransaction:transactionHash];
+                         }];
+}
+
+- (ArrayPromise*)getTransactions: (Address*)address startBlockTag: (BlockTag)blockTag {
+    return [_provider getTransactions:address startBlockTag:blockTag];
+}
+
+- (FloatPromise*)getEtherPrice {
+    return [_provider getEtherPrice];
+}
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<CachingProvider provider=%@>", _provider];
+}
+
+@end
@@ -27,21 +27,68 @@
  *  FallbackProvider
  *
  *  This provider will attempt to call the same method on its child providers,
- *  in order until a successful response is returned. The next provider is
- *  not called until the previous one has failed.
+ *  in order until a successful response is returned. By default, the next
+ *  provider is not called until the previous one has failed; the strategy
+ *  trades extra requests for lower tail latency (or for agreement).
+ *
+ *  Whichever strategy, once a result is settled any requests still in flight
+ *  are cancelled.
  */
 
 
 #import "Provider.h"
 
+typedef NS_ENUM(NSInteger, FallbackProviderStrategy) {
+    
+    // Each provider in turn, once the previous one has failed
+    FallbackProviderStrategySequential          = 0,
+    
+    // As sequential, but also tries the next provider if the current one has not answered
+    // within its 95th percentile latency; the first success wins
+    FallbackProviderStrategyHedged,
+    
+    // Every provider at once; the first success wins
+    FallbackProviderStrategyRace,
+    
+    // Every provider at once; the first result that quorum providers agree on wins (blocks and
+    // transactions agree only if their block hash and number match). Sending a transaction
+    // races instead, as only one node need accept it.
+    FallbackProviderStrategyQuorum,
+};
+
 @interface FallbackProvider : Provider
 
 @property (nonatomic, readonly) NSUInteger count;
 
+// Default: FallbackProviderStrategySequential
+@property (atomic, assign) FallbackProviderStrategy strategy;
+
+// The hedge delay for a provider which has not yet answered enough calls to estimate its
+// 95th percentile latency (default: 1 second)
+@property (atomic, assign) NSTimeInterval hedgeDelay;
+
+// The number of providers which must agree (default: 0, for a majority of the providers)
+@property (atomic, assign) NSUInteger quorum;
+
+// Orders providers by a moving average of their latency, plus a penalty for their recent
+// error rate, rather than as added. A provider which keeps failing, or is throttled, is ejected
+// for ejectionDuration; after that, the next call to it is a probe. A successful probe
+// restores it, and a failed probe ejects it again for twice as long (default: NO).
+@property (atomic, assign) BOOL adaptive;
+
+// Consecutive failures before a provider is ejected (default: 5)
+@property (atomic, assign) NSUInteger ejectionThreshold;
+
+// Default: 30 seconds
+@property (atomic, assign) NSTimeInterval ejectionDuration;
+
 - (BOOL)addProvider: (Provider*)provider;
 - (Provider*)providerAtIndex: (NSUInteger)index;
 - (void)removeProviderAtIndex: (NSUInteger)index;
 
 - (NSArray<Provider*>*)orderedProviders;
 
+// The providers in the order the next call will try them (orderedProviders, unless adaptive)
+- (NSArray<Provider*>*)rankedProviders;
+
 @end
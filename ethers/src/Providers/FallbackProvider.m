@@ -33,21 +33,422 @@
 
 @end
 
+
+#define DefaultHedgeDelay                        1.0
+
+// Latencies are kept for this many recent successful calls per provider
+#define LatencySampleCount                       64
+
+// A provider needs this many samples before its 95th percentile is trusted
+#define MinimumLatencySamples                    16
+
+// The weight of the latest call in the moving averages of latency and error rate
+#define AverageWeight                            0.2
+
+// What a failed call is assumed to cost, in seconds, when scoring a provider; the caller
+// still has to try elsewhere (and failures are often timeouts)
+#define FailurePenalty                           1.0
+
+#define DefaultEjectionThreshold                 5
+#define DefaultEjectionDuration                  30.0
+
+// Each failed probe doubles how long a provider stays ejected, up to this many times
+#define MaximumEjectionDoublings                 3
+
+
+#pragma mark -
+#pragma mark - FallbackProviderStats
+
+@interface FallbackProviderStats : NSObject
+
+- (void)recordSuccess: (NSTimeInterval)latency;
+
+// A lower bound on the latency of a call cancelled before it finished (e.g. one that lost
+// to a hedged request); it is a latency sample, but says nothing else about the provider
+- (void)recordCensoredLatency: (NSTimeInterval)latency;
+
+// A throttled provider is ejected at once, otherwise after ejectionThreshold consecutive failures
+- (void)recordFailure: (BOOL)throttled ejectionThreshold: (NSUInteger)ejectionThreshold ejectionDuration: (NSTimeInterval)ejectionDuration;
+
+// Returns a negative value if there are not enough samples yet
+- (NSTimeInterval)latencyPercentile: (double)percentile;
+
+// The expected cost of a call; lower is better. Untried providers score 0, so they are tried.
+@property (atomic, readonly) double score;
+
+// NO while ejected; once the ejection expires, the next call to it is a probe
+@property (atomic, readonly) BOOL available;
+
+@end
+
+@implementation FallbackProviderStats {
+    NSTimeInterval _latencies[LatencySampleCount];
+    NSUInteger _latencyCount;
+    NSUInteger _nextLatency;
+    
+    NSTimeInterval _averageLatency;
+    double _errorRate;
+    
+    NSUInteger _consecutiveFailures;
+    NSUInteger _ejectionCount;
+    NSTimeInterval _ejectedUntil;
+}
+
+// The caller must hold the lock
+- (void)_addLatencySample: (NSTimeInterval)latency {
+    _latencies[_nextLatency] = latency;
+    _nextLatency = (_nextLatency + 1) % LatencySampleCount;
+    if (_latencyCount < LatencySampleCount) { _latencyCount++; }
+}
+
+- (void)recordSuccess: (NSTimeInterval)latency {
+    @synchronized (self) {
+        [self _addLatencySample:latency];
+        
+        _averageLatency = (_latencyCount == 1) ? latency: (AverageWeight * latency + (1.0 - AverageWeight) * _averageLatency);
+        _errorRate = (1.0 - AverageWeight) * _errorRate;
+        
+        _consecutiveFailures = 0;
+        _ejectionCount = 0;
+        _ejectedUntil = 0;
+    }
+}
+
+- (void)recordCensoredLatency: (NSTimeInterval)latency {
+    @synchronized (self) {
+        [self _addLatencySample:latency];
+    }
+}
+
+- (void)recordFailure: (BOOL)throttled ejectionThreshold: (NSUInteger)ejectionThreshold ejectionDuration: (NSTimeInterval)ejectionDuration {
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    
+    @synchronized (self) {
+        _errorRate = AverageWeight + (1.0 - AverageWeight) * _errorRate;
+        _consecutiveFailures++;
+        
+        // Already ejected (this call was in flight before it was)
+        if (now < _ejectedUntil) { return; }
+        
+        // A failed probe (after an ejection expired) ejects it again, for longer
+        BOOL probe = (_ejectedUntil != 0);
+        
+        if (throttled || probe || _consecutiveFailures >= ejectionThreshold) {
+            _ejectedUntil = now + ejectionDuration * (1 << MIN(_ejectionCount, MaximumEjectionDoublings));
+            _ejectionCount++;
+        }
+    }
+}
+
+- (double)score {
+    @synchronized (self) {
+        return _averageLatency + _errorRate * FailurePenalty;
+    }
+}
+
+- (BOOL)available {
+    @synchronized (self) {
+        return ([NSDate timeIntervalSinceReferenceDate] >= _ejectedUntil);
+    }
+}
+
+static int compareLatency(const void *a, const void *b) {
+    NSTimeInterval latencyA = *(const NSTimeInterval*)a, latencyB = *(const NSTimeInterval*)b;
+    return (latencyA < latencyB) ? -1: ((latencyA > latencyB) ? 1: 0);
+}
+
+- (NSTimeInterval)latencyPercentile: (double)percentile {
+    NSTimeInterval latencies[LatencySampleCount];
+    NSUInteger count = 0;
+    @synchronized (self) {
+        count = _latencyCount;
+        memcpy(latencies, _latencies, count * sizeof(NSTimeInterval));
+    }
+    
+    if (count < MinimumLatencySamples) { return -1.0; }
+    
+    qsort(latencies, count, sizeof(NSTimeInterval), compareLatency);
+    return latencies[MIN(count - 1, (NSUInteger)(percentile * count))];
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - FallbackOperation
+
+@interface FallbackProvider (private)
+
+- (FallbackProviderStats*)statsForProvider: (Provider*)provider;
+
+@end
+
+// What quorum providers must agree on; TransactionInfo equality compares only the hash (so a
+// pending and a mined copy would agree) and BlockInfo equality is identity (so no two
+// providers' copies of a block would)
+static NSObject *getQuorumKey(NSObject *result) {
+    if ([result isKindOfClass:[TransactionInfo class]]) {
+        TransactionInfo *transactionInfo = (TransactionInfo*)result;
+        return @[ (transactionInfo.transactionHash ?: [NSNull null]), (transactionInfo.blockHash ?: [NSNull null]), @(transactionInfo.blockNumber) ];
+    
+    } else if ([result isKindOfClass:[BlockInfo class]]) {
+        BlockInfo *blockInfo = (BlockInfo*)result;
+        return @[ (blockInfo.blockHash ?: [NSNull null]), @(blockInfo.blockNumber) ];
+    
+    } else if ([result isKindOfClass:[NSArray class]]) {
+        NSMutableArray *keys = [NSMutableArray arrayWithCapacity:((NSArray*)result).count];
+        for (NSObject *item in (NSArray*)result) { [keys addObject:getQuorumKey(item)]; }
+        return keys;
+    }
+    
+    return result;
+}
+
+// The state of one call, across however many providers it is sent to
+@interface FallbackOperation : NSObject
+
+- (instancetype)initWithFallbackProvider: (FallbackProvider*)fallbackProvider
+                               providers: (NSArray<Provider*>*)providers
+                                strategy: (FallbackProviderStrategy)strategy
+                           startCallback: (Promise* (^)(Provider*))startCallback
+                                 promise: (Promise*)promise;
+
+- (void)start;
+
+@end
+
+@implementation FallbackOperation {
+    FallbackProvider *_fallbackProvider;
+    NSArray<Provider*> *_providers;
+    FallbackProviderStrategy _strategy;
+    Promise* (^_startCallback)(Provider*);
+    Promise *_promise;
+    
+    NSUInteger _quorum;
+    NSTimeInterval _hedgeDelay;
+    
+    // Guarded by @synchronized (self)
+    NSMutableArray<Promise*> *_childPromises;
+    NSUInteger _completedCount;
+    NSMutableArray<NSObject*> *_results;
+    NSCountedSet *_resultKeys;
+    NSError *_lastError;
+}
+
+- (instancetype)initWithFallbackProvider: (FallbackProvider*)fallbackProvider
+                               providers: (NSArray<Provider*>*)providers
+                                strategy: (FallbackProviderStrategy)strategy
+                           startCallback: (Promise* (^)(Provider*))startCallback
+                                 promise: (Promise*)promise {
+    
+    self = [super init];
+    if (self) {
+        _fallbackProvider = fallbackProvider;
+        _providers = providers;
+        _strategy = strategy;
+        _startCallback = startCallback;
+        _promise = promise;
+        
+        _quorum = fallbackProvider.quorum;
+        if (_quorum == 0) { _quorum = providers.count / 2 + 1; }
+        _hedgeDelay = fallbackProvider.hedgeDelay;
+        
+        _childPromises = [NSMutableArray arrayWithCapacity:providers.count];
+        _results = [NSMutableArray arrayWithCapacity:providers.count];
+        _resultKeys = [NSCountedSet set];
+    }
+    return self;
+}
+
+- (void)start {
+    
+    // The token keeps its callbacks until cancelled, and this operation keeps the promise
+    __weak FallbackOperation *weakSelf = self;
+    [_promise.cancellationToken onCancel:^() {
+        [weakSelf cancelAll];
+    }];
+    
+    if (_strategy == FallbackProviderStrategyRace || _strategy == FallbackProviderStrategyQuorum) {
+        for (NSUInteger i = 0; i < _providers.count; i++) { [self startNext]; }
+    } else {
+        [self startNext];
+    }
+}
+
+- (void)cancelAll {
+    NSArray<Promise*> *childPromises = nil;
+    @synchronized (self) {
+        childPromises = [_childPromises copy];
+    }
+    
+    for (Promise *childPromise in childPromises) {
+        
+        // Skip a slot reserved by a provider still starting
+        if (![childPromise isKindOfClass:[Promise class]]) { continue; }
+        [childPromise cancel];
+    }
+}
+
+// Returns NO if every provider has already been started
+- (BOOL)startNext {
+    if (_promise.complete) { return NO; }
+    
+    NSUInteger index = 0;
+    @synchronized (self) {
+        index = _childPromises.count;
+        if (index == _providers.count) { return NO; }
+        
+        // Reserve the slot, so concurrent callers start different providers
+        [_childPromises addObject:(Promise*)[NSNull null]];
+    }
+    
+    Provider *provider = [_providers objectAtIndex:index];
+    NSTimeInterval startTime = [NSDate timeIntervalSinceReferenceDate];
+    
+    Promise *childPromise = _startCallback(provider);
+    @synchronized (self) {
+        [_childPromises replaceObjectAtIndex:index withObject:childPromise];
+    }
+    
+    // Settled while this provider was starting
+    if (_promise.complete) { [childPromise cancel]; }
+    
+    // Hedge, if this provider is slower than it usually is
+    FallbackProviderStats *stats = [_fallbackProvider statsForProvider:provider];
+    NSTimeInterval hedgeDelay = -1.0;
+    if (_strategy == FallbackProviderStrategyHedged && index + 1 < _providers.count) {
+        hedgeDelay = [stats latencyPercentile:0.95];
+        if (hedgeDelay < 0) { hedgeDelay = _hedgeDelay; }
+    }
+    
+    [childPromise onCompletion:^(Promise *childPromise) {
+        NSTimeInterval latency = [NSDate timeIntervalSinceReferenceDate] - startTime;
+        
+        // A request that lost to its hedge took at least the hedge delay; sampling only the
+        // winners would pull the percentile (and so the next hedge delay) ever lower
+        if (childPromise.cancelled && hedgeDelay >= 0) {
+            [stats recordCensoredLatency:MAX(latency, hedgeDelay)];
+        }
+        
+        [self provider:provider didComplete:childPromise latency:latency];
+    }];
+    
+    if (hedgeDelay >= 0) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(hedgeDelay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^() {
+            @synchronized (self) {
+                
+                // A later provider was already started (e.g. this one failed)
+                if (_childPromises.count != index + 1) { return; }
+            }
+            [self startNext];
+        });
+    }
+    
+    return YES;
+}
+
+- (void)provider: (Provider*)provider didComplete: (Promise*)childPromise latency: (NSTimeInterval)latency {
+    // Cancelled calls and missing methods say nothing about the provider's health
+    FallbackProviderStats *stats = [_fallbackProvider statsForProvider:provider];
+    if (!childPromise.error) {
+        [stats recordSuccess:latency];
+    } else if (!childPromise.cancelled && childPromise.error.code != ProviderErrorNotImplemented) {
+        [stats recordFailure:(childPromise.error.code == ProviderErrorThrottled)
+           ejectionThreshold:_fallbackProvider.ejectionThreshold
+            ejectionDuration:_fallbackProvider.ejectionDuration];
+    }
+    
+    if (_promise.complete) { return; }
+    
+    if (childPromise.error) {
+        if (childPromise.error.code != ProviderErrorNotImplemented && !childPromise.cancelled) {
+            NSLog(@"FallbackProvider: error=%@ provider=%@", childPromise.error, provider);
+        }
+        
+        @synchronized (self) {
+            _completedCount++;
+            _lastError = childPromise.error;
+        }
+        
+        // Sequential and hedged calls move on to the next provider
+        if ([self startNext]) { return; }
+        
+    } else {
+        NSObject *result = (childPromise.result ? childPromise.result: [NSNull null]);
+        
+        BOOL agreed = YES;
+        if (_strategy == FallbackProviderStrategyQuorum) {
+            NSObject *key = getQuorumKey(result);
+            @synchronized (self) {
+                _completedCount++;
+                [_results addObject:result];
+                [_resultKeys addObject:key];
+                agreed = ([_resultKeys countForObject:key] >= _quorum);
+            }
+        }
+        
+        if (agreed) {
+            [_promise resolve:childPromise.result];
+            [self cancelAll];
+            return;
+        }
+    }
+    
+    // Done, once every provider has answered without a result (or without agreement)
+    NSError *error = nil;
+    @synchronized (self) {
+        if (_completedCount < _providers.count) { return; }
+        
+        if (_strategy == FallbackProviderStrategyQuorum && _results.count) {
+            NSDictionary *userInfo = @{@"reason": @"no quorum", @"results": [_results copy]};
+            error = [NSError errorWithDomain:ProviderErrorDomain code:ProviderErrorBadResponse userInfo:userInfo];
+        } else {
+            error = _lastError;
+        }
+    }
+    
+    if (!_promise.complete) { [_promise reject:error]; }
+}
+
+@end
+
+
 #pragma mark -
 #pragma mark - FallbackProvider
 
 @implementation FallbackProvider {
     NSArray<Provider*> *_orderedProviders;
+    
+    // Guarded by @synchronized (_stats)
+    NSMapTable<Provider*, FallbackProviderStats*> *_stats;
 }
 
 - (instancetype)initWithChainId:(ChainId)chainId {
     self = [super initWithChainId:chainId];
     if (self) {
         _orderedProviders = [NSArray array];
+        _stats = [NSMapTable weakToStrongObjectsMapTable];
+        
+        _strategy = FallbackProviderStrategySequential;
+        _hedgeDelay = DefaultHedgeDelay;
+        
+        _ejectionThreshold = DefaultEjectionThreshold;
+        _ejectionDuration = DefaultEjectionDuration;
     }
     return self;
 }
 
+- (FallbackProviderStats*)statsForProvider: (Provider*)provider {
+    @synchronized (_stats) {
+        FallbackProviderStats *stats = [_stats objectForKey:provider];
+        if (!stats) {
+            stats = [[FallbackProviderStats alloc] init];
+            [_stats setObject:stats forKey:provider];
+        }
+        return stats;
+    }
+}
+
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self];
 }
@@ -112,6 +513,28 @@
     }
 }
 
+- (NSArray<Provider*>*)rankedProviders {
+    NSArray<Provider*> *providers = [self orderedProviders];
+    if (!self.adaptive) { return providers; }
+    
+    NSMutableArray<Provider*> *available = [NSMutableArray arrayWithCapacity:providers.count];
+    NSMapTable<Provider*, NSNumber*> *scores = [NSMapTable strongToStrongObjectsMapTable];
+    for (Provider *provider in providers) {
+        FallbackProviderStats *stats = [self statsForProvider:provider];
+        if (!stats.available) { continue; }
+        [available addObject:provider];
+        [scores setObject:@(stats.score) forKey:provider];
+    }
+    
+    // Every provider is ejected; trying one anyway beats failing outright
+    if (available.count == 0) { return providers; }
+    
+    // Stable, so equally scored providers keep their order (e.g. shuffled by RoundRobinProvider)
+    return [available sortedArrayWithOptions:NSSortStable usingComparator:^NSComparisonResult(Provider *a, Provider *b) {
+        return [[scores objectForKey:a] compare:[scores objectForKey:b]];
+    }];
+}
+
 - (void)reset {
     NSArray<Provider*> *providers = [self orderedProviders];
 
@@ -143,8 +566,8 @@
 
 #pragma mark - Calling
 
-- (id)executeOperation: (Promise* (^)(Provider*))startCallback promiseClass: (Class)promiseClass {
-    NSArray<Provider*> *providers = [self orderedProviders];
+- (id)executeOperation: (Promise* (^)(Provider*))startCallback promiseClass: (Class)promiseClass strategy: (FallbackProviderStrategy)strategy {
+    NSArray<Provider*> *providers = [self rankedProviders];
     
     return [(Promise*)[promiseClass alloc] initWithSetup:^(Promise *promise) {
         if (providers.count == 0) {
@@ -153,27 +576,17 @@
             return;
         }
         
-        void (^nextProvider)(NSUInteger, void (^)()) = ^(NSUInteger index, void (^nextProvider)()) {
-            Provider *provider = [providers objectAtIndex:index];
-            [startCallback(provider) onCompletion:^(Promise *childPromise) {
-                if (childPromise.error) {
-                    if (childPromise.error.code != ProviderErrorNotImplemented) {
-                        NSLog(@"FallbackProvider: error=%@ provider=%@", childPromise.error, provider);
-                    }
-                    if (index + 1 < providers.count) {
-                        nextProvider(index + 1, nextProvider);
-                    } else {
-                        [promise reject:childPromise.error];
-                    }
-                    return;
-                }
-                
-                [promise resolve:childPromise.result];
-            }];
-        };
-        nextProvider(0, nextProvider);
+        FallbackOperation *operation = [[FallbackOperation alloc] initWithFallbackProvider:self
+                                                                                 providers:providers
+                                                                                  strategy:strategy
+                                                                             startCallback:startCallback
+                                                                                   promise:promise];
+        [operation start];
     }];
+}
 
+- (id)executeOperation: (Promise* (^)(Provider*))startCallback promiseClass: (Class)promiseClass {
+    return [self executeOperation:startCallback promiseClass:promiseClass strategy:self.strategy];
 }
 
 
@@ -232,7 +645,12 @@
     Promise* (^startCallback)(Provider*) = ^Promise*(Provider *provider) {
         return [provider sendTransaction:signedTransaction];
     };
-    return [self executeOperation:startCallback promiseClass:[HashPromise class]];
+    
+    // Only one node need accept a transaction, so there is nothing to agree on
+    FallbackProviderStrategy strategy = self.strategy;
+    if (strategy == FallbackProviderStrategyQuorum) { strategy = FallbackProviderStrategyRace; }
+    
+    return [self executeOperation:startCallback promiseClass:[HashPromise class] strategy:strategy];
 }
 
 - (BlockInfoPromise*)getBlockByBlockHash: (Hash*)blockHash {
@@ -263,6 +263,8 @@ static NSString *UserAgent = nil;
     Hash *nodehash = namehash(name);
 
     void (^promise)(Promise*) = ^(Promise *promise) {
+        if (promise.traceId) { promise.traceName = @"lookupNameResolver"; }
+        
         Transaction *getResolverTransaction = [Transaction transaction];
         {
             SecureData *data = [SecureData secureDataWithCapacity:36];
@@ -292,6 +294,8 @@ static NSString *UserAgent = nil;
     Hash *nodehash = namehash(name);
 
     void (^promise)(Promise*) = ^(Promise *promise) {
+        if (promise.traceId) { promise.traceName = @"lookupName"; }
+        
         [[self lookupNameResolver:name] onCompletion:^(AddressPromise *resolverPromise) {
             
             // There was a problem with the resolver
@@ -0,0 +1,175 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ *  ProviderMetrics
+ *
+ *  Counters, gauges and latency histograms for a provider, for capacity planning against
+ *  a backend's quota and for spotting slow backends. Calls are recorded by method (e.g.
+ *  eth_call): how many were sent, how long they took, how they failed, how many joined a
+ *  call already in flight and how many were answered from a cache. Transfers record the
+ *  bytes sent and received and the time spent on the wire.
+ *
+ *  A snapshot is a consistent, immutable copy, which can be exported in the Prometheus
+ *  text exposition format.
+ */
+
+#import <Foundation/Foundation.h>
+
+
+#pragma mark -
+#pragma mark - LatencyHistogram
+
+/**
+ *  A log-linear (HDR-style) histogram of durations from 1 microsecond to about 12 days;
+ *  each power of two is split into 32 buckets, so percentiles are within about 2%. It
+ *  uses a fixed 9kb, however many values are recorded. Not thread-safe.
+ */
+
+@interface LatencyHistogram : NSObject <NSCopying>
+
++ (instancetype)histogram;
+
+// Durations in seconds
+- (void)recordValue: (NSTimeInterval)value;
+
+- (void)addHistogram: (LatencyHistogram*)histogram;
+
+- (void)removeAllValues;
+
+@property (nonatomic, readonly) NSUInteger count;
+
+@property (nonatomic, readonly) NSTimeInterval sum;
+@property (nonatomic, readonly) NSTimeInterval minimum;
+@property (nonatomic, readonly) NSTimeInterval maximum;
+@property (nonatomic, readonly) NSTimeInterval mean;
+
+// e.g. 99.0 for the 99th percentile (0 if there are no values)
+- (NSTimeInterval)valueAtPercentile: (double)percentile;
+
+@end
+
+
+#pragma mark -
+#pragma mark - ProviderMethodMetrics
+
+@interface ProviderMethodMetrics : NSObject <NSCopying>
+
+@property (nonatomic, readonly) NSString *method;
+
+// Calls sent (calls which joined one in flight, or came from a cache, are not)
+@property (nonatomic, readonly) NSUInteger requestCount;
+
+// Failed calls (including cancelled calls), and by error (a ProviderError; calls which failed
+// with an error from another domain are counted as ProviderErrorUnknownError)
+@property (nonatomic, readonly) NSUInteger errorCount;
+@property (nonatomic, readonly) NSUInteger cancelledCount;
+@property (nonatomic, readonly) NSDictionary<NSNumber*, NSNumber*> *errorCounts;
+
+// Calls which joined an identical call already in flight (see ApiProvider single-flight)
+@property (nonatomic, readonly) NSUInteger sharedCount;
+
+@property (nonatomic, readonly) NSUInteger cacheHitCount;
+@property (nonatomic, readonly) NSUInteger cacheMissCount;
+
+// The fraction of cache lookups which were hits (0 if there have been none)
+@property (nonatomic, readonly) double cacheHitRate;
+
+@property (nonatomic, readonly) NSUInteger inFlightCount;
+
+// From sending a call until its result, including time spent queued
+@property (nonatomic, readonly) LatencyHistogram *latency;
+
+@end
+
+
+#pragma mark -
+#pragma mark - ProviderMetricsSnapshot
+
+@interface ProviderMetricsSnapshot : NSObject
+
+@property (nonatomic, readonly) NSString *name;
+@property (nonatomic, readonly) NSDate *date;
+
+@property (nonatomic, readonly) NSDictionary<NSString*, ProviderMethodMetrics*> *methods;
+
+// Every method combined
+@property (nonatomic, readonly) ProviderMethodMetrics *total;
+
+@property (nonatomic, readonly) NSUInteger transferCount;
+@property (nonatomic, readonly) unsigned long long bytesSent;
+@property (nonatomic, readonly) unsigned long long bytesReceived;
+
+// From starting a transfer (e.g. an HTTP request) until its response
+@property (nonatomic, readonly) LatencyHistogram *transferLatency;
+
+@property (nonatomic, readonly) NSDictionary<NSString*, NSNumber*> *gauges;
+
+- (NSString*)prometheusText;
+
+@end
+
+
+#pragma mark -
+#pragma mark - ProviderMetrics
+
+@interface ProviderMetrics : NSObject
+
+- (instancetype)initWithName: (NSString*)name;
+
+// The provider label of exported metrics (e.g. "InfuraProvider")
+@property (atomic, copy) NSString *name;
+
+- (ProviderMetricsSnapshot*)snapshot;
+
+- (void)reset;
+
+
+#pragma mark - Recording (thread-safe)
+
+- (void)requestDidStartForMethod: (NSString*)method;
+
+// error is nil if the call succeeded
+- (void)requestDidFinishForMethod: (NSString*)method duration: (NSTimeInterval)duration error: (NSError*)error;
+
+- (void)recordSharedRequestForMethod: (NSString*)method;
+
+- (void)recordCacheHit: (BOOL)hit forMethod: (NSString*)method;
+
+- (void)recordTransferWithDuration: (NSTimeInterval)duration;
+
+- (void)recordBytesSent: (NSUInteger)length;
+- (void)recordBytesReceived: (NSUInteger)length;
+
+// Adds a gauge (e.g. queued requests), read whenever a snapshot is taken
+- (void)setGaugeWithName: (NSString*)name value: (double (^)(void))value;
+
+
+#pragma mark - Exporting
+
+// The Prometheus text exposition format, labelled with each snapshot's name
++ (NSString*)prometheusTextForSnapshots: (NSArray<ProviderMetricsSnapshot*>*)snapshots;
+
+@end
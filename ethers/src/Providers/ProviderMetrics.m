@@ -0,0 +1,602 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import "ProviderMetrics.h"
+
+#import "Promise.h"
+#import "Provider.h"
+
+
+#pragma mark -
+#pragma mark - LatencyHistogram
+
+// Values are recorded in microseconds; below 2 * SubBucketCount each value has its own bucket,
+// above that each power of two is split into SubBucketCount buckets
+#define SubBucketBits                 5
+#define SubBucketCount                (1 << SubBucketBits)
+#define MaximumExponent               40
+#define BucketCount                   (2 * SubBucketCount + (MaximumExponent - SubBucketBits - 1) * SubBucketCount)
+
+static NSUInteger bucketIndex(uint64_t value) {
+    if (value < 2 * SubBucketCount) { return (NSUInteger)value; }
+    if (value >= (1ULL << MaximumExponent)) { value = (1ULL << MaximumExponent) - 1; }
+    
+    int shift = (63 - __builtin_clzll(value)) - SubBucketBits;
+    return 2 * SubBucketCount + (shift - 1) * SubBucketCount + (NSUInteger)((value >> shift) - SubBucketCount);
+}
+
+// The middle of the range of values a bucket holds
+static double bucketMidpoint(NSUInteger index) {
+    if (index < 2 * SubBucketCount) { return index; }
+    
+    NSUInteger offset = index - 2 * SubBucketCount;
+    int shift = (int)(offset / SubBucketCount) + 1;
+    uint64_t lowest = ((uint64_t)(offset % SubBucketCount + SubBucketCount)) << shift;
+    return lowest + ((double)((1ULL << shift) - 1)) / 2.0;
+}
+
+
+@implementation LatencyHistogram {
+    uint64_t *_counts;
+}
+
++ (instancetype)histogram {
+    return [[LatencyHistogram alloc] init];
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _counts = calloc(BucketCount, sizeof(uint64_t));
+    }
+    return self;
+}
+
+- (void)dealloc {
+    free(_counts);
+}
+
+- (instancetype)copyWithZone: (NSZone*)zone {
+    LatencyHistogram *histogram = [[LatencyHistogram allocWithZone:zone] init];
+    [histogram addHistogram:self];
+    return histogram;
+}
+
+- (void)recordValue: (NSTimeInterval)value {
+    if (value < 0) { value = 0; }
+    
+    _counts[bucketIndex((uint64_t)llround(value * 1000000.0))]++;
+    
+    if (_count == 0 || value < _minimum) { _minimum = value; }
+    if (_count == 0 || value > _maximum) { _maximum = value; }
+    _count++;
+    _sum += value;
+}
+
+- (void)addHistogram: (LatencyHistogram*)histogram {
+    if (histogram.count == 0) { return; }
+    
+    for (NSUInteger i = 0; i < BucketCount; i++) { _counts[i] += histogram->_counts[i]; }
+    
+    if (_count == 0 || histogram.minimum < _minimum) { _minimum = histogram.minimum; }
+    if (_count == 0 || histogram.maximum > _maximum) { _maximum = histogram.maximum; }
+    _count += histogram.count;
+    _sum += histogram.sum;
+}
+
+- (void)removeAllValues {
+    memset(_counts, 0, BucketCount * sizeof(uint64_t));
+    _count = 0;
+    _sum = 0;
+    _minimum = 0;
+    _maximum = 0;
+}
+
+- (NSTimeInterval)mean {
+    if (_count == 0) { return 0; }
+    return _sum / _count;
+}
+
+- (NSTimeInterval)valueAtPercentile: (double)percentile {
+    if (_count == 0) { return 0; }
+    
+    percentile = MAX(0.0, MIN(100.0, percentile));
+    uint64_t target = MAX(1, (uint64_t)ceil(percentile / 100.0 * _count));
+    
+    uint64_t seen = 0;
+    for (NSUInteger i = 0; i < BucketCount; i++) {
+        seen += _counts[i];
+        if (seen >= target) {
+            
+            // The bucket's midpoint may lie beyond the values actually recorded
+            return MAX(_minimum, MIN(_maximum, bucketMidpoint(i) / 1000000.0));
+        }
+    }
+    
+    return _maximum;
+}
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<LatencyHistogram count=%d p50=%.1fms p95=%.1fms p99=%.1fms max=%.1fms>",
+            (int)_count, [self valueAtPercentile:50] * 1000.0, [self valueAtPercentile:95] * 1000.0,
+            [self valueAtPercentile:99] * 1000.0, _maximum * 1000.0];
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - ProviderMethodMetrics
+
+@interface ProviderMethodMetrics ()
+
+@property (nonatomic, copy) NSString *method;
+
+@property (nonatomic, assign) NSUInteger requestCount;
+@property (nonatomic, assign) NSUInteger errorCount;
+@property (nonatomic, assign) NSUInteger cancelledCount;
+@property (nonatomic, assign) NSUInteger sharedCount;
+@property (nonatomic, assign) NSUInteger cacheHitCount;
+@property (nonatomic, assign) NSUInteger cacheMissCount;
+@property (nonatomic, assign) NSUInteger inFlightCount;
+@property (nonatomic, strong) LatencyHistogram *latency;
+
+- (instancetype)initWithMethod: (NSString*)method;
+
+- (void)addMetrics: (ProviderMethodMetrics*)metrics;
+- (void)addErrorWithCode: (ProviderError)code count: (NSUInteger)count;
+
+@end
+
+@implementation ProviderMethodMetrics {
+    NSMutableDictionary<NSNumber*, NSNumber*> *_errorCounts;
+}
+
+- (instancetype)initWithMethod: (NSString*)method {
+    self = [super init];
+    if (self) {
+        _method = [method copy];
+        _errorCounts = [NSMutableDictionary dictionary];
+        _latency = [LatencyHistogram histogram];
+    }
+    return self;
+}
+
+- (instancetype)copyWithZone: (NSZone*)zone {
+    ProviderMethodMetrics *metrics = [[ProviderMethodMetrics allocWithZone:zone] initWithMethod:_method];
+    [metrics addMetrics:self];
+    return metrics;
+}
+
+- (void)addMetrics: (ProviderMethodMetrics*)metrics {
+    _requestCount += metrics.requestCount;
+    _errorCount += metrics.errorCount;
+    _cancelledCount += metrics.cancelledCount;
+    _sharedCount += metrics.sharedCount;
+    _cacheHitCount += metrics.cacheHitCount;
+    _cacheMissCount += metrics.cacheMissCount;
+    _inFlightCount += metrics.inFlightCount;
+    
+    [metrics.errorCounts enumerateKeysAndObjectsUsingBlock:^(NSNumber *code, NSNumber *count, BOOL *stop) {
+        [self addErrorWithCode:(ProviderError)code.integerValue count:count.unsignedIntegerValue];
+    }];
+    
+    [_latency addHistogram:metrics.latency];
+}
+
+- (void)addErrorWithCode: (ProviderError)code count: (NSUInteger)count {
+    NSNumber *key = @(code);
+    [_errorCounts setObject:@([[_errorCounts objectForKey:key] unsignedIntegerValue] + count) forKey:key];
+}
+
+- (NSDictionary<NSNumber*, NSNumber*>*)errorCounts {
+    return _errorCounts;
+}
+
+- (double)cacheHitRate {
+    NSUInteger lookupCount = _cacheHitCount + _cacheMissCount;
+    if (lookupCount == 0) { return 0; }
+    return ((double)_cacheHitCount) / lookupCount;
+}
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<ProviderMethodMetrics method=%@ requests=%d errors=%d shared=%d cacheHitRate=%.2f inFlight=%d latency=%@>",
+            _method, (int)_requestCount, (int)_errorCount, (int)_sharedCount, self.cacheHitRate, (int)_inFlightCount, _latency];
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - ProviderMetricsSnapshot
+
+@interface ProviderMetricsSnapshot ()
+
+@property (nonatomic, copy) NSString *name;
+@property (nonatomic, strong) NSDate *date;
+@property (nonatomic, copy) NSDictionary<NSString*, ProviderMethodMetrics*> *methods;
+@property (nonatomic, strong) ProviderMethodMetrics *total;
+@property (nonatomic, assign) NSUInteger transferCount;
+@property (nonatomic, assign) unsigned long long bytesSent;
+@property (nonatomic, assign) unsigned long long bytesReceived;
+@property (nonatomic, strong) LatencyHistogram *transferLatency;
+@property (nonatomic, copy) NSDictionary<NSString*, NSNumber*> *gauges;
+
+@end
+
+@implementation ProviderMetricsSnapshot
+
+- (NSString*)prometheusText {
+    return [ProviderMetrics prometheusTextForSnapshots:@[ self ]];
+}
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<ProviderMetricsSnapshot name=%@ total=%@ transfers=%d sent=%llu received=%llu gauges=%@>",
+            _name, _total, (int)_transferCount, _bytesSent, _bytesReceived, _gauges];
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - Prometheus
+
+static NSString *escapeLabel(NSString *value) {
+    value = [value stringByReplacingOccurrencesOfString:@"\\" withString:@"\\\\"];
+    value = [value stringByReplacingOccurrencesOfString:@"\"" withString:@"\\\""];
+    return [value stringByReplacingOccurrencesOfString:@"\n" withString:@"\\n"];
+}
+
+static NSString *errorName(ProviderError code) {
+    switch (code) {
+        case ProviderErrorNotImplemented:        return @"not_implemented";
+        case ProviderErrorUnknownError:          return @"unknown";
+        case ProviderErrorInvalidParameters:     return @"invalid_parameters";
+        case ProviderErrorUnsupportedNetwork:    return @"unsupported_network";
+        case ProviderErrorBadRequest:            return @"bad_request";
+        case ProviderErrorBadResponse:           return @"bad_response";
+        case ProviderErrorNotAuthorized:         return @"not_authorized";
+        case ProviderErrorThrottled:             return @"throttled";
+        case ProviderErrorTimeout:               return @"timeout";
+        case ProviderErrorConnectionFailed:      return @"connection_failed";
+        case ProviderErrorNotFound:              return @"not_found";
+        case ProviderErrorServerUnknownError:    return @"server_unknown_error";
+    }
+    return [NSString stringWithFormat:@"error_%d", (int)code];
+}
+
+// Appends the family's HELP and TYPE, then its samples (nothing, if there are no samples)
+static void appendFamily(NSMutableString *text, NSString *name, NSString *type, NSString *help, NSArray<NSString*> *samples) {
+    if (samples.count == 0) { return; }
+    
+    [text appendFormat:@"# HELP %@ %@\n", name, help];
+    [text appendFormat:@"# TYPE %@ %@\n", name, type];
+    for (NSString *sample in samples) { [text appendString:sample]; }
+}
+
+static NSArray<NSString*> *methodSamples(NSArray<ProviderMetricsSnapshot*> *snapshots, NSString *name,
+                                         NSNumber* (^value)(ProviderMethodMetrics*)) {
+    NSMutableArray<NSString*> *samples = [NSMutableArray array];
+    for (ProviderMetricsSnapshot *snapshot in snapshots) {
+        NSString *provider = escapeLabel(snapshot.name);
+        for (NSString *method in [snapshot.methods.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+            NSNumber *sample = value([snapshot.methods objectForKey:method]);
+            if (!sample) { continue; }
+            [samples addObject:[NSString stringWithFormat:@"%@{provider=\"%@\",method=\"%@\"} %@\n",
+                                name, provider, escapeLabel(method), sample]];
+        }
+    }
+    return samples;
+}
+
+static void appendSummary(NSMutableArray<NSString*> *samples, NSString *name, NSString *labels, LatencyHistogram *histogram) {
+    for (NSNumber *quantile in @[ @(0.5), @(0.95), @(0.99) ]) {
+        [samples addObject:[NSString stringWithFormat:@"%@{%@,quantile=\"%@\"} %.9g\n", name, labels, quantile,
+                            [histogram valueAtPercentile:(quantile.doubleValue * 100.0)]]];
+    }
+    [samples addObject:[NSString stringWithFormat:@"%@_sum{%@} %.9g\n", name, labels, histogram.sum]];
+    [samples addObject:[NSString stringWithFormat:@"%@_count{%@} %lu\n", name, labels, (unsigned long)histogram.count]];
+}
+
+
+#pragma mark -
+#pragma mark - ProviderMetrics
+
+@implementation ProviderMetrics {
+    
+    // Guarded by @synchronized (self)
+    NSMutableDictionary<NSString*, ProviderMethodMetrics*> *_methods;
+    NSUInteger _transferCount;
+    unsigned long long _bytesSent, _bytesReceived;
+    LatencyHistogram *_transferLatency;
+    NSMutableDictionary<NSString*, double (^)(void)> *_gauges;
+}
+
+- (instancetype)initWithName: (NSString*)name {
+    self = [super init];
+    if (self) {
+        _name = [name copy];
+        _methods = [NSMutableDictionary dictionary];
+        _transferLatency = [LatencyHistogram histogram];
+        _gauges = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+// Must be called inside @synchronized (self)
+- (ProviderMethodMetrics*)_metricsForMethod: (NSString*)method {
+    ProviderMethodMetrics *metrics = [_methods objectForKey:method];
+    if (!metrics) {
+        metrics = [[ProviderMethodMetrics alloc] initWithMethod:method];
+        [_methods setObject:metrics forKey:method];
+    }
+    return metrics;
+}
+
+- (ProviderMetricsSnapshot*)snapshot {
+    ProviderMetricsSnapshot *snapshot = [[ProviderMetricsSnapshot alloc] init];
+    snapshot.name = self.name;
+    snapshot.date = [NSDate date];
+    
+    ProviderMethodMetrics *total = [[ProviderMethodMetrics alloc] initWithMethod:nil];
+    NSMutableDictionary<NSString*, ProviderMethodMetrics*> *methods = [NSMutableDictionary dictionary];
+    NSDictionary<NSString*, double (^)(void)> *gauges = nil;
+    
+    @synchronized (self) {
+        for (ProviderMethodMetrics *metrics in [_methods allValues]) {
+            [methods setObject:[metrics copy] forKey:metrics.method];
+            [total addMetrics:metrics];
+        }
+        
+        snapshot.transferCount = _transferCount;
+        snapshot.bytesSent = _bytesSent;
+        snapshot.bytesReceived = _bytesReceived;
+        snapshot.transferLatency = [_transferLatency copy];
+        gauges = [_gauges copy];
+    }
+    
+    snapshot.methods = methods;
+    snapshot.total = total;
+    
+    // Read outside the lock, as gauges may take locks of their own
+    NSMutableDictionary<NSString*, NSNumber*> *gaugeValues = [NSMutableDictionary dictionaryWithCapacity:gauges.count];
+    [gauges enumerateKeysAndObjectsUsingBlock:^(NSString *name, double (^value)(void), BOOL *stop) {
+        [gaugeValues setObject:@(value()) forKey:name];
+    }];
+    snapshot.gauges = gaugeValues;
+    
+    return snapshot;
+}
+
+- (void)reset {
+    @synchronized (self) {
+        
+        // Calls in flight are still in flight
+        NSMutableDictionary<NSString*, ProviderMethodMetrics*> *methods = [NSMutableDictionary dictionary];
+        for (ProviderMethodMetrics *metrics in [_methods allValues]) {
+            if (metrics.inFlightCount == 0) { continue; }
+            ProviderMethodMetrics *inFlight = [[ProviderMethodMetrics alloc] initWithMethod:metrics.method];
+            inFlight.inFlightCount = metrics.inFlightCount;
+            [methods setObject:inFlight forKey:metrics.method];
+        }
+        _methods = methods;
+        
+        _transferCount = 0;
+        _bytesSent = 0;
+        _bytesReceived = 0;
+        [_transferLatency removeAllValues];
+    }
+}
+
+
+#pragma mark - Recording
+
+- (void)requestDidStartForMethod: (NSString*)method {
+    @synchronized (self) {
+        ProviderMethodMetrics *metrics = [self _metricsForMethod:method];
+        metrics.requestCount++;
+        metrics.inFlightCount++;
+    }
+}
+
+- (void)requestDidFinishForMethod: (NSString*)method duration: (NSTimeInterval)duration error: (NSError*)error {
+    BOOL cancelled = NO;
+    ProviderError code = ProviderErrorUnknownError;
+    if ([error.domain isEqualToString:ProviderErrorDomain]) {
+        code = (ProviderError)error.code;
+    } else if ([error.domain isEqualToString:PromiseErrorDomain]) {
+        if (error.code == PromiseErrorCancelled) {
+            cancelled = YES;
+        } else if (error.code == PromiseErrorTimeout) {
+            code = ProviderErrorTimeout;
+        }
+    }
+    
+    @synchronized (self) {
+        ProviderMethodMetrics *metrics = [self _metricsForMethod:method];
+        if (metrics.inFlightCount) { metrics.inFlightCount--; }
+        [metrics.latency recordValue:duration];
+        
+        if (error) {
+            metrics.errorCount++;
+            if (cancelled) {
+                metrics.cancelledCount++;
+            } else {
+                [metrics addErrorWithCode:code count:1];
+            }
+        }
+    }
+}
+
+- (void)recordSharedRequestForMethod: (NSString*)method {
+    @synchronized (self) {
+        [self _metricsForMethod:method].sharedCount++;
+    }
+}
+
+- (void)recordCacheHit: (BOOL)hit forMethod: (NSString*)method {
+    @synchronized (self) {
+        ProviderMethodMetrics *metrics = [self _metricsForMethod:method];
+        if (hit) {
+            metrics.cacheHitCount++;
+        } else {
+            metrics.cacheMissCount++;
+        }
+    }
+}
+
+- (void)recordTransferWithDuration: (NSTimeInterval)duration {
+    @synchronized (self) {
+        _transferCount++;
+        [_transferLatency recordValue:duration];
+    }
+}
+
+- (void)recordBytesSent: (NSUInteger)length {
+    @synchronized (self) {
+        _bytesSent += length;
+    }
+}
+
+- (void)recordBytesReceived: (NSUInteger)length {
+    @synchronized (self) {
+        _bytesReceived += length;
+    }
+}
+
+- (void)setGaugeWithName: (NSString*)name value: (double (^)(void))value {
+    @synchronized (self) {
+        if (value) {
+            [_gauges setObject:[value copy] forKey:name];
+        } else {
+            [_gauges removeObjectForKey:name];
+        }
+    }
+}
+
+
+#pragma mark - Exporting
+
++ (NSString*)prometheusTextForSnapshots: (NSArray<ProviderMetricsSnapshot*>*)snapshots {
+    NSMutableString *text = [NSMutableString string];
+    
+    appendFamily(text, @"ethers_provider_requests_total", @"counter", @"Calls sent, by method.",
+                 methodSamples(snapshots, @"ethers_provider_requests_total", ^NSNumber*(ProviderMethodMetrics *metrics) {
+                     return @(metrics.requestCount);
+                 }));
+    
+    NSMutableArray<NSString*> *errorSamples = [NSMutableArray array];
+    for (ProviderMetricsSnapshot *snapshot in snapshots) {
+        NSString *provider = escapeLabel(snapshot.name);
+        for (NSString *method in [snapshot.methods.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+            ProviderMethodMetrics *metrics = [snapshot.methods objectForKey:method];
+            NSString *labels = [NSString stringWithFormat:@"provider=\"%@\",method=\"%@\"", provider, escapeLabel(method)];
+            
+            for (NSNumber *code in [metrics.errorCounts.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+                [errorSamples addObject:[NSString stringWithFormat:@"ethers_provider_errors_total{%@,error=\"%@\"} %@\n",
+                                         labels, errorName((ProviderError)code.integerValue), [metrics.errorCounts objectForKey:code]]];
+            }
+            if (metrics.cancelledCount) {
+                [errorSamples addObject:[NSString stringWithFormat:@"ethers_provider_errors_total{%@,error=\"cancelled\"} %lu\n",
+                                         labels, (unsigned long)metrics.cancelledCount]];
+            }
+        }
+    }
+    appendFamily(text, @"ethers_provider_errors_total", @"counter", @"Failed calls, by method and error.", errorSamples);
+    
+    appendFamily(text, @"ethers_provider_shared_requests_total", @"counter", @"Calls which joined an identical call in flight.",
+                 methodSamples(snapshots, @"ethers_provider_shared_requests_total", ^NSNumber*(ProviderMethodMetrics *metrics) {
+                     return @(metrics.sharedCount);
+                 }));
+    
+    appendFamily(text, @"ethers_provider_cache_hits_total", @"counter", @"Calls answered from a cache.",
+                 methodSamples(snapshots, @"ethers_provider_cache_hits_total", ^NSNumber*(ProviderMethodMetrics *metrics) {
+                     if (metrics.cacheHitCount + metrics.cacheMissCount == 0) { return nil; }
+                     return @(metrics.cacheHitCount);
+                 }));
+    
+    appendFamily(text, @"ethers_provider_cache_misses_total", @"counter", @"Calls a cache could not answer.",
+                 methodSamples(snapshots, @"ethers_provider_cache_misses_total", ^NSNumber*(ProviderMethodMetrics *metrics) {
+                     if (metrics.cacheHitCount + metrics.cacheMissCount == 0) { return nil; }
+                     return @(metrics.cacheMissCount);
+                 }));
+    
+    appendFamily(text, @"ethers_provider_in_flight_requests", @"gauge", @"Calls sent which have not completed.",
+                 methodSamples(snapshots, @"ethers_provider_in_flight_requests", ^NSNumber*(ProviderMethodMetrics *metrics) {
+                     return @(metrics.inFlightCount);
+                 }));
+    
+    NSMutableArray<NSString*> *durationSamples = [NSMutableArray array];
+    NSMutableArray<NSString*> *transferSamples = [NSMutableArray array];
+    NSMutableArray<NSString*> *transferDurationSamples = [NSMutableArray array];
+    NSMutableArray<NSString*> *sentSamples = [NSMutableArray array];
+    NSMutableArray<NSString*> *receivedSamples = [NSMutableArray array];
+    NSMutableDictionary<NSString*, NSMutableArray<NSString*>*> *gaugeSamples = [NSMutableDictionary dictionary];
+    
+    for (ProviderMetricsSnapshot *snapshot in snapshots) {
+        NSString *provider = escapeLabel(snapshot.name);
+        NSString *labels = [NSString stringWithFormat:@"provider=\"%@\"", provider];
+        
+        for (NSString *method in [snapshot.methods.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+            ProviderMethodMetrics *metrics = [snapshot.methods objectForKey:method];
+            if (metrics.latency.count == 0) { continue; }
+            appendSummary(durationSamples, @"ethers_provider_request_duration_seconds",
+                          [NSString stringWithFormat:@"%@,method=\"%@\"", labels, escapeLabel(method)], metrics.latency);
+        }
+        
+        [transferSamples addObject:[NSString stringWithFormat:@"ethers_provider_transfers_total{%@} %lu\n",
+                                    labels, (unsigned long)snapshot.transferCount]];
+        if (snapshot.transferLatency.count) {
+            appendSummary(transferDurationSamples, @"ethers_provider_transfer_duration_seconds", labels, snapshot.transferLatency);
+        }
+        [sentSamples addObject:[NSString stringWithFormat:@"ethers_provider_sent_bytes_total{%@} %llu\n", labels, snapshot.bytesSent]];
+        [receivedSamples addObject:[NSString stringWithFormat:@"ethers_provider_received_bytes_total{%@} %llu\n", labels, snapshot.bytesReceived]];
+        
+        [snapshot.gauges enumerateKeysAndObjectsUsingBlock:^(NSString *name, NSNumber *value, BOOL *stop) {
+            NSMutableArray<NSString*> *samples = [gaugeSamples objectForKey:name];
+            if (!samples) {
+                samples = [NSMutableArray array];
+                [gaugeSamples setObject:samples forKey:name];
+            }
+            [samples addObject:[NSString stringWithFormat:@"ethers_provider_%@{%@} %.9g\n", name, labels, value.doubleValue]];
+        }];
+    }
+    
+    appendFamily(text, @"ethers_provider_request_duration_seconds", @"summary", @"Time from sending a call until its result.", durationSamples);
+    appendFamily(text, @"ethers_provider_transfers_total", @"counter", @"Requests made to the backend (a batch is one request).", transferSamples);
+    appendFamily(text, @"ethers_provider_transfer_duration_seconds", @"summary", @"Time from starting a request to the backend until its response.", transferDurationSamples);
+    appendFamily(text, @"ethers_provider_sent_bytes_total", @"counter", @"Bytes sent to the backend.", sentSamples);
+    appendFamily(text, @"ethers_provider_received_bytes_total", @"counter", @"Bytes received from the backend.", receivedSamples);
+    
+    for (NSString *name in [gaugeSamples.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+        NSString *family = [@"ethers_provider_" stringByAppendingString:name];
+        appendFamily(text, family, @"gauge", [NSString stringWithFormat:@"The provider's %@.", [name stringByReplacingOccurrencesOfString:@"_" withString:@" "]],
+                     [gaugeSamples objectForKey:name]);
+    }
+    
+    return text;
+}
+
+@end
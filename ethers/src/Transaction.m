@@ -75,7 +75,16 @@ static NSData *NullData = nil;
 #pragma mark -
 #pragma mark - Transaction
 
-@implementation Transaction
+@implementation Transaction {
+    BigNumber *_gasPrice, *_gasLimit, *_value;
+    NSData *_data;
+
+    // Cached encodings; cleared whenever a field they depend on changes
+    NSData *_unsignedSerialized;
+    NSData *_unsignedDigest;
+    NSData *_serialized;
+    Hash *_transactionHash;
+}
 
 #pragma mark - Life-Cycle
 
@@ -223,30 +232,75 @@ static NSData *NullData = nil;
 }
 
 
+#pragma mark - Setters (invalidate cached encodings)
+
+- (void)_invalidateUnsigned {
+    _unsignedSerialized = nil;
+    _unsignedDigest = nil;
+    [self _invalidateSigned];
+}
+
+- (void)_invalidateSigned {
+    _serialized = nil;
+    _transactionHash = nil;
+}
+
+- (void)setNonce:(NSUInteger)nonce {
+    if (nonce == _nonce) { return; }
+    _nonce = nonce;
+    [self _invalidateUnsigned];
+}
+
+- (void)setGasPrice:(BigNumber *)gasPrice {
+    _gasPrice = gasPrice;
+    [self _invalidateUnsigned];
+}
+
+- (void)setGasLimit:(BigNumber *)gasLimit {
+    _gasLimit = gasLimit;
+    [self _invalidateUnsigned];
+}
+
+- (void)setToAddress:(Address *)toAddress {
+    _toAddress = toAddress;
+    [self _invalidateUnsigned];
+}
+
+- (void)setValue:(BigNumber *)value {
+    _value = value;
+    [self _invalidateUnsigned];
+}
+
+- (void)setData:(NSData *)data {
+    _data = [data copy];
+    [self _invalidateUnsigned];
+}
+
+- (void)setChainId:(ChainId)chainId {
+    if (chainId == _chainId) { return; }
+    _chainId = chainId;
+    [self _invalidateUnsigned];
+}
+
+
 #pragma mark - Signature
 
 - (void)_setSignature: (Signature*)signature {
     _signature = signature;
+    [self _invalidateSigned];
 }
 
 - (void)sign:(Account *)account {
     if (account) {
-        NSMutableArray *raw = [self _packBasic];
-        if (_chainId) {
-            [raw addObject:dataWithByte(_chainId)];
-            [raw addObject:NullData];
-            [raw addObject:NullData];
-        }
-        
-        NSError *error = nil;
-        NSData *digest = [SecureData KECCAK256:[RLPSerialization dataWithObject:raw error:&error]];
         _fromAddress = account.address;
-        _signature = [account signDigest:digest];
+        _signature = [account signDigest:[self _unsignedDigest]];
         
     } else {
         _fromAddress = nil;
         _signature = nil;
     }
+    
+    [self _invalidateSigned];
 }
 
 - (void)verifySignatureData: (NSData*)signatureData v: (unsigned char)v {
@@ -256,16 +310,11 @@ static NSData *NullData = nil;
     int chainId = (v - 35) / 2;
     if (chainId < 0) { chainId = 0; }
 
+    // The chain ID is part of the digest, so this also resets any cached encoding
     _chainId = chainId;
+    [self _invalidateUnsigned];
     
-    NSMutableArray *raw = [self _packBasic];
-    if (_chainId) {
-        [raw addObject:dataWithByte(_chainId)];
-        [raw addObject:NullData];
-        [raw addObject:NullData];
-    }
-    
-    NSData *digest = [SecureData KECCAK256:[RLPSerialization dataWithObject:raw error:nil]];
+    NSData *digest = [self _unsignedDigest];
     
     SecureData *publicKey = [SecureData secureDataWithLength:65];
     
@@ -293,7 +342,7 @@ static NSData *NullData = nil;
     }
     
     if (self.gasPrice) {
-        NSData *gasPriceData = stripDataZeros([SecureData hexStringToData:[self.gasPrice hexString]]);
+        NSData *gasPriceData = stripDataZeros(self.gasPrice.data);
         if (gasPriceData.length > 32) { return nil; }
         [result addObject:gasPriceData];
     } else {
@@ -301,7 +350,7 @@ static NSData *NullData = nil;
     }
     
     if (self.gasLimit) {
-        NSData *gasLimitData = stripDataZeros([SecureData hexStringToData:[self.gasLimit hexString]]);
+        NSData *gasLimitData = stripDataZeros(self.gasLimit.data);
         if (gasLimitData.length > 32) { return nil; }
         [result addObject:gasLimitData];
     } else {
@@ -315,7 +364,7 @@ static NSData *NullData = nil;
     }
     
     if (self.value) {
-        NSData *valueData = stripDataZeros([SecureData hexStringToData:[self.value hexString]]);
+        NSData *valueData = stripDataZeros(self.value.data);
         if (valueData.length > 32) { return nil; }
         [result addObject:valueData];
     } else {
@@ -332,6 +381,8 @@ static NSData *NullData = nil;
 }
 
 - (NSData*)serialize {
+    if (_serialized) { return _serialized; }
+    
     NSMutableArray *raw = [self _packBasic];
 
     if (_signature) {
@@ -347,10 +398,13 @@ static NSData *NullData = nil;
         [raw addObject:NullData];
     }
     
-    return [RLPSerialization dataWithObject:raw error:nil];
+    _serialized = [[RLPSerialization dataWithObject:raw error:nil] copy];
+    return _serialized;
 }
 
 - (NSData*)unsignedSerialize {
+    if (_unsignedSerialized) { return _unsignedSerialized; }
+    
     NSMutableArray *raw = [self _packBasic];
 
     if (_chainId) {
@@ -359,7 +413,16 @@ static NSData *NullData = nil;
         [raw addObject:NullData];
     }
     
-    return [RLPSerialization dataWithObject:raw error:nil];
+    _unsignedSerialized = [[RLPSerialization dataWithObject:raw error:nil] copy];
+    return _unsignedSerialized;
+}
+
+// The digest signed by (and recovered from) the signature
+- (NSData*)_unsignedDigest {
+    if (!_unsignedDigest) {
+        _unsignedDigest = [SecureData KECCAK256:[self unsignedSerialize]];
+    }
+    return _unsignedDigest;
 }
 
 - (BOOL)populateSignatureWithR: (nonnull NSData*)r s: (nonnull NSData*)s address:(nonnull Address *)address {
@@ -368,7 +431,7 @@ static NSData *NullData = nil;
     NSMutableData *sig = [r mutableCopy];
     [sig appendData:s];
     
-    NSData *digest = [SecureData KECCAK256:[self unsignedSerialize]];
+    NSData *digest = [self _unsignedDigest];
 
     for (uint8_t recid = 0; recid <= 3; recid++) {
         int failed = ecdsa_verify_digest_recover(&secp256k1, publicKey.mutableBytes, sig.bytes, digest.bytes, recid);
@@ -377,6 +440,7 @@ static NSData *NullData = nil;
             if ([fromAddress isEqualToAddress:address]) {
                 _signature = [Signature signatureWithData:[NSData dataWithData:sig] v:recid];
                 _fromAddress = fromAddress;
+                [self _invalidateSigned];
                 return YES;
             }
         }
@@ -387,7 +451,14 @@ static NSData *NullData = nil;
 
 - (Hash*)transactionHash {
     if (!_signature) { return nil; }
-    return [Hash hashWithData:[SecureData KECCAK256:[self serialize]]];
+    if (!_transactionHash) {
+        NSData *serialized = [self serialize];
+        
+        eth_hash32 hash32;
+        eth_keccak256(serialized.bytes, serialized.length, &hash32);
+        _transactionHash = [Hash hashWithHash32:&hash32];
+    }
+    return _transactionHash;
 }
 
 #pragma mark - NSCopying
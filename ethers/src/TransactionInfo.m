@@ -34,10 +34,49 @@
 
 static NSData *NullData = nil;
 
+// Parsed once, rather than for every transaction
+static QueryPath *HashPath = nil;
+static QueryPath *BlockHashPath = nil;
+static QueryPath *BlockNumberPath = nil;
+static QueryPath *TimestampPath = nil;
+static QueryPath *EtherscanTimestampPath = nil;
+static QueryPath *ContractAddressPath = nil;
+static QueryPath *CreatesPath = nil;
+static QueryPath *FromPath = nil;
+static QueryPath *ToPath = nil;
+static QueryPath *GasLimitPath = nil;
+static QueryPath *GasPath = nil;
+static QueryPath *GasPricePath = nil;
+static QueryPath *GasUsedPath = nil;
+static QueryPath *CumulativeGasUsedPath = nil;
+static QueryPath *NoncePath = nil;
+static QueryPath *DataPath = nil;
+static QueryPath *InputPath = nil;
+static QueryPath *ValuePath = nil;
+
 + (void)initialize {
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
         NullData = [NSData data];
+
+        HashPath = [QueryPath queryPathWithString:@"dictionary:hash/hash"];
+        BlockHashPath = [QueryPath queryPathWithString:@"dictionary:blockHash/hash"];
+        BlockNumberPath = [QueryPath queryPathWithString:@"dictionary:blockNumber/integer"];
+        TimestampPath = [QueryPath queryPathWithString:@"dictionary:timestamp/integer"];
+        EtherscanTimestampPath = [QueryPath queryPathWithString:@"dictionary:timeStamp/integer"];
+        ContractAddressPath = [QueryPath queryPathWithString:@"dictionary:contractAddress/string"];
+        CreatesPath = [QueryPath queryPathWithString:@"dictionary:creates/string"];
+        FromPath = [QueryPath queryPathWithString:@"dictionary:from/string"];
+        ToPath = [QueryPath queryPathWithString:@"dictionary:to/string"];
+        GasLimitPath = [QueryPath queryPathWithString:@"dictionary:gasLimit/bigNumber"];
+        GasPath = [QueryPath queryPathWithString:@"dictionary:gas/bigNumber"];
+        GasPricePath = [QueryPath queryPathWithString:@"dictionary:gasPrice/bigNumber"];
+        GasUsedPath = [QueryPath queryPathWithString:@"dictionary:gasUsed/bigNumber"];
+        CumulativeGasUsedPath = [QueryPath queryPathWithString:@"dictionary:cumulativeGasUsed/bigNumber"];
+        NoncePath = [QueryPath queryPathWithString:@"dictionary:nonce/integer"];
+        DataPath = [QueryPath queryPathWithString:@"dictionary:data/data"];
+        InputPath = [QueryPath queryPathWithString:@"dictionary:input/data"];
+        ValuePath = [QueryPath queryPathWithString:@"dictionary:value/bigNumber"];
     });
 }
 
@@ -45,24 +84,24 @@ static NSData *NullData = nil;
     self = [super init];
     if (self) {
         
-        _transactionHash = queryPath(info, @"dictionary:hash/hash");
+        _transactionHash = [HashPath queryObject:info];
         if (!_transactionHash) {
             NSLog(@"ERROR: Missing hash");
             return nil;
         }
         
-        _blockHash = queryPath(info, @"dictionary:blockHash/hash");
+        _blockHash = [BlockHashPath queryObject:info];
         
-        NSNumber *blockNumber = queryPath(info, @"dictionary:blockNumber/integer");
+        NSNumber *blockNumber = [BlockNumberPath queryObject:info];
         if (blockNumber) {
             _blockNumber = [blockNumber integerValue];
         } else {
             _blockNumber = -1;
         }
         
-        NSNumber *timestamp = queryPath(info, @"dictionary:timestamp/integer");
+        NSNumber *timestamp = [TimestampPath queryObject:info];
         if (!timestamp) {
-            timestamp = queryPath(info, @"dictionary:timeStamp/integer");
+            timestamp = [EtherscanTimestampPath queryObject:info];
         }
         if (timestamp) {
             _timestamp = [timestamp longLongValue];
@@ -70,28 +109,28 @@ static NSData *NullData = nil;
             _timestamp = [[NSDate date] timeIntervalSince1970];
         }
         
-        _contractAddress = [Address addressWithString:queryPath(info, @"dictionary:contractAddress/string")];
+        _contractAddress = [Address addressWithString:[ContractAddressPath queryObject:info]];
         if (!_contractAddress) {
-            _contractAddress = [Address addressWithString:queryPath(info, @"dictionary:creates/string")];
+            _contractAddress = [Address addressWithString:[CreatesPath queryObject:info]];
         }
         
 
         // @TODO: Is this allowed to be nil?
-        _fromAddress = [Address addressWithString:queryPath(info, @"dictionary:from/string")];
+        _fromAddress = [Address addressWithString:[FromPath queryObject:info]];
         if (!_fromAddress) {
             NSLog(@"ERROR: Invalid fromAddress");
             return nil;
         }
 
-        _toAddress = [Address addressWithString:queryPath(info, @"dictionary:to/string")];
+        _toAddress = [Address addressWithString:[ToPath queryObject:info]];
         if (!_toAddress) {
             NSLog(@"ERROR: Invalid toAddress");
             return nil;
         }
         
-        _gasLimit = queryPath(info, @"dictionary:gasLimit/bigNumber");
+        _gasLimit = [GasLimitPath queryObject:info];
         if (!_gasLimit) {
-            _gasLimit = queryPath(info, @"dictionary:gas/bigNumber");
+            _gasLimit = [GasPath queryObject:info];
             
             if (!_gasLimit) {
                 NSLog(@"ERROR: Missing gasLimit");
@@ -99,32 +138,32 @@ static NSData *NullData = nil;
             }
         }
 
-        _gasPrice = queryPath(info, @"dictionary:gasPrice/bigNumber");
+        _gasPrice = [GasPricePath queryObject:info];
         if (!_gasPrice) {
             NSLog(@"ERROR: Missing gasPrice");
             return nil;
         }
 
-        _gasUsed = queryPath(info, @"dictionary:gasUsed/bigNumber");
+        _gasUsed = [GasUsedPath queryObject:info];
 
-        _cumulativeGasUsed = queryPath(info, @"dictionary:cumulativeGasUsed/bigNumber");
+        _cumulativeGasUsed = [CumulativeGasUsedPath queryObject:info];
 
-        NSNumber *nonce = queryPath(info, @"dictionary:nonce/integer");
+        NSNumber *nonce = [NoncePath queryObject:info];
         if (!nonce) {
             NSLog(@"ERROR: Missing nonce");
             return nil;
         }
         _nonce = [nonce integerValue];
         
-        _data = queryPath(info, @"dictionary:data/data");
+        _data = [DataPath queryObject:info];
         if (!_data) {
-            _data = queryPath(info, @"dictionary:input/data");
+            _data = [InputPath queryObject:info];
             if (!_data) {
                 _data = NullData;
             }
         }
         
-        _value = queryPath(info, @"dictionary:value/bigNumber");
+        _value = [ValuePath queryObject:info];
         if (!_value) {
             _value = [BigNumber constantZero];
         }
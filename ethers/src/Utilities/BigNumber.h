@@ -73,6 +73,9 @@
 @property (nonatomic, readonly) BOOL isSafeIntegerValue;
 @property (nonatomic, readonly) NSInteger integerValue;
 
+// The low 64 bits of the magnitude (see isSafeUnsignedIntegerValue)
+@property (nonatomic, readonly) uint64_t uint64Value;
+
 @property (nonatomic, readonly) NSData *data;
 
 
@@ -26,10 +26,9 @@
 
 #import "BigNumber.h"
 
-#include "tommath.h"
+#include <stdatomic.h>
 
-#import "RegEx.h"
-#import "SecureData.h"
+#include "tommath.h"
 
 
 static BigNumber *ConstantZero = nil;
@@ -41,11 +40,184 @@ static BigNumber *ConstantWeiPerEther = nil;
 static BigNumber *ConstantMaxSafeUnsignedInteger = nil;
 static BigNumber *ConstantMaxSafeSignedInteger = nil;
 
-static RegEx *RegexDecimal = nil;
-static RegEx *RegexHex = nil;
+// Shared instances for the most common values (BigNumbers are immutable)
+#define SmallValueCount          256
+#define PowerOfTenCount          20
+
+static BigNumber *SmallValues[SmallValueCount];
+static BigNumber *PowersOfTen[PowerOfTenCount];
+
+// Nibble value for each ASCII character, or -1 if not a hex digit
+static int8_t HexNibbles[256];
+
+static const char HexDigits[] = "0123456789ABCDEF";
+
+// 10^19 is the largest power of ten that fits in a 64-bit word
+#define DecimalChunkDigits       19
+#define DecimalChunkBase         10000000000000000000ULL
+
+
+#pragma mark - Fixed-width (256-bit) kernels
+
+/**
+ *  Almost every value we deal with (balances, gas, nonces, ...) is a non-negative
+ *  integer below 2^256, so those are kept inline as four little-endian 64-bit words
+ *  and operated on directly. Each kernel returns NO if the result does not fit, in
+ *  which case the caller falls back onto the arbitrary-precision mp_int.
+ */
+
+static inline uint64_t mul64(uint64_t a, uint64_t b, uint64_t *high) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 result = (unsigned __int128)a * b;
+    *high = (uint64_t)(result >> 64);
+    return (uint64_t)result;
+#else
+    uint64_t aLow = (uint32_t)a, aHigh = a >> 32, bLow = (uint32_t)b, bHigh = b >> 32;
+    uint64_t ll = aLow * bLow, lh = aLow * bHigh, hl = aHigh * bLow, hh = aHigh * bHigh;
+    uint64_t middle = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+    *high = hh + (lh >> 32) + (hl >> 32) + (middle >> 32);
+    return (middle << 32) | (uint32_t)ll;
+#endif
+}
+
+static inline BOOL uint256IsZero(const uint64_t *a) {
+    return (a[0] | a[1] | a[2] | a[3]) == 0;
+}
+
+static inline int uint256Compare(const uint64_t *a, const uint64_t *b) {
+    for (int i = 3; i >= 0; i--) {
+        if (a[i] != b[i]) { return (a[i] < b[i]) ? -1: 1; }
+    }
+    return 0;
+}
+
+static inline BOOL uint256Add(uint64_t *result, const uint64_t *a, const uint64_t *b) {
+    uint64_t carry = 0;
+    for (int i = 0; i < 4; i++) {
+        uint64_t sum = a[i] + carry;
+        carry = (sum < carry);
+        sum += b[i];
+        carry |= (sum < b[i]);
+        result[i] = sum;
+    }
+    return (carry == 0);
+}
+
+static inline BOOL uint256Sub(uint64_t *result, const uint64_t *a, const uint64_t *b) {
+    if (uint256Compare(a, b) < 0) { return NO; }
+    
+    uint64_t borrow = 0;
+    for (int i = 0; i < 4; i++) {
+        uint64_t difference = a[i] - b[i];
+        uint64_t nextBorrow = (a[i] < b[i]);
+        nextBorrow |= (difference < borrow);
+        result[i] = difference - borrow;
+        borrow = nextBorrow;
+    }
+    return YES;
+}
+
+static inline BOOL uint256Mul(uint64_t *result, const uint64_t *a, const uint64_t *b) {
+    uint64_t product[4] = { 0, 0, 0, 0 };
+    
+    for (int i = 0; i < 4; i++) {
+        if (a[i] == 0) { continue; }
+        
+        uint64_t carry = 0;
+        for (int j = 0; j < 4; j++) {
+            
+            // Anything landing above the 4th word overflows
+            if (i + j >= 4) {
+                if (b[j] || carry) { return NO; }
+                continue;
+            }
+            
+            uint64_t high, low = mul64(a[i], b[j], &high);
+            
+            // high:low + product[i + j] + carry cannot overflow 128 bits
+            low += carry;
+            high += (low < carry);
+            low += product[i + j];
+            high += (low < product[i + j]);
+            
+            product[i + j] = low;
+            carry = high;
+        }
+        
+        if (carry) { return NO; }
+    }
+    
+    memcpy(result, product, sizeof(product));
+    return YES;
+}
+
+// a = a * multiplier + addend
+static inline BOOL uint256MulAddWord(uint64_t *a, uint64_t multiplier, uint64_t addend) {
+    uint64_t carry = addend;
+    for (int i = 0; i < 4; i++) {
+        uint64_t high, low = mul64(a[i], multiplier, &high);
+        low += carry;
+        high += (low < carry);
+        a[i] = low;
+        carry = high;
+    }
+    return (carry == 0);
+}
+
+// Little-endian words to and from 32 big-endian bytes
+static inline void uint256ToBytes(uint8_t *bytes, const uint64_t *a) {
+    for (int i = 0; i < 32; i++) {
+        bytes[31 - i] = (a[i / 8] >> ((i % 8) * 8)) & 0xff;
+    }
+}
+
+static inline void uint256FromBytes(uint64_t *a, const uint8_t *bytes) {
+    memset(a, 0, 4 * sizeof(uint64_t));
+    for (int i = 0; i < 32; i++) {
+        a[i / 8] |= ((uint64_t)bytes[31 - i]) << ((i % 8) * 8);
+    }
+}
+
+#if defined(__SIZEOF_INT128__)
+// Divides by a single (non-zero) word, returning the remainder
+static inline uint64_t uint256DivWord(uint64_t *quotient, const uint64_t *a, uint64_t divisor) {
+    unsigned __int128 remainder = 0;
+    for (int i = 3; i >= 0; i--) {
+        unsigned __int128 current = (remainder << 64) | a[i];
+        quotient[i] = (uint64_t)(current / divisor);
+        remainder = current % divisor;
+    }
+    return (uint64_t)remainder;
+}
+#endif
+
 
+#pragma mark - String helpers
+
+// Returns the ASCII bytes of string, only allocating for long (or non-literal, long) strings
+static const char *asciiBytes(NSString *string, char *buffer, size_t bufferSize) {
+    const char *bytes = CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingASCII);
+    if (bytes) { return bytes; }
+    
+    if (string.length < bufferSize && [string getCString:buffer maxLength:bufferSize encoding:NSASCIIStringEncoding]) {
+        return buffer;
+    }
+    
+    return [string cStringUsingEncoding:NSASCIIStringEncoding];
+}
+
+
+#pragma mark - BigNumber
 
 @implementation BigNumber {
+    
+    // Set if the value is non-negative and below 2^256; _words then holds the value
+    BOOL _fits;
+    uint64_t _words[4];
+    
+    // The arbitrary-precision value; for values that fit this is only
+    // created (from _words) the first time something needs it
+    atomic_bool _hasBigNumber;
     mp_int _bigNumber;
 }
 
@@ -56,8 +228,25 @@ static RegEx *RegexHex = nil;
     dispatch_once(&onceToken, ^{
         
         // Make sure we initialize these before creating the constants below
-        RegexDecimal = [RegEx regExWithPattern:@"^-?[0-9]*$"];
-        RegexHex = [RegEx regExWithPattern:@"^-?0x[0-9A-Fa-f]*$"];
+        memset(HexNibbles, -1, sizeof(HexNibbles));
+        for (int i = 0; i < 10; i++) { HexNibbles['0' + i] = i; }
+        for (int i = 0; i < 6; i++) {
+            HexNibbles['a' + i] = 10 + i;
+            HexNibbles['A' + i] = 10 + i;
+        }
+
+        // Populate the caches before anything below can consult them
+        uint64_t words[4] = { 0, 0, 0, 0 };
+        for (uint64_t i = 0; i < SmallValueCount; i++) {
+            words[0] = i;
+            SmallValues[i] = [[BigNumber alloc] _initWithWords:words];
+        }
+        
+        words[0] = 1;
+        for (int i = 0; i < PowerOfTenCount; i++) {
+            PowersOfTen[i] = (words[0] < SmallValueCount) ? SmallValues[words[0]]: [[BigNumber alloc] _initWithWords:words];
+            words[0] *= 10;
+        }
 
         ConstantNegativeOne = [BigNumber bigNumberWithInteger:-1];
         ConstantZero = [BigNumber bigNumberWithInteger:0];
@@ -73,7 +262,7 @@ static RegEx *RegexHex = nil;
 - (instancetype)init {
     self = [super init];
     if (self) {
-        mp_init(&_bigNumber);
+        _fits = YES;
     }
     return self;
 }
@@ -81,68 +270,248 @@ static RegEx *RegexHex = nil;
 - (instancetype)initWithValue: (mp_digit)value {
     self = [super init];
     if (self) {
-        mp_init_set(&_bigNumber, value);
+        _fits = YES;
+        _words[0] = value;
     }
     return self;
 }
 
-+ (instancetype)bigNumberWithDecimalString:(NSString *)decimalString {
-    if (![RegexDecimal matchesExactly:decimalString]) { return nil; }
+- (instancetype)_initWithWords: (const uint64_t*)words {
+    self = [super init];
+    if (self) {
+        _fits = YES;
+        memcpy(_words, words, sizeof(_words));
+    }
+    return self;
+}
+
+// Returns a shared instance for common values, otherwise a new instance
++ (BigNumber*)_bigNumberWithWords: (const uint64_t*)words {
+    if (!(words[1] | words[2] | words[3])) {
+        uint64_t value = words[0];
+        if (value < SmallValueCount) { return SmallValues[value]; }
+        
+        if (value % 1000 == 0) {
+            for (int i = 3; i < PowerOfTenCount; i++) {
+                if (PowersOfTen[i]->_words[0] == value) { return PowersOfTen[i]; }
+            }
+        }
+    }
+    
+    return [[BigNumber alloc] _initWithWords:words];
+}
 
-    BigNumber *bigNumber = [[BigNumber alloc] init];
+// Creates an empty mp_int value to be written into; the caller must call _normalize
+- (instancetype)_initBigNumber {
+    self = [super init];
     if (self) {
-        mp_read_radix([bigNumber _bigNumber], [decimalString cStringUsingEncoding:NSASCIIStringEncoding], 10);
+        mp_init(&_bigNumber);
+        atomic_store_explicit(&_hasBigNumber, true, memory_order_relaxed);
+    }
+    return self;
+}
+
++ (BigNumber*)_bigNumberWithCString: (const char*)string radix: (int)radix negative: (BOOL)negative {
+    BigNumber *bigNumber = [[BigNumber alloc] _initBigNumber];
+    mp_read_radix(&bigNumber->_bigNumber, string, radix);
+    if (negative) { mp_neg(&bigNumber->_bigNumber, &bigNumber->_bigNumber); }
+    [bigNumber _normalize];
+    return bigNumber;
+}
+
++ (BigNumber*)_bigNumberWithUInt64: (uint64_t)value {
+    uint64_t words[4] = { value, 0, 0, 0 };
+    return [BigNumber _bigNumberWithWords:words];
+}
+
++ (BigNumber*)_bigNumberWithInt64: (int64_t)value {
+    if (value >= 0) { return [BigNumber _bigNumberWithUInt64:(uint64_t)value]; }
+    
+    BigNumber *bigNumber = [[BigNumber alloc] _initBigNumber];
+    
+    // Negate in unsigned arithmetic, so INT64_MIN does not overflow
+    uint64_t magnitude = (uint64_t)0 - (uint64_t)value;
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[7 - i] = (magnitude >> (i * 8)) & 0xff;
     }
+    mp_read_unsigned_bin(&bigNumber->_bigNumber, bytes, sizeof(bytes));
+    mp_neg(&bigNumber->_bigNumber, &bigNumber->_bigNumber);
+    [bigNumber _normalize];
     return bigNumber;
 }
 
++ (instancetype)bigNumberWithDecimalString:(NSString *)decimalString {
+    if (!decimalString) { return nil; }
+    
+    char buffer[96];
+    const char *chars = asciiBytes(decimalString, buffer, sizeof(buffer));
+    if (!chars) { return nil; }
+    
+    BOOL negative = NO;
+    if (chars[0] == '-') {
+        negative = YES;
+        chars++;
+    }
+    
+    // Validate (matches /^-?[0-9]*$/)
+    size_t length = 0;
+    while (chars[length]) {
+        if (chars[length] < '0' || chars[length] > '9') { return nil; }
+        length++;
+    }
+    
+    // Skip leading zeros
+    while (length && chars[0] == '0') { chars++; length--; }
+    if (length == 0) { return [BigNumber constantZero]; }
+    
+    if (!negative) {
+        
+        // Consume 19 digits at a time; the first chunk takes the remainder
+        uint64_t words[4] = { 0, 0, 0, 0 };
+        size_t offset = 0, chunkLength = length % DecimalChunkDigits;
+        if (chunkLength == 0) { chunkLength = DecimalChunkDigits; }
+        
+        BOOL fits = YES;
+        while (fits && offset < length) {
+            uint64_t chunk = 0, multiplier = 1;
+            for (size_t i = 0; i < chunkLength; i++) {
+                chunk = chunk * 10 + (chars[offset + i] - '0');
+                multiplier *= 10;
+            }
+            fits = uint256MulAddWord(words, multiplier, chunk);
+            offset += chunkLength;
+            chunkLength = DecimalChunkDigits;
+        }
+        
+        if (fits) { return [BigNumber _bigNumberWithWords:words]; }
+    }
+    
+    return [BigNumber _bigNumberWithCString:chars radix:10 negative:negative];
+}
+
 + (instancetype)bigNumberWithHexString:(NSString *)hexString {
-    if (![RegexHex matchesExactly:hexString]) { return nil; }
+    if (!hexString) { return nil; }
     
-    if ([hexString hasPrefix:@"-"]) {
-        hexString = [@"-" stringByAppendingString:[hexString substringFromIndex:3]];
-    } else {
-        hexString = [hexString substringFromIndex:2];
+    char buffer[96];
+    const char *chars = asciiBytes(hexString, buffer, sizeof(buffer));
+    if (!chars) { return nil; }
+    
+    BOOL negative = NO;
+    if (chars[0] == '-') {
+        negative = YES;
+        chars++;
     }
     
-    BigNumber *bigNumber = [[BigNumber alloc] init];
-    if (self) {
-        mp_read_radix([bigNumber _bigNumber], [hexString cStringUsingEncoding:NSASCIIStringEncoding], 16);
+    if (chars[0] != '0' || chars[1] != 'x') { return nil; }
+    chars += 2;
+    
+    // Validate (matches /^-?0x[0-9A-Fa-f]*$/)
+    size_t length = 0;
+    while (chars[length]) {
+        if (HexNibbles[(uint8_t)chars[length]] < 0) { return nil; }
+        length++;
     }
-    return bigNumber;
+    
+    // Skip leading zeros
+    while (length && chars[0] == '0') { chars++; length--; }
+    if (length == 0) { return [BigNumber constantZero]; }
+    
+    if (!negative && length <= 64) {
+        uint64_t words[4] = { 0, 0, 0, 0 };
+        for (size_t i = 0; i < length; i++) {
+            size_t shift = (length - 1 - i) * 4;
+            words[shift / 64] |= ((uint64_t)HexNibbles[(uint8_t)chars[i]]) << (shift % 64);
+        }
+        return [BigNumber _bigNumberWithWords:words];
+    }
+    
+    return [BigNumber _bigNumberWithCString:chars radix:16 negative:negative];
 }
 
 + (instancetype)bigNumberWithBase36String:(NSString *)base36String {
     // checkString(hexString, @"^-?0x[1-9A-Fa-f][0-9A-Fa-f]*$");
-    BigNumber *bigNumber = [[BigNumber alloc] init];
-    if (self) {
-        mp_read_radix([bigNumber _bigNumber], [base36String cStringUsingEncoding:NSASCIIStringEncoding], 36);
-    }
-    return bigNumber;
+    return [BigNumber _bigNumberWithCString:[base36String cStringUsingEncoding:NSASCIIStringEncoding] radix:36 negative:NO];
 }
 
 
 + (instancetype)bigNumberWithData:(NSData *)data {
     if (data.length == 0) { return [BigNumber constantZero]; }
-    return [BigNumber bigNumberWithHexString:[SecureData dataToHexString:data]];
+    
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    
+    if (length <= 32) {
+        
+        // Big-endian bytes into little-endian words
+        uint64_t words[4] = { 0, 0, 0, 0 };
+        for (NSUInteger i = 0; i < length; i++) {
+            NSUInteger shift = (length - 1 - i) * 8;
+            words[shift / 64] |= ((uint64_t)bytes[i]) << (shift % 64);
+        }
+        return [BigNumber _bigNumberWithWords:words];
+    }
+    
+    BigNumber *bigNumber = [[BigNumber alloc] _initBigNumber];
+    mp_read_unsigned_bin(&bigNumber->_bigNumber, bytes, (int)length);
+    [bigNumber _normalize];
+    return bigNumber;
 }
 
 + (instancetype)bigNumberWithNumber:(NSNumber *)number {
+    if (!number) { return nil; }
+    
+    switch (number.objCType[0]) {
+        case 'c': case 's': case 'i': case 'l': case 'q':
+            return [BigNumber _bigNumberWithInt64:number.longLongValue];
+        case 'B': case 'C': case 'S': case 'I': case 'L': case 'Q':
+            return [BigNumber _bigNumberWithUInt64:number.unsignedLongLongValue];
+        default:
+            break;
+    }
+    
+    // Floating point values must be integral, which the decimal parser verifies
     return [self bigNumberWithDecimalString:[number stringValue]];
 }
 
 + (instancetype)bigNumberWithInteger:(NSInteger)integer {
-    return [self bigNumberWithDecimalString:[[NSNumber numberWithInteger:integer] stringValue]];
+    return [BigNumber _bigNumberWithInt64:integer];
 }
 
 - (void)dealloc {
-    mp_clear(&_bigNumber);
+    if (atomic_load_explicit(&_hasBigNumber, memory_order_acquire)) {
+        mp_clear(&_bigNumber);
+    }
 }
 
 - (mp_int*)_bigNumber {
+    if (!atomic_load_explicit(&_hasBigNumber, memory_order_acquire)) {
+        @synchronized (self) {
+            if (!atomic_load_explicit(&_hasBigNumber, memory_order_relaxed)) {
+                uint8_t bytes[32];
+                uint256ToBytes(bytes, _words);
+                mp_init(&_bigNumber);
+                mp_read_unsigned_bin(&_bigNumber, bytes, sizeof(bytes));
+                atomic_store_explicit(&_hasBigNumber, true, memory_order_release);
+            }
+        }
+    }
     return &_bigNumber;
 }
 
+// Called after writing into the mp_int; populates the inline words if the value fits
+- (void)_normalize {
+    _fits = NO;
+    if (_bigNumber.sign == MP_NEG || mp_count_bits(&_bigNumber) > 256) { return; }
+    
+    // mp_to_unsigned_bin writes the minimal big-endian bytes
+    uint8_t bytes[32];
+    memset(bytes, 0, sizeof(bytes));
+    mp_to_unsigned_bin(&_bigNumber, &bytes[32 - mp_unsigned_bin_size(&_bigNumber)]);
+    uint256FromBytes(_words, bytes);
+    _fits = YES;
+}
+
 
 #pragma mark - Constants
 
@@ -171,32 +540,79 @@ static RegEx *RegexHex = nil;
 #pragma mark - Operations
 
 - (BigNumber*)add:(BigNumber *)other {
-    BigNumber *result = [[BigNumber alloc] init];
-    mp_add(&_bigNumber, [other _bigNumber], [result _bigNumber]);
+    if (_fits && other->_fits) {
+        uint64_t words[4];
+        if (uint256Add(words, _words, other->_words)) {
+            return [BigNumber _bigNumberWithWords:words];
+        }
+    }
+    
+    BigNumber *result = [[BigNumber alloc] _initBigNumber];
+    mp_add([self _bigNumber], [other _bigNumber], &result->_bigNumber);
+    [result _normalize];
     return result;
 }
 
 - (BigNumber*)sub:(BigNumber *)other {
-    BigNumber *result = [[BigNumber alloc] init];
-    mp_sub(&_bigNumber, [other _bigNumber], [result _bigNumber]);
+    if (_fits && other->_fits) {
+        uint64_t words[4];
+        if (uint256Sub(words, _words, other->_words)) {
+            return [BigNumber _bigNumberWithWords:words];
+        }
+    }
+    
+    BigNumber *result = [[BigNumber alloc] _initBigNumber];
+    mp_sub([self _bigNumber], [other _bigNumber], &result->_bigNumber);
+    [result _normalize];
     return result;
 }
 
 - (BigNumber*)mul:(BigNumber *)other {
-    BigNumber *result = [[BigNumber alloc] init];
-    mp_mul(&_bigNumber, [other _bigNumber], [result _bigNumber]);
+    if (_fits && other->_fits) {
+        uint64_t words[4];
+        if (uint256Mul(words, _words, other->_words)) {
+            return [BigNumber _bigNumberWithWords:words];
+        }
+    }
+    
+    BigNumber *result = [[BigNumber alloc] _initBigNumber];
+    mp_mul([self _bigNumber], [other _bigNumber], &result->_bigNumber);
+    [result _normalize];
     return result;
 }
 
+// Whether other is a non-zero value that fits in a single word
+- (BOOL)_isWordDivisor {
+    return (_fits && _words[0] && !(_words[1] | _words[2] | _words[3]));
+}
+
 - (BigNumber*)div:(BigNumber *)other {
-    BigNumber *result = [[BigNumber alloc] init];
-    mp_div(&_bigNumber, [other _bigNumber], [result _bigNumber], NULL);
+#if defined(__SIZEOF_INT128__)
+    if (_fits && [other _isWordDivisor]) {
+        uint64_t words[4];
+        uint256DivWord(words, _words, other->_words[0]);
+        return [BigNumber _bigNumberWithWords:words];
+    }
+#endif
+    
+    BigNumber *result = [[BigNumber alloc] _initBigNumber];
+    mp_div([self _bigNumber], [other _bigNumber], &result->_bigNumber, NULL);
+    [result _normalize];
     return result;
 }
 
 - (BigNumber*)mod:(BigNumber *)other {
-    BigNumber *result = [[BigNumber alloc] init];
-    mp_div(&_bigNumber, [other _bigNumber], NULL, [result _bigNumber]);
+#if defined(__SIZEOF_INT128__)
+    if (_fits && [other _isWordDivisor]) {
+        uint64_t quotient[4], words[4] = { 0, 0, 0, 0 };
+        words[0] = uint256DivWord(quotient, _words, other->_words[0]);
+        return [BigNumber _bigNumberWithWords:words];
+    }
+#endif
+    
+    BigNumber *result = [[BigNumber alloc] _initBigNumber];
+    mp_div([self _bigNumber], [other _bigNumber], NULL, &result->_bigNumber);
+    [result _normalize];
     return result;
 }
 
@@ -204,10 +620,12 @@ static RegEx *RegexHex = nil;
 #pragma mark - Query API
 
 - (BOOL)isZero {
-    return (mp_cmp([ConstantZero _bigNumber], &_bigNumber) == MP_EQ);
+    // Zero always fits, so anything else is non-zero
+    return (_fits && uint256IsZero(_words));
 }
 
 - (BOOL)isNegative {
+    if (_fits) { return NO; }
     return (_bigNumber.sign == MP_NEG);
 }
 
@@ -215,19 +633,69 @@ static RegEx *RegexHex = nil;
 #pragma mark - String Operations
 
 - (NSString*)formatString:(int)radix {
+    mp_int *bigNumber = [self _bigNumber];
+    
     int radixSize;
-    mp_radix_size(&_bigNumber, radix, &radixSize);
+    mp_radix_size(bigNumber, radix, &radixSize);
     
     char result[radixSize];
-    mp_toradix(&_bigNumber, result, radix);
+    mp_toradix(bigNumber, result, radix);
     return [[NSString alloc] initWithCString:result encoding:NSASCIIStringEncoding];
 }
 
 - (NSString*)decimalString {
+#if defined(__SIZEOF_INT128__)
+    if (_fits) {
+        
+        // 2^256 has 78 decimal digits
+        char buffer[80];
+        size_t offset = sizeof(buffer);
+        
+        uint64_t words[4];
+        memcpy(words, _words, sizeof(words));
+        
+        do {
+            uint64_t chunk = uint256DivWord(words, words, DecimalChunkBase);
+            BOOL last = uint256IsZero(words);
+            
+            // Every chunk but the most significant is zero-padded
+            for (int i = 0; i < DecimalChunkDigits && (!last || chunk || i == 0); i++) {
+                buffer[--offset] = '0' + (chunk % 10);
+                chunk /= 10;
+            }
+            
+            if (last) { break; }
+        } while (YES);
+        
+        return [[NSString alloc] initWithBytes:&buffer[offset] length:sizeof(buffer) - offset encoding:NSASCIIStringEncoding];
+    }
+#endif
+    
     return [self formatString:10];
 }
 
 - (NSString*)hexString {
+    if (_fits) {
+        char buffer[2 + 64];
+        buffer[0] = '0';
+        buffer[1] = 'x';
+        
+        // Find the most significant non-zero byte (zero is still "0x00")
+        int byteCount = 32;
+        while (byteCount > 1 && ((_words[(byteCount - 1) / 8] >> (((byteCount - 1) % 8) * 8)) & 0xff) == 0) {
+            byteCount--;
+        }
+        
+        size_t offset = 2;
+        for (int i = byteCount - 1; i >= 0; i--) {
+            uint8_t byte = (_words[i / 8] >> ((i % 8) * 8)) & 0xff;
+            buffer[offset++] = HexDigits[byte >> 4];
+            buffer[offset++] = HexDigits[byte & 0x0f];
+        }
+        
+        return [[NSString alloc] initWithBytes:buffer length:offset encoding:NSASCIIStringEncoding];
+    }
+    
     NSString *hexString = [self formatString:16];
     
     if (self.isNegative) {
@@ -252,37 +720,31 @@ static RegEx *RegexHex = nil;
 }
 
 - (BOOL)isSafeUnsignedIntegerValue {
-    return (mp_cmp(&_bigNumber, [ConstantMaxSafeUnsignedInteger _bigNumber]) == MP_LT && ![self isNegative]);
+    if (!_fits) { return NO; }
+    return (!(_words[1] | _words[2] | _words[3]) && _words[0] < UINT64_MAX);
 }
 
 - (BOOL)isSafeIntegerValue {
-    return mp_cmp(&_bigNumber, [ConstantMaxSafeSignedInteger _bigNumber]) == MP_LT;
+    if (_fits) {
+        return (!(_words[1] | _words[2] | _words[3]) && _words[0] < INT64_MAX);
+    }
+    return mp_cmp([self _bigNumber], [ConstantMaxSafeSignedInteger _bigNumber]) == MP_LT;
 }
 
-// @TODO: there are certainly better ways to do this
-- (NSUInteger)unsignedIntegerValue {
-    int radixSize;
-    mp_radix_size(&_bigNumber, 16, &radixSize);
-    
-    char hexString[radixSize];
-    mp_toradix(&_bigNumber, hexString, 16);
-    
-    NSUInteger result = 0;
-    
-    // Skip null-termination
-    for (int i = 0; i < radixSize - 1; i++) {
-        result <<= 4;
-        unsigned char c = hexString[i];
-        if (c <= '9') {
-            result += (c - '0');
-        } else if (c <= 'F') {
-            result += 10 + (c - 'A');
-        } else if (c <= 'f') {
-            result += 10 + (c - 'a');
-        }
-    }
+- (uint64_t)uint64Value {
+    if (_fits) { return _words[0]; }
     
-    return result;
+    // The low 64 bits of the magnitude (digits hold DIGIT_BIT bits each)
+    mp_int *bigNumber = [self _bigNumber];
+    uint64_t value = 0;
+    for (int i = MIN(bigNumber->used, (64 + DIGIT_BIT - 1) / DIGIT_BIT) - 1; i >= 0; i--) {
+        value = (value << DIGIT_BIT) | (uint64_t)bigNumber->dp[i];
+    }
+    return value;
+}
+
+- (NSUInteger)unsignedIntegerValue {
+    return (NSUInteger)[self uint64Value];
 }
 
 - (NSInteger)integerValue {
@@ -296,28 +758,54 @@ static RegEx *RegexHex = nil;
 }
 
 - (NSData*)data {
-    return [SecureData hexStringToData:[self hexString]];
+    if (_fits) {
+        uint8_t bytes[32];
+        uint256ToBytes(bytes, _words);
+        
+        // Minimal big-endian encoding (zero is a single zero byte)
+        int offset = 0;
+        while (offset < 31 && bytes[offset] == 0) { offset++; }
+        return [NSData dataWithBytes:&bytes[offset] length:32 - offset];
+    }
+    
+    // Negative values have no byte representation
+    if (self.isNegative) { return nil; }
+    
+    mp_int *bigNumber = [self _bigNumber];
+    NSMutableData *data = [NSMutableData dataWithLength:mp_unsigned_bin_size(bigNumber)];
+    mp_to_unsigned_bin(bigNumber, data.mutableBytes);
+    return data;
 }
 
 #pragma mark - More intuitive inequalities
 
+// Returns MP_LT, MP_EQ or MP_GT
+- (int)_compare: (BigNumber*)other {
+    if (_fits && other->_fits) {
+        int result = uint256Compare(_words, other->_words);
+        if (result == 0) { return MP_EQ; }
+        return (result < 0) ? MP_LT: MP_GT;
+    }
+    return mp_cmp([self _bigNumber], [other _bigNumber]);
+}
+
 - (BOOL)lessThan: (BigNumber*)other {
-    int result = mp_cmp(&_bigNumber, [((BigNumber*)other) _bigNumber]);
+    int result = [self _compare:other];
     return (result == MP_LT);
 }
 
 - (BOOL)lessThanEqualTo: (BigNumber*)other {
-    int result = mp_cmp(&_bigNumber, [((BigNumber*)other) _bigNumber]);
+    int result = [self _compare:other];
     return (result == MP_EQ || result == MP_LT);
 }
 
 - (BOOL)greaterThan: (BigNumber*)other {
-    int result = mp_cmp(&_bigNumber, [((BigNumber*)other) _bigNumber]);
+    int result = [self _compare:other];
     return (result == MP_GT);
 }
 
 - (BOOL)greaterThanEqualTo: (BigNumber*)other {
-    int result = mp_cmp(&_bigNumber, [((BigNumber*)other) _bigNumber]);
+    int result = [self _compare:other];
     return (result == MP_EQ || result == MP_GT);
 }
 
@@ -330,6 +818,10 @@ static RegEx *RegexHex = nil;
 }
 
 - (NSUInteger)hash {
+    // Values have a single canonical representation, so equal values hash equally
+    if (_fits) {
+        return (NSUInteger)(_words[0] ^ _words[1] ^ _words[2] ^ _words[3]);
+    }
     return [[self decimalString] hash];
 }
 
@@ -342,7 +834,7 @@ static RegEx *RegexHex = nil;
         return NSOrderedDescending;
     }
 
-    int result = mp_cmp(&_bigNumber, [((BigNumber*)other) _bigNumber]);
+    int result = [self _compare:(BigNumber*)other];
     if (result == MP_EQ) {
         return NSOrderedSame;
     } else if (result == MP_LT) {
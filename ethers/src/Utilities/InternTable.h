@@ -0,0 +1,69 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ *  InternTable
+ *
+ *  A thread-safe table mapping raw bytes to a single shared (immutable) object,
+ *  so that identical values created from different sources are the same instance.
+ *  Objects are held weakly; once nothing else references an object it is dropped.
+ *
+ *  The table is split into independently locked stripes, so concurrent lookups of
+ *  different values rarely contend.
+ */
+
+#import <Foundation/Foundation.h>
+
+
+@interface InternTable : NSObject
+
++ (instancetype)internTable;
+
+// Returns the interned object for the bytes, or nil if there is none
+- (id)objectForBytes: (const void*)bytes length: (NSUInteger)length;
+
+// Returns the interned object for the bytes if there is one, otherwise interns and returns object
+- (id)internObject: (id)object bytes: (const void*)bytes length: (NSUInteger)length;
+
+// As internObject:bytes:length:, for after objectForBytes:length: missed, so the lookup is only counted once
+- (id)internMissedObject: (id)object bytes: (const void*)bytes length: (NSUInteger)length;
+
+- (void)removeAllObjects;
+
+// The number of entries, including any whose object was released since the last sweep
+@property (nonatomic, readonly) NSUInteger count;
+
+
+#pragma mark - Statistics
+
+@property (nonatomic, readonly) NSUInteger lookupCount;
+@property (nonatomic, readonly) NSUInteger hitCount;
+
+// The fraction of lookups that found an existing object (0 if there have been no lookups)
+@property (nonatomic, readonly) double hitRate;
+
+- (void)resetStatistics;
+
+@end
@@ -0,0 +1,184 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import "InternTable.h"
+
+#include <stdatomic.h>
+
+
+#define StripeCount          16
+
+// A stripe is swept for entries whose object is gone once it grows past this many
+// entries (or twice its size after the last sweep, if larger)
+#define MinimumSweepCount    256
+
+// FNV-1a; the values interned (addresses and hashes) are already well distributed,
+// but this keeps the table safe for any bytes
+static NSUInteger hashBytes(const unsigned char *bytes, NSUInteger length) {
+    uint32_t hash = 2166136261u;
+    for (NSUInteger i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+
+@implementation InternTable {
+    NSMapTable<NSData*, id> *_stripes[StripeCount];
+    
+    // Guarded by @synchronized (the matching stripe)
+    NSUInteger _sweepCounts[StripeCount];
+    
+    atomic_ulong _lookupCount;
+    atomic_ulong _hitCount;
+}
+
++ (instancetype)internTable {
+    return [[InternTable alloc] init];
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        for (int i = 0; i < StripeCount; i++) {
+            _stripes[i] = [NSMapTable strongToWeakObjectsMapTable];
+            _sweepCounts[i] = MinimumSweepCount;
+        }
+    }
+    return self;
+}
+
+- (id)_objectForKey: (NSData*)key stripe: (NSMapTable*)stripe counted: (BOOL)counted {
+    id object = [stripe objectForKey:key];
+    
+    if (counted) {
+        atomic_fetch_add_explicit(&_lookupCount, 1, memory_order_relaxed);
+        if (object) { atomic_fetch_add_explicit(&_hitCount, 1, memory_order_relaxed); }
+    }
+    
+    return object;
+}
+
+- (id)objectForBytes: (const void*)bytes length: (NSUInteger)length {
+    NSMapTable *stripe = _stripes[hashBytes(bytes, length) % StripeCount];
+    
+    // The key is only used for the lookup, so there is no need to copy the bytes
+    NSData *key = [NSData dataWithBytesNoCopy:(void*)bytes length:length freeWhenDone:NO];
+    
+    @synchronized (stripe) {
+        return [self _objectForKey:key stripe:stripe counted:YES];
+    }
+}
+
+// The weakly held objects are released, but their (copied) keys stay in the table until
+// removed; the caller must hold the stripe's lock
+- (void)_sweepStripe: (NSUInteger)index {
+    NSMapTable *stripe = _stripes[index];
+    
+    NSMutableArray<NSData*> *deadKeys = [NSMutableArray array];
+    for (NSData *key in stripe) {
+        if (![stripe objectForKey:key]) { [deadKeys addObject:key]; }
+    }
+    for (NSData *key in deadKeys) { [stripe removeObjectForKey:key]; }
+    
+    _sweepCounts[index] = MAX(MinimumSweepCount, 2 * stripe.count);
+}
+
+- (id)_internObject: (id)object bytes: (const void*)bytes length: (NSUInteger)length counted: (BOOL)counted {
+    if (!object) { return nil; }
+    
+    NSUInteger index = hashBytes(bytes, length) % StripeCount;
+    NSMapTable *stripe = _stripes[index];
+    NSData *key = [NSData dataWithBytesNoCopy:(void*)bytes length:length freeWhenDone:NO];
+    
+    @synchronized (stripe) {
+        id existing = [self _objectForKey:key stripe:stripe counted:counted];
+        if (existing) { return existing; }
+        
+        [stripe setObject:object forKey:[NSData dataWithBytes:bytes length:length]];
+        if (stripe.count > _sweepCounts[index]) { [self _sweepStripe:index]; }
+        
+        return object;
+    }
+}
+
+- (id)internObject: (id)object bytes: (const void*)bytes length: (NSUInteger)length {
+    return [self _internObject:object bytes:bytes length:length counted:YES];
+}
+
+- (id)internMissedObject: (id)object bytes: (const void*)bytes length: (NSUInteger)length {
+    return [self _internObject:object bytes:bytes length:length counted:NO];
+}
+
+- (void)removeAllObjects {
+    for (int i = 0; i < StripeCount; i++) {
+        @synchronized (_stripes[i]) {
+            [_stripes[i] removeAllObjects];
+            _sweepCounts[i] = MinimumSweepCount;
+        }
+    }
+}
+
+- (NSUInteger)count {
+    NSUInteger count = 0;
+    for (int i = 0; i < StripeCount; i++) {
+        @synchronized (_stripes[i]) {
+            count += _stripes[i].count;
+        }
+    }
+    return count;
+}
+
+
+#pragma mark - Statistics
+
+- (NSUInteger)lookupCount {
+    return atomic_load_explicit(&_lookupCount, memory_order_relaxed);
+}
+
+- (NSUInteger)hitCount {
+    return atomic_load_explicit(&_hitCount, memory_order_relaxed);
+}
+
+- (double)hitRate {
+    NSUInteger lookupCount = self.lookupCount;
+    if (lookupCount == 0) { return 0.0; }
+    return (double)self.hitCount / (double)lookupCount;
+}
+
+- (void)resetStatistics {
+    atomic_store_explicit(&_lookupCount, 0, memory_order_relaxed);
+    atomic_store_explicit(&_hitCount, 0, memory_order_relaxed);
+}
+
+
+#pragma mark - NSObject
+
+- (NSString*)description {
+    return [NSString stringWithFormat:@"<InternTable lookups=%lu hits=%lu hitRate=%.3f>",
+            (unsigned long)self.lookupCount, (unsigned long)self.hitCount, self.hitRate];
+}
+
+@end
@@ -38,11 +38,13 @@
  *  Promise is rejected with nil, an Error will be created with the domain PromiseErrorDomain.
  *
  *  The onCallback handlers are:
- *     - called on the main thread
+ *     - called on the Promise's callbackQueue (by default, the main queue)
  *     - called in the order in which they were added
- *     - never called in the same event loop (deferred, even if complete)
+ *     - never called in the same event loop (deferred, even if complete), unless
+ *       the callbackQueue is nil, in which case they are called inline by whichever
+ *       thread completes the Promise (or adds the callback, if already complete)
  *
- *  All operations are thread-safe.
+ *  All operations are thread-safe and lock-free.
  */
 
 #import <Foundation/Foundation.h>
@@ -54,13 +56,46 @@
 #import "TransactionInfo.h"
 
 
+#pragma mark -
+#pragma mark - CancellationToken
+
+/**
+ *  A CancellationToken lets the consumer of a Promise signal that its result is no longer
+ *  needed, so whatever is producing it (e.g. a network request) can stop early. Cancelling
+ *  is cooperative; the producer registers onCancel: handlers to abandon its work.
+ */
+
+@interface CancellationToken : NSObject
+
++ (instancetype)cancellationToken;
+
+@property (atomic, readonly) BOOL cancelled;
+
+- (void)cancel;
+
+// Called once, on the thread which cancels (or immediately, if already cancelled)
+- (void)onCancel: (void (^)(void))cancelCallback;
+
+@end
+
+
 #pragma mark -
 #pragma mark - Promise
 
 
 extern NSErrorDomain PromiseErrorDomain;
 
+typedef enum PromiseError {
+    PromiseErrorCancelled                       = -1,
+    PromiseErrorTimeout                         = -2,
+    PromiseErrorAllRejected                     = -3,
+} PromiseError;
+
 @class ArrayPromise;
+@class Promise;
+
+// A plain C completion callback, for hot paths that want to avoid allocating a block
+typedef void (*PromiseContinuation)(Promise *promise, void *context);
 
 
 @interface Promise : NSObject
@@ -79,11 +114,28 @@ extern NSErrorDomain PromiseErrorDomain;
 
 + (ArrayPromise*)all: (NSArray<Promise*>*)promises;
 
-// Like JavaScript's race, whichever returns first
-//+ (inst)any: (NSArray<Promise*>*)promises;
+// Resolves with the (completed) promises, once every one of them has resolved or rejected
++ (ArrayPromise*)allSettled: (NSArray<Promise*>*)promises;
+
+// Like JavaScript's race, whichever completes first (resolved or rejected); the rest are cancelled
++ (instancetype)race: (NSArray<Promise*>*)promises;
+
+// Whichever resolves first (the rest are cancelled); rejects with PromiseErrorAllRejected if none do
++ (instancetype)any: (NSArray<Promise*>*)promises;
 
-// @TODO: We can replace fallback with this... Try each one until one success (or all fail)
-//+ (inst)serialFallback: (NSArray<Promise*>*)promises;
+// Follows this Promise, but rejects with PromiseErrorTimeout (cancelling this Promise) if it
+// has not completed within timeout seconds
+- (instancetype)timeout: (NSTimeInterval)timeout;
+
+
+#pragma mark - Choosing where callbacks run
+
+// The callbackQueue new Promises start with (the main queue, unless changed)
++ (dispatch_queue_t)defaultCallbackQueue;
++ (void)setDefaultCallbackQueue: (dispatch_queue_t)callbackQueue;
+
+// Applies to callbacks dispatched after it is set; nil runs them inline
+@property (atomic, strong) dispatch_queue_t callbackQueue;
 
 
 #pragma mark - Querying the current state and resolution status
@@ -100,9 +152,33 @@ extern NSErrorDomain PromiseErrorDomain;
 - (void)reject: (NSError*)error;
 
 
+#pragma mark - Cancelling
+
+// Created on first access; cancelling it rejects this Promise with PromiseErrorCancelled
+@property (nonatomic, readonly) CancellationToken *cancellationToken;
+
+@property (atomic, readonly) BOOL cancelled;
+
+// Cancels the cancellationToken, if this Promise is not yet complete
+- (void)cancel;
+
+
 #pragma mark - Adding a callback to be notified on completion (this may be called many times, including after complete)
 
 - (void)onCompletion: (void (^)(Promise*))completionCallback;
+- (void)onCompletionFunction: (PromiseContinuation)function context: (void*)context;
+
+
+#pragma mark - Tracing (see PromiseTracer; these are only set while tracing is enabled)
+
+// Names the Promise in the trace (defaults to the class name)
+@property (atomic, copy) NSString *traceName;
+
+// 0 if the Promise was created while tracing was disabled
+@property (nonatomic, readonly) uint64_t traceId;
+
+// The Promise whose setup or callback created this one (0 if none)
+@property (nonatomic, readonly) uint64_t parentTraceId;
 
 @end
 
@@ -174,6 +250,9 @@ extern NSErrorDomain PromiseErrorDomain;
 
 @property (atomic, readonly) float value;
 
+// Resolves without boxing the value (result boxes it on demand)
+- (void)resolveFloat: (float)value;
+
 - (void)onCompletion: (void (^)(FloatPromise*))completionCallback;
 
 @end
@@ -198,6 +277,9 @@ extern NSErrorDomain PromiseErrorDomain;
 
 @property (atomic, readonly) NSInteger value;
 
+// Resolves without boxing the value (result boxes it on demand)
+- (void)resolveInteger: (NSInteger)value;
+
 - (void)onCompletion: (void (^)(IntegerPromise*))completionCallback;
 
 @end
@@ -250,3 +332,24 @@ extern NSErrorDomain PromiseErrorDomain;
 
 @end
 
+
+#pragma mark -
+#pragma mark - TypedPromise
+
+/**
+ *  A Promise typed with lightweight generics (e.g. TypedPromise<Hash*>), instead of needing
+ *  a dedicated subclass per value type. If a valueClass is given, resolve: also checks it at
+ *  runtime; with nil, no check is made at all.
+ */
+
+@interface TypedPromise<__covariant ValueType> : Promise
+
++ (instancetype)promiseWithValueClass: (Class)valueClass setup: (void (^)(TypedPromise<ValueType>*))setupCallback;
+- (instancetype)initWithValueClass: (Class)valueClass setup: (void (^)(TypedPromise<ValueType>*))setupCallback;
+
+// nil if resolved with nil (or not resolved)
+@property (atomic, readonly) ValueType value;
+
+- (void)onCompletion: (void (^)(TypedPromise<ValueType>*))completionCallback;
+
+@end
@@ -24,14 +24,130 @@
  */
 
 #import "Promise.h"
+#import "PromiseTracer.h"
+
+#include <stdatomic.h>
 
 
 NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 
 
+#pragma mark -
+#pragma mark - CancellationToken
+
+@implementation CancellationToken {
+    NSMutableArray<void (^)(void)> *_cancelCallbacks;
+}
+
++ (instancetype)cancellationToken {
+    return [[CancellationToken alloc] init];
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _cancelCallbacks = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)cancel {
+    NSArray<void (^)(void)> *cancelCallbacks = nil;
+    
+    // Cancelling is rare, so a lock here is fine; callbacks are called outside it
+    @synchronized (self) {
+        if (_cancelled) { return; }
+        _cancelled = YES;
+        cancelCallbacks = _cancelCallbacks;
+        _cancelCallbacks = nil;
+    }
+    
+    for (void (^cancelCallback)(void) in cancelCallbacks) {
+        cancelCallback();
+    }
+}
+
+- (void)onCancel: (void (^)(void))cancelCallback {
+    @synchronized (self) {
+        if (!_cancelled) {
+            [_cancelCallbacks addObject:[cancelCallback copy]];
+            return;
+        }
+    }
+    
+    cancelCallback();
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - Promise
+
+typedef enum PromiseState {
+    PromiseStatePending = 0,
+    PromiseStateCompleting,
+    PromiseStateComplete
+} PromiseState;
+
+// A node in the lock-free stack of callbacks waiting for completion; either a block,
+// retained (via CFBridgingRetain) for as long as it is on the stack, or a C function
+typedef struct PromiseCallback {
+    struct PromiseCallback *next;
+    const void *callback;
+    PromiseContinuation function;
+    void *context;
+} PromiseCallback;
+
+// Once a Promise completes its callback stack is swapped for this marker, so callbacks
+// added afterwards are dispatched immediately
+#define CallbacksClosed          ((PromiseCallback*)(uintptr_t)1)
+
+// Stands in for the result of a Promise resolved with an unboxed scalar
+static NSObject *UnboxedResult = nil;
+
+
+// The queue is retained while it is the default, and never released once replaced, since
+// another thread may have just read it (in practice this is set once at start-up)
+static _Atomic(void*) DefaultCallbackQueue = NULL;
+
+
+@interface Promise (private)
+
+- (BOOL)_beginCompletion;
+- (void)_finishWithResult: (NSObject*)result error: (NSError*)error;
+
+@end
+
+
 @implementation Promise {
-    NSMutableArray<void (^)(Promise*)> *_completionCallbacks;
+    atomic_int _state;
+    _Atomic(PromiseCallback*) _callbacks;
+    
+    // Written exactly once, before the state becomes PromiseStateComplete
+    NSObject *_result;
+    NSError *_error;
+    
     Promise *_keepAlive;
+    
+    // Created on demand (retained via CFBridgingRetain)
+    _Atomic(void*) _cancellationToken;
+    
+    // Most promises only ever have one callback, so the first lives inline (no allocation)
+    PromiseCallback _inlineCallback;
+    atomic_flag _inlineCallbackUsed;
+    
+    // Only set while tracing
+    uint64_t _createdAt;
+    NSString *_traceName;
+}
+
++ (void)initialize {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        atomic_store(&DefaultCallbackQueue, (__bridge void*)dispatch_get_main_queue());
+        UnboxedResult = [[NSObject alloc] init];
+    });
 }
 
 + (instancetype)promiseWithSetup:(void (^)(Promise *))setupCallback {
@@ -43,38 +159,202 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
     
     self = [super init];
     if (self) {
-        _completionCallbacks = [NSMutableArray array];
-        setupCallback(self);
+        _callbackQueue = [Promise defaultCallbackQueue];
         
+        // Keep ourselves alive until complete (which may even happen during setup)
         _keepAlive = self;
+        
+        if (PromiseTracingEnabled()) {
+            _createdAt = PromiseTraceNow();
+            _traceId = PromiseTraceCreated(&_parentTraceId);
+        }
+        
+        if (_traceId) {
+            
+            // Promises created during setup are our children
+            uint64_t previousTraceId = PromiseTraceSetCurrent(_traceId);
+            setupCallback(self);
+            PromiseTraceSetCurrent(previousTraceId);
+
+        } else {
+            setupCallback(self);
+        }
     }
     
     return self;
 }
 
-- (void)executeCompleteion {
+- (void)dealloc {
+    void *cancellationToken = atomic_load(&_cancellationToken);
+    if (cancellationToken) { CFRelease(cancellationToken); }
+    
+    PromiseCallback *callbacks = atomic_load(&_callbacks);
+    while (callbacks && callbacks != CallbacksClosed) {
+        PromiseCallback *next = callbacks->next;
+        [self _freeCallback:callbacks];
+        callbacks = next;
+    }
+}
+
+
+#pragma mark - Callback Queues
+
++ (dispatch_queue_t)defaultCallbackQueue {
+    return (__bridge dispatch_queue_t)atomic_load(&DefaultCallbackQueue);
+}
+
++ (void)setDefaultCallbackQueue: (dispatch_queue_t)callbackQueue {
+    atomic_store(&DefaultCallbackQueue, (void*)CFBridgingRetain(callbackQueue));
+}
+
+- (NSString*)traceName {
+    @synchronized (self) {
+        if (!_traceName) { return NSStringFromClass([self class]); }
+        return _traceName;
+    }
+}
+
+- (void)setTraceName: (NSString*)traceName {
+    @synchronized (self) {
+        _traceName = [traceName copy];
+    }
+}
+
+// Records when the callback is dispatched, how long it waits on its queue and how long it
+// runs; Promises it creates are our children
+- (void (^)(Promise*))_tracedCallback: (void (^)(Promise*))callback {
+    uint64_t traceId = _traceId, dispatchedAt = PromiseTraceNow();
+    NSString *name = [@"callback: " stringByAppendingString:self.traceName];
+    
+    return ^(Promise *promise) {
+        uint64_t startedAt = PromiseTraceNow();
+        uint64_t previousTraceId = PromiseTraceSetCurrent(traceId);
+        callback(promise);
+        PromiseTraceSetCurrent(previousTraceId);
+        PromiseTraceCallback(traceId, name, dispatchedAt, startedAt);
+    };
+}
 
-    // This must be called from a synchronized block
-    for (void (^callback)(Promise*) in _completionCallbacks) {
-        dispatch_async(dispatch_get_main_queue(), ^() {
-                callback(self);
+- (void)_dispatchCallback: (void (^)(Promise*))callback {
+    if (_traceId) { callback = [self _tracedCallback:callback]; }
+    
+    dispatch_queue_t callbackQueue = self.callbackQueue;
+    if (callbackQueue) {
+        dispatch_async(callbackQueue, ^() {
+            callback(self);
         });
+    } else {
+        callback(self);
+    }
+}
+
+- (void)_dispatchFunction: (PromiseContinuation)function context: (void*)context {
+    if (_traceId) {
+        [self _dispatchCallback:^(Promise *promise) { function(promise, context); }];
+        return;
     }
     
-    _completionCallbacks = nil;
+    dispatch_queue_t callbackQueue = self.callbackQueue;
+    if (callbackQueue) {
+        dispatch_async(callbackQueue, ^() {
+            function(self, context);
+        });
+    } else {
+        function(self, context);
+    }
+}
+
+- (PromiseCallback*)_allocateCallback {
+    if (!atomic_flag_test_and_set(&_inlineCallbackUsed)) { return &_inlineCallback; }
+    return malloc(sizeof(PromiseCallback));
+}
+
+- (void)_freeCallback: (PromiseCallback*)callback {
+    if (callback->callback) { CFRelease(callback->callback); }
+    if (callback != &_inlineCallback) { free(callback); }
+}
+
+// Returns NO (leaving the callback to the caller) if the Promise has already completed
+- (BOOL)_pushCallback: (PromiseCallback*)node {
+    PromiseCallback *head = atomic_load_explicit(&_callbacks, memory_order_acquire);
+    while (head != CallbacksClosed) {
+        node->next = head;
+        if (atomic_compare_exchange_weak_explicit(&_callbacks, &head, node, memory_order_acq_rel, memory_order_acquire)) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+
+#pragma mark - State
+
+- (BOOL)complete {
+    return (atomic_load_explicit(&_state, memory_order_acquire) == PromiseStateComplete);
+}
+
+- (NSObject*)result {
+    if (!self.complete) { return nil; }
+    return _result;
+}
+
+- (NSError*)error {
+    if (!self.complete) { return nil; }
+    return _error;
+}
+
+// Claims the right to complete; only the first caller gets YES, and must then call _finishWithResult:error:
+- (BOOL)_beginCompletion {
+    int state = PromiseStatePending;
+    return atomic_compare_exchange_strong(&_state, &state, PromiseStateCompleting);
+}
 
+- (void)_finishWithResult: (NSObject*)result error: (NSError*)error {
+    
+    // Hold a reference until we are done, since releasing _keepAlive may be the last one
+    __attribute__((objc_precise_lifetime)) Promise *keepAlive = _keepAlive;
     _keepAlive = nil;
+    
+    _result = result;
+    _error = error;
+    atomic_store_explicit(&_state, PromiseStateComplete, memory_order_release);
+    
+    if (_traceId) {
+        PromiseTraceCompleted(_traceId, _parentTraceId, self.traceName, _createdAt, (error != nil));
+    }
+    
+    // Close the stack, and reverse it so callbacks are called in the order they were added
+    PromiseCallback *callbacks = atomic_exchange_explicit(&_callbacks, CallbacksClosed, memory_order_acq_rel);
+    PromiseCallback *ordered = NULL;
+    while (callbacks) {
+        PromiseCallback *next = callbacks->next;
+        callbacks->next = ordered;
+        ordered = callbacks;
+        callbacks = next;
+    }
+    
+    while (ordered) {
+        PromiseCallback *next = ordered->next;
+        if (ordered->callback) {
+            void (^callback)(Promise*) = CFBridgingRelease(ordered->callback);
+            ordered->callback = NULL;
+            [self _dispatchCallback:callback];
+        } else {
+            [self _dispatchFunction:ordered->function context:ordered->context];
+        }
+        [self _freeCallback:ordered];
+        ordered = next;
+    }
+}
+
+- (void)_completeWithResult: (NSObject*)result error: (NSError*)error {
+    if (![self _beginCompletion]) { return; }
+    [self _finishWithResult:result error:error];
 }
 
 - (void)resolve: (NSObject*)result {
     if (!result) { result = [NSNull null]; }
-    
-    @synchronized (self) {
-        if (_complete) { return; }
-        _complete = YES;
-        _result = result;
-        [self executeCompleteion];
-    }
+    [self _completeWithResult:result error:nil];
 }
 
 - (void)reject: (NSError*)error {
@@ -82,26 +362,180 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 
     //NSLog(@"Rej: %@", error);
     
-    @synchronized (self) {
-        if (_complete) { return; }
-        _complete = YES;
-        _error = error;
-        [self executeCompleteion];
-    }
+    [self _completeWithResult:nil error:error];
 }
 
 - (void)onCompletion: (void (^)(Promise*))completionCallback {
-    @synchronized (self) {
-        if (_complete) {
-            dispatch_async(dispatch_get_main_queue(), ^() {
-                completionCallback(self);
-            });
-        } else {
-            [_completionCallbacks addObject:[completionCallback copy]];
-        }
+    PromiseCallback *node = [self _allocateCallback];
+    node->callback = CFBridgingRetain([completionCallback copy]);
+    if ([self _pushCallback:node]) { return; }
+    
+    // Already complete
+    [self _freeCallback:node];
+    [self _dispatchCallback:completionCallback];
+}
+
+- (void)onCompletionFunction: (PromiseContinuation)function context: (void*)context {
+    PromiseCallback *node = [self _allocateCallback];
+    node->callback = NULL;
+    node->function = function;
+    node->context = context;
+    if ([self _pushCallback:node]) { return; }
+    
+    // Already complete
+    [self _freeCallback:node];
+    [self _dispatchFunction:function context:context];
+}
+
+
+#pragma mark - Cancelling
+
+- (CancellationToken*)cancellationToken {
+    void *existing = atomic_load(&_cancellationToken);
+    if (existing) { return (__bridge CancellationToken*)existing; }
+    
+    CancellationToken *cancellationToken = [CancellationToken cancellationToken];
+    void *retained = (void*)CFBridgingRetain(cancellationToken);
+    if (!atomic_compare_exchange_strong(&_cancellationToken, &existing, retained)) {
+        
+        // Another thread beat us to it
+        CFRelease(retained);
+        return (__bridge CancellationToken*)existing;
     }
+    
+    __weak Promise *weakSelf = self;
+    [cancellationToken onCancel:^() {
+        [weakSelf reject:[NSError errorWithDomain:PromiseErrorDomain code:PromiseErrorCancelled userInfo:@{}]];
+    }];
+    
+    return cancellationToken;
+}
+
+- (BOOL)cancelled {
+    void *cancellationToken = atomic_load(&_cancellationToken);
+    return (cancellationToken && ((__bridge CancellationToken*)cancellationToken).cancelled);
+}
+
+- (void)cancel {
+    if (self.complete) { return; }
+    [self.cancellationToken cancel];
+}
+
+
+#pragma mark - Combining Promises
+
+// Completes promise with the same outcome as the (completed) source
+static void settleWith(Promise *promise, Promise *source) {
+    if (source.error) {
+        [promise reject:source.error];
+    } else {
+        NSObject *result = source.result;
+        [promise resolve:([result isEqual:[NSNull null]] ? nil: result)];
+    }
+}
+
+static void cancelAll(NSArray<Promise*> *promises) {
+    for (Promise *promise in promises) { [promise cancel]; }
+}
+
++ (ArrayPromise*)allSettled: (NSArray<Promise*>*)promises {
+    promises = [promises copy];
+    
+    return [ArrayPromise promiseWithSetup:^(Promise *promise) {
+        if (promises.count == 0) {
+            [promise resolve:@[]];
+            return;
+        }
+        
+        __block NSUInteger remainingPromises = promises.count;
+        for (Promise *childPromise in promises) {
+            [childPromise onCompletion:^(Promise *childPromise) {
+                BOOL done = NO;
+                @synchronized (promises) {
+                    remainingPromises--;
+                    done = (remainingPromises == 0);
+                }
+                if (done) { [promise resolve:promises]; }
+            }];
+        }
+        
+        [promise.cancellationToken onCancel:^() { cancelAll(promises); }];
+    }];
+}
+
++ (instancetype)race: (NSArray<Promise*>*)promises {
+    promises = [promises copy];
+    
+    return [[self alloc] initWithSetup:^(Promise *promise) {
+        for (Promise *childPromise in promises) {
+            [childPromise onCompletion:^(Promise *childPromise) {
+                if (promise.complete) { return; }
+                settleWith(promise, childPromise);
+                cancelAll(promises);
+            }];
+        }
+        
+        [promise.cancellationToken onCancel:^() { cancelAll(promises); }];
+    }];
+}
+
++ (instancetype)any: (NSArray<Promise*>*)promises {
+    promises = [promises copy];
+    
+    return [[self alloc] initWithSetup:^(Promise *promise) {
+        if (promises.count == 0) {
+            [promise reject:[NSError errorWithDomain:PromiseErrorDomain code:PromiseErrorAllRejected userInfo:@{@"errors": @[]}]];
+            return;
+        }
+        
+        __block NSUInteger remainingPromises = promises.count;
+        for (Promise *childPromise in promises) {
+            [childPromise onCompletion:^(Promise *childPromise) {
+                if (promise.complete) { return; }
+                
+                if (!childPromise.error) {
+                    settleWith(promise, childPromise);
+                    cancelAll(promises);
+                    return;
+                }
+                
+                BOOL done = NO;
+                @synchronized (promises) {
+                    remainingPromises--;
+                    done = (remainingPromises == 0);
+                }
+                
+                if (done) {
+                    NSArray *errors = [promises valueForKey:@"error"];
+                    [promise reject:[NSError errorWithDomain:PromiseErrorDomain code:PromiseErrorAllRejected userInfo:@{@"errors": errors}]];
+                }
+            }];
+        }
+        
+        [promise.cancellationToken onCancel:^() { cancelAll(promises); }];
+    }];
 }
 
+- (instancetype)timeout: (NSTimeInterval)timeout {
+    Promise *source = self;
+    
+    return [[[self class] alloc] initWithSetup:^(Promise *promise) {
+        [source onCompletion:^(Promise *source) {
+            settleWith(promise, source);
+        }];
+        
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)),
+                       dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^() {
+            if (promise.complete) { return; }
+            [promise reject:[NSError errorWithDomain:PromiseErrorDomain code:PromiseErrorTimeout userInfo:@{@"timeout": @(timeout)}]];
+            [source cancel];
+        });
+        
+        [promise.cancellationToken onCancel:^() { [source cancel]; }];
+    }];
+}
+
+
 + (ArrayPromise*)all: (NSArray<Promise*>*)promises {
     promises = [promises copy];
     
@@ -112,6 +546,12 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
             [result addObject:[NSNull null]];
         }
 
+        if (promises.count == 0) {
+            [promise resolve:result];
+            return;
+        }
+        
+        // Children may complete concurrently, depending on their callback queues
         __block NSUInteger remainingPromises = promises.count;
         
         for (NSInteger i = 0; i < promises.count; i++) {
@@ -120,16 +560,17 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
                 // Already handled
                 if (promise.complete) { return; }
                 
-                remainingPromises--;
-                
                 if (childPromise.error) {
                     [promise reject:childPromise.error];
                     
                 } else {
-                    [result replaceObjectAtIndex:i withObject:childPromise.result];
-                    if (remainingPromises == 0) {
-                        [promise resolve:result];
+                    BOOL done = NO;
+                    @synchronized (result) {
+                        [result replaceObjectAtIndex:i withObject:childPromise.result];
+                        remainingPromises--;
+                        done = (remainingPromises == 0);
                     }
+                    if (done) { [promise resolve:[result copy]]; }
                 }
             }];
         }
@@ -149,10 +590,13 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 + (Promise*)timer: (NSTimeInterval)timeout {
+    
+    // Does not depend on a run loop, so this also works off the main thread
     return [Promise promiseWithSetup:^(Promise *promise) {
-        [NSTimer scheduledTimerWithTimeInterval:5.0f repeats:NO block:^(NSTimer *timer) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)),
+                       dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^() {
             [promise resolve:nil];
-        }];
+        });
     }];
 }
 
@@ -161,12 +605,10 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
     NSObject *result = nil;
     NSError *error = nil;
     
-    @synchronized (self) {
-        if (_complete) {
-            state = (self.result ? @"RESOLVED": @"REJECTED");
-        }
-        result = _result;
-        error = _error;
+    if (self.complete) {
+        result = self.result;
+        error = self.error;
+        state = (result ? @"RESOLVED": @"REJECTED");
     }
     
     return [NSString stringWithFormat:@"<%@ state=%@ result=%@ error=%@>", NSStringFromClass([self class]), state, result, error];
@@ -192,9 +634,7 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(ArrayPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((ArrayPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
@@ -217,9 +657,7 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(BigNumberPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((BigNumberPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
@@ -243,9 +681,7 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(BlockInfoPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((BlockInfoPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
@@ -268,9 +704,7 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(DataPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((DataPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
@@ -293,22 +727,35 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(DictionaryPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((DictionaryPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
 
 
-@implementation FloatPromise
+@implementation FloatPromise {
+    float _floatValue;
+}
 
 - (float)value {
     NSNumber *value = (NSNumber*)(super.result);
+    if (value == UnboxedResult) { return _floatValue; }
     if ([[NSNull null] isEqual:value]) { return 0.0f; }
     return [value floatValue];
 }
 
+- (NSObject*)result {
+    NSObject *result = [super result];
+    if (result == UnboxedResult) { return [NSNumber numberWithFloat:_floatValue]; }
+    return result;
+}
+
+- (void)resolveFloat: (float)value {
+    if (![self _beginCompletion]) { return; }
+    _floatValue = value;
+    [self _finishWithResult:UnboxedResult error:nil];
+}
+
 - (void)resolve:(NSObject *)result {
     if (result && ![result isKindOfClass:[NSNumber class]]) {
         [super reject:[NSError errorWithDomain:PromiseErrorDomain code:0 userInfo:@{@"reason": @"invalid value", @"value": result}]];
@@ -318,9 +765,7 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(FloatPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((FloatPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
@@ -343,22 +788,35 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(HashPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((HashPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
 
 
-@implementation IntegerPromise
+@implementation IntegerPromise {
+    NSInteger _integerValue;
+}
 
 - (NSInteger)value {
     NSNumber *value = (NSNumber*)(super.result);
+    if (value == UnboxedResult) { return _integerValue; }
     if ([[NSNull null] isEqual:value]) { return 0; }
     return [value integerValue];
 }
 
+- (NSObject*)result {
+    NSObject *result = [super result];
+    if (result == UnboxedResult) { return [NSNumber numberWithInteger:_integerValue]; }
+    return result;
+}
+
+- (void)resolveInteger: (NSInteger)value {
+    if (![self _beginCompletion]) { return; }
+    _integerValue = value;
+    [self _finishWithResult:UnboxedResult error:nil];
+}
+
 - (void)resolve:(NSObject *)result {
     if (result && ![result isKindOfClass:[NSNumber class]]) {
         [super reject:[NSError errorWithDomain:PromiseErrorDomain code:0 userInfo:@{@"reason": @"invalid value", @"value": result}]];
@@ -368,9 +826,7 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(IntegerPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((IntegerPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
@@ -393,9 +849,7 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(NumberPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((NumberPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
@@ -418,9 +872,7 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(StringPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((StringPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
@@ -443,9 +895,7 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(TransactionInfoPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((TransactionInfoPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
@@ -468,9 +918,43 @@ NSErrorDomain PromiseErrorDomain = @"PromiseErrorDomain";
 }
 
 - (void)onCompletion: (void (^)(AddressPromise*))completionCallback {
-    return [super onCompletion:^(Promise *promise) {
-        completionCallback((AddressPromise*)self);
-    }];
+    [super onCompletion:(void (^)(Promise*))completionCallback];
+}
+
+@end
+
+
+@implementation TypedPromise {
+    Class _valueClass;
+}
+
++ (instancetype)promiseWithValueClass: (Class)valueClass setup: (void (^)(TypedPromise*))setupCallback {
+    return [[self alloc] initWithValueClass:valueClass setup:setupCallback];
+}
+
+- (instancetype)initWithValueClass: (Class)valueClass setup: (void (^)(TypedPromise*))setupCallback {
+    
+    // The setup runs during initWithSetup:, so this must be in place beforehand
+    _valueClass = valueClass;
+    return [super initWithSetup:(void (^)(Promise*))setupCallback];
+}
+
+- (id)value {
+    NSObject *value = self.result;
+    if (value == [NSNull null]) { value = nil; }
+    return value;
+}
+
+- (void)resolve: (NSObject*)result {
+    if (_valueClass && result && ![result isKindOfClass:_valueClass]) {
+        [super reject:[NSError errorWithDomain:PromiseErrorDomain code:0 userInfo:@{@"reason": @"invalid value", @"value": result}]];
+        return;
+    }
+    [super resolve:result];
+}
+
+- (void)onCompletion: (void (^)(TypedPromise*))completionCallback {
+    [super onCompletion:(void (^)(Promise*))completionCallback];
 }
 
 @end
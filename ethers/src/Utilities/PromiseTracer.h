@@ -0,0 +1,96 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ *  PromiseTracer
+ *
+ *  Opt-in instrumentation for Promise chains. While enabled, every Promise records when
+ *  it was created and completed, which Promise's setup or callback created it (its parent)
+ *  and, for each callback, when it was dispatched and how long it waited for and ran on
+ *  its queue. Other components (e.g. ApiProvider) may add their own intervals, attributed
+ *  to the Promise currently running.
+ *
+ *  The trace can be exported as Chrome trace-event JSON (chrome://tracing or Perfetto).
+ *
+ *  When disabled (the default), the only cost to a Promise is a single atomic load.
+ */
+
+#import <Foundation/Foundation.h>
+
+
+@interface PromiseTracer : NSObject
+
++ (instancetype)sharedTracer;
+
+@property (atomic, assign, getter=isEnabled) BOOL enabled;
+
+// Events beyond this are dropped (default: 100,000)
+@property (atomic, assign) NSUInteger maximumEventCount;
+
+// The trace id of the Promise whose setup or callback is running on this thread (0 if none)
++ (uint64_t)currentTraceId;
+
+
+#pragma mark - Recording
+
+// Records an interval (e.g. a DNS lookup), attributed to the Promise with traceId
+- (void)recordIntervalWithName: (NSString*)name
+                      category: (NSString*)category
+                         start: (NSDate*)start
+                           end: (NSDate*)end
+                       traceId: (uint64_t)traceId;
+
+
+#pragma mark - Exporting
+
+@property (atomic, readonly) NSArray<NSDictionary*> *events;
+
+// {"traceEvents": [ ... ], "displayTimeUnit": "ms"}
+- (NSData*)chromeTraceJSON;
+
+- (void)removeAllEvents;
+
+@end
+
+
+#pragma mark -
+#pragma mark - Promise hooks
+
+// Used by Promise; only call these while PromiseTracingEnabled() is true
+
+BOOL PromiseTracingEnabled(void);
+
+// Monotonic nanoseconds
+uint64_t PromiseTraceNow(void);
+
+// Returns a new trace id, and the trace id of the Promise running on this thread as the parent
+uint64_t PromiseTraceCreated(uint64_t *parentTraceId);
+
+void PromiseTraceCompleted(uint64_t traceId, uint64_t parentTraceId, NSString *name, uint64_t createdAt, BOOL rejected);
+
+void PromiseTraceCallback(uint64_t traceId, NSString *name, uint64_t dispatchedAt, uint64_t startedAt);
+
+// Sets the trace id of the Promise running on this thread, returning the previous one
+uint64_t PromiseTraceSetCurrent(uint64_t traceId);
@@ -0,0 +1,252 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import "PromiseTracer.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+
+#define DefaultMaximumEventCount         100000
+
+static atomic_bool TracingEnabled = false;
+static atomic_ullong NextTraceId = 1;
+
+static __thread uint64_t CurrentTraceId = 0;
+
+// Exported timestamps are microseconds since the tracer was first used
+static uint64_t TraceEpoch = 0;
+
+
+BOOL PromiseTracingEnabled() {
+    return atomic_load_explicit(&TracingEnabled, memory_order_relaxed);
+}
+
+uint64_t PromiseTraceNow() {
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+}
+
+uint64_t PromiseTraceSetCurrent(uint64_t traceId) {
+    uint64_t previous = CurrentTraceId;
+    CurrentTraceId = traceId;
+    return previous;
+}
+
+static uint64_t timestampForDate(NSDate *date) {
+    return PromiseTraceNow() + (int64_t)([date timeIntervalSinceNow] * 1000000000.0);
+}
+
+static NSNumber *microseconds(uint64_t timestamp) {
+    return @((double)((int64_t)(timestamp - TraceEpoch)) / 1000.0);
+}
+
+static NSNumber *threadId() {
+    uint64_t threadId = 0;
+    pthread_threadid_np(NULL, &threadId);
+    return @(threadId);
+}
+
+static NSString *traceIdString(uint64_t traceId) {
+    return [NSString stringWithFormat:@"0x%llx", traceId];
+}
+
+
+@implementation PromiseTracer {
+    NSMutableArray<NSDictionary*> *_events;
+    NSNumber *_processId;
+}
+
++ (void)initialize {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        TraceEpoch = PromiseTraceNow();
+    });
+}
+
++ (instancetype)sharedTracer {
+    static PromiseTracer *sharedTracer = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedTracer = [[PromiseTracer alloc] init];
+    });
+    return sharedTracer;
+}
+
++ (uint64_t)currentTraceId {
+    return CurrentTraceId;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _events = [NSMutableArray array];
+        _processId = @(getpid());
+        _maximumEventCount = DefaultMaximumEventCount;
+    }
+    return self;
+}
+
+- (BOOL)isEnabled {
+    return PromiseTracingEnabled();
+}
+
+- (void)setEnabled: (BOOL)enabled {
+    atomic_store(&TracingEnabled, enabled);
+}
+
+
+#pragma mark - Recording
+
+- (void)_addEvent: (NSDictionary*)event {
+    NSUInteger maximumEventCount = self.maximumEventCount;
+    @synchronized (_events) {
+        if (_events.count >= maximumEventCount) { return; }
+        [_events addObject:event];
+    }
+}
+
+- (void)_addCompleteEventWithName: (NSString*)name
+                         category: (NSString*)category
+                            start: (uint64_t)start
+                              end: (uint64_t)end
+                         threadId: (NSNumber*)threadId
+                             args: (NSDictionary*)args {
+    [self _addEvent:@{
+                      @"name": name,
+                      @"cat": category,
+                      @"ph": @"X",
+                      @"ts": microseconds(start),
+                      @"dur": @((double)(end - start) / 1000.0),
+                      @"pid": _processId,
+                      @"tid": threadId,
+                      @"args": args,
+                      }];
+}
+
+- (void)recordIntervalWithName: (NSString*)name
+                      category: (NSString*)category
+                         start: (NSDate*)start
+                           end: (NSDate*)end
+                       traceId: (uint64_t)traceId {
+    if (!start || !end || !PromiseTracingEnabled()) { return; }
+    
+    uint64_t startTimestamp = timestampForDate(start), endTimestamp = timestampForDate(end);
+    if (endTimestamp < startTimestamp) { endTimestamp = startTimestamp; }
+    
+    // Intervals are not tied to a thread, so they share a track of their own
+    [self _addCompleteEventWithName:name
+                           category:category
+                              start:startTimestamp
+                                end:endTimestamp
+                           threadId:@(0)
+                               args:@{@"promise": traceIdString(traceId)}];
+}
+
+- (void)_recordPromise: (uint64_t)traceId
+                parent: (uint64_t)parentTraceId
+                  name: (NSString*)name
+             createdAt: (uint64_t)createdAt
+              rejected: (BOOL)rejected {
+    
+    // An async slice per Promise, since they overlap freely
+    NSString *identifier = traceIdString(traceId);
+    [self _addEvent:@{
+                      @"name": name,
+                      @"cat": @"promise",
+                      @"ph": @"b",
+                      @"id": identifier,
+                      @"ts": microseconds(createdAt),
+                      @"pid": _processId,
+                      @"tid": threadId(),
+                      @"args": @{@"parent": traceIdString(parentTraceId)},
+                      }];
+    [self _addEvent:@{
+                      @"name": name,
+                      @"cat": @"promise",
+                      @"ph": @"e",
+                      @"id": identifier,
+                      @"ts": microseconds(PromiseTraceNow()),
+                      @"pid": _processId,
+                      @"tid": threadId(),
+                      @"args": @{@"state": (rejected ? @"rejected": @"resolved")},
+                      }];
+}
+
+- (void)_recordCallback: (uint64_t)traceId
+                   name: (NSString*)name
+           dispatchedAt: (uint64_t)dispatchedAt
+              startedAt: (uint64_t)startedAt {
+    NSDictionary *args = @{
+                           @"promise": traceIdString(traceId),
+                           @"queueDelayUs": @((double)(startedAt - dispatchedAt) / 1000.0),
+                           };
+    [self _addCompleteEventWithName:name
+                           category:@"callback"
+                              start:startedAt
+                                end:PromiseTraceNow()
+                           threadId:threadId()
+                               args:args];
+}
+
+
+#pragma mark - Exporting
+
+- (NSArray<NSDictionary*>*)events {
+    @synchronized (_events) {
+        return [_events copy];
+    }
+}
+
+- (NSData*)chromeTraceJSON {
+    NSDictionary *trace = @{@"traceEvents": self.events, @"displayTimeUnit": @"ms"};
+    return [NSJSONSerialization dataWithJSONObject:trace options:0 error:nil];
+}
+
+- (void)removeAllEvents {
+    @synchronized (_events) {
+        [_events removeAllObjects];
+    }
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - Promise hooks
+
+uint64_t PromiseTraceCreated(uint64_t *parentTraceId) {
+    *parentTraceId = CurrentTraceId;
+    return atomic_fetch_add_explicit(&NextTraceId, 1, memory_order_relaxed);
+}
+
+void PromiseTraceCompleted(uint64_t traceId, uint64_t parentTraceId, NSString *name, uint64_t createdAt, BOOL rejected) {
+    [[PromiseTracer sharedTracer] _recordPromise:traceId parent:parentTraceId name:name createdAt:createdAt rejected:rejected];
+}
+
+void PromiseTraceCallback(uint64_t traceId, NSString *name, uint64_t dispatchedAt, uint64_t startedAt) {
+    [[PromiseTracer sharedTracer] _recordCallback:traceId name:name dispatchedAt:dispatchedAt startedAt:startedAt];
+}
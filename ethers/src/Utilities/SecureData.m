@@ -28,10 +28,116 @@
 
 #import <CommonCrypto/CommonCrypto.h>
 
+#include <errno.h>
+#include <os/lock.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include "ccMemory.h"
 #include "sha3.h"
 
-#import "RegEx.h"
+#pragma mark - Secure Arena
+
+// Small SecureData buffers (most key material, digests and seeds) come from a dedicated pool
+// of pages, which are locked into memory (so they are never written to swap) and are
+// surrounded by inaccessible guard pages. Each size class hands out fixed-size slots
+// from a free list; a slot is zeroed as soon as it is released.
+//
+// Anything larger, or anything that does not fit once a pool is exhausted, falls back
+// onto the (zeroing) heap allocator below, which is also what everything else uses.
+
+#define SecureArenaClassCount       3
+#define SecureArenaBytesPerClass    (64 * 1024)
+
+static const size_t SecureArenaSlotSizes[SecureArenaClassCount] = { 32, 64, 128 };
+
+typedef struct SecureArenaPool {
+    uint8_t *start;
+    uint8_t *end;
+    size_t slotSize;
+    void *freeList;
+} SecureArenaPool;
+
+static SecureArenaPool SecureArenaPools[SecureArenaClassCount];
+static os_unfair_lock SecureArenaLock = OS_UNFAIR_LOCK_INIT;
+
+static void secureArenaInitialize(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        size_t pageSize = (size_t)getpagesize();
+        size_t poolSize = (SecureArenaBytesPerClass + pageSize - 1) / pageSize * pageSize;
+        
+        for (int i = 0; i < SecureArenaClassCount; i++) {
+            SecureArenaPool *pool = &SecureArenaPools[i];
+            pool->slotSize = SecureArenaSlotSizes[i];
+            
+            // Reserve the pool with a guard page on either side
+            uint8_t *region = mmap(NULL, poolSize + 2 * pageSize, PROT_NONE, MAP_PRIVATE | MAP_ANON, -1, 0);
+            if (region == MAP_FAILED) { continue; }
+            
+            uint8_t *start = region + pageSize;
+            if (mprotect(start, poolSize, PROT_READ | PROT_WRITE)) {
+                munmap(region, poolSize + 2 * pageSize);
+                continue;
+            }
+            
+            // If the lock limit is exceeded the pool is still usable; it is just pageable
+            if (mlock(start, poolSize)) {
+                NSLog(@"SecureData: Failed to lock secure arena pages (errno=%d)", errno);
+            }
+            
+            // Thread every slot onto the free list (in address order)
+            void **next = &pool->freeList;
+            for (uint8_t *slot = start; slot + pool->slotSize <= start + poolSize; slot += pool->slotSize) {
+                *next = slot;
+                next = (void**)slot;
+            }
+            *next = NULL;
+            
+            pool->start = start;
+            pool->end = start + poolSize;
+        }
+    });
+}
+
+// Returns a slot large enough for size bytes, or NULL if the arena cannot provide one
+static void *secureArenaAllocate(size_t size) {
+    for (int i = 0; i < SecureArenaClassCount; i++) {
+        SecureArenaPool *pool = &SecureArenaPools[i];
+        if (size > pool->slotSize) { continue; }
+        
+        os_unfair_lock_lock(&SecureArenaLock);
+        void *slot = pool->freeList;
+        if (slot) { pool->freeList = *(void**)slot; }
+        os_unfair_lock_unlock(&SecureArenaLock);
+        
+        if (slot) {
+            *(void**)slot = NULL;
+            return slot;
+        }
+    }
+    
+    return NULL;
+}
+
+// Returns the pool ptr was allocated from, or NULL if it came from the heap
+static SecureArenaPool *secureArenaPool(const void *ptr) {
+    for (int i = 0; i < SecureArenaClassCount; i++) {
+        SecureArenaPool *pool = &SecureArenaPools[i];
+        if ((const uint8_t*)ptr >= pool->start && (const uint8_t*)ptr < pool->end) { return pool; }
+    }
+    return NULL;
+}
+
+static void secureArenaDeallocate(SecureArenaPool *pool, void *ptr) {
+    CC_XZEROMEM(ptr, pool->slotSize);
+    
+    os_unfair_lock_lock(&SecureArenaLock);
+    *(void**)ptr = pool->freeList;
+    pool->freeList = ptr;
+    os_unfair_lock_unlock(&SecureArenaLock);
+}
+
 
 #pragma mark - Secure Allocator
 
@@ -91,6 +197,294 @@ CFAllocatorRef SecureAllocator() {
 }
 
 
+#pragma mark - Secure Arena Allocator
+
+// Only SecureData's own buffers (the key material) use the arena, so public data such as
+// hex strings never takes up its limited slots
+
+static void *secureArenaAllocatorAllocate(CFIndex allocSize, CFOptionFlags hint, void *info) {
+    secureArenaInitialize();
+    
+    void *slot = secureArenaAllocate(allocSize);
+    if (slot) { return slot; }
+    
+    return secureAllocate(allocSize, hint, info);
+}
+
+static void secureArenaAllocatorDeallocate(void *ptr, void *info) {
+    SecureArenaPool *pool = secureArenaPool(ptr);
+    if (pool) {
+        secureArenaDeallocate(pool, ptr);
+        return;
+    }
+    
+    secureDeallocate(ptr, info);
+}
+
+static void *secureArenaAllocatorReallocate(void *ptr, CFIndex newsize, CFOptionFlags hint, void *info) {
+    void *newptr = secureArenaAllocatorAllocate(newsize, hint, info);
+    
+    // Arena slots do not record the requested size, but the whole slot is safe to copy
+    SecureArenaPool *pool = secureArenaPool(ptr);
+    CFIndex size = pool ? (CFIndex)pool->slotSize: *((CFIndex *)ptr - 1);
+    
+    if (newptr && size) {
+        CC_XMEMCPY(newptr, ptr, (size < newsize) ? size : newsize);
+        secureArenaAllocatorDeallocate(ptr, info);
+    }
+    
+    return newptr;
+}
+
+// Small allocations come from the locked secure arena; everything is cleansed prior to deallocation.
+static CFAllocatorRef SecureArenaAllocator() {
+    
+    static CFAllocatorRef alloc = NULL;
+    static dispatch_once_t onceToken = 0;
+    
+    dispatch_once(&onceToken, ^{
+        CFAllocatorContext context;
+        
+        context.version = 0;
+        CFAllocatorGetContext(kCFAllocatorDefault, &context);
+        context.allocate = secureArenaAllocatorAllocate;
+        context.reallocate = secureArenaAllocatorReallocate;
+        context.deallocate = secureArenaAllocatorDeallocate;
+        
+        alloc = CFAllocatorCreate(kCFAllocatorDefault, &context);
+    });
+    
+    return alloc;
+}
+
+
+#pragma mark - Hex Codecs
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static const char HexLower[] = "0123456789abcdef";
+
+// Maps an ASCII character to its nibble value, or -1 if it is not a hex digit
+static int8_t HexNibbles[256];
+
+static void initHexNibbles(void) {
+    memset(HexNibbles, -1, sizeof(HexNibbles));
+    for (int i = 0; i < 10; i++) { HexNibbles['0' + i] = i; }
+    for (int i = 0; i < 6; i++) {
+        HexNibbles['a' + i] = 10 + i;
+        HexNibbles['A' + i] = 10 + i;
+    }
+}
+
+// Writes 2 * length lowercase hex characters (no prefix or terminator) to output
+static void hexEncode(const uint8_t *bytes, size_t length, char *output) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i lut = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+                                         '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    for (; i + 32 <= length; i += 32) {
+        __m256i value = _mm256_loadu_si256((const __m256i*)&bytes[i]);
+        __m256i high = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(value, 4), mask));
+        __m256i low = _mm256_shuffle_epi8(lut, _mm256_and_si256(value, mask));
+        
+        // Unpacking works within each 128-bit lane, so put the lanes back in order
+        __m256i first = _mm256_unpacklo_epi8(high, low), second = _mm256_unpackhi_epi8(high, low);
+        _mm256_storeu_si256((__m256i*)&output[2 * i], _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i*)&output[2 * i + 32], _mm256_permute2x128_si256(first, second, 0x31));
+    }
+#endif
+
+#if defined(__SSSE3__)
+    const __m128i lut128 = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i mask128 = _mm_set1_epi8(0x0f);
+    for (; i + 16 <= length; i += 16) {
+        __m128i value = _mm_loadu_si128((const __m128i*)&bytes[i]);
+        __m128i high = _mm_shuffle_epi8(lut128, _mm_and_si128(_mm_srli_epi16(value, 4), mask128));
+        __m128i low = _mm_shuffle_epi8(lut128, _mm_and_si128(value, mask128));
+        _mm_storeu_si128((__m128i*)&output[2 * i], _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i*)&output[2 * i + 16], _mm_unpackhi_epi8(high, low));
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t lut = vld1q_u8((const uint8_t*)HexLower);
+    const uint8x16_t mask = vdupq_n_u8(0x0f);
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t value = vld1q_u8(&bytes[i]);
+        uint8x16x2_t chars;
+        chars.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(value, 4));
+        chars.val[1] = vqtbl1q_u8(lut, vandq_u8(value, mask));
+        vst2q_u8((uint8_t*)&output[2 * i], chars);
+    }
+#endif
+
+    for (; i < length; i++) {
+        output[2 * i] = HexLower[bytes[i] >> 4];
+        output[2 * i + 1] = HexLower[bytes[i] & 0x0f];
+    }
+}
+
+#if defined(__SSSE3__)
+// Converts 16 hex characters to their nibble values, clearing *valid if any is not a hex digit
+static inline __m128i hexNibbles128(__m128i chars, __m128i *valid) {
+    __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)), _mm_cmplt_epi8(digit, _mm_set1_epi8(10)));
+    
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(letter, _mm_set1_epi8(-1)), _mm_cmplt_epi8(letter, _mm_set1_epi8(6)));
+    
+    *valid = _mm_and_si128(*valid, _mm_or_si128(isDigit, isLetter));
+    return _mm_or_si128(_mm_and_si128(isDigit, digit),
+                        _mm_and_si128(isLetter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+#endif
+
+#if defined(__AVX2__)
+static inline __m256i hexNibbles256(__m256i chars, __m256i *valid) {
+    __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+    __m256i isDigit = _mm256_andnot_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), digit),
+                                          _mm256_cmpgt_epi8(_mm256_set1_epi8(10), digit));
+    
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i isLetter = _mm256_andnot_si256(_mm256_cmpgt_epi8(_mm256_setzero_si256(), letter),
+                                           _mm256_cmpgt_epi8(_mm256_set1_epi8(6), letter));
+    
+    *valid = _mm256_and_si256(*valid, _mm256_or_si256(isDigit, isLetter));
+    return _mm256_or_si256(_mm256_and_si256(isDigit, digit),
+                           _mm256_and_si256(isLetter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+static inline uint8x16_t hexNibblesNeon(uint8x16_t chars, uint8x16_t *valid) {
+    uint8x16_t digit = vsubq_u8(chars, vdupq_n_u8('0'));
+    uint8x16_t isDigit = vcltq_u8(digit, vdupq_n_u8(10));
+    
+    uint8x16_t letter = vsubq_u8(vorrq_u8(chars, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    uint8x16_t isLetter = vcltq_u8(letter, vdupq_n_u8(6));
+    
+    *valid = vandq_u8(*valid, vorrq_u8(isDigit, isLetter));
+    return vorrq_u8(vandq_u8(isDigit, digit), vandq_u8(isLetter, vaddq_u8(letter, vdupq_n_u8(10))));
+}
+#endif
+
+// Reads 2 * length hex characters (either case, no prefix) into output, returning
+// false if any character is not a hex digit
+static bool hexDecode(const char *hex, size_t length, uint8_t *output) {
+    size_t i = 0;
+    
+#if defined(__AVX2__)
+    {
+        __m256i valid = _mm256_set1_epi8(-1);
+        const __m256i weights = _mm256_set1_epi16(0x0110);
+        for (; i + 32 <= length; i += 32) {
+            __m256i first = hexNibbles256(_mm256_loadu_si256((const __m256i*)&hex[2 * i]), &valid);
+            __m256i second = hexNibbles256(_mm256_loadu_si256((const __m256i*)&hex[2 * i + 32]), &valid);
+            
+            // (high * 16 + low) for each pair, then narrow back to bytes (fixing the lane order)
+            __m256i packed = _mm256_packus_epi16(_mm256_maddubs_epi16(first, weights), _mm256_maddubs_epi16(second, weights));
+            _mm256_storeu_si256((__m256i*)&output[i], _mm256_permute4x64_epi64(packed, 0xd8));
+        }
+        if (_mm256_movemask_epi8(valid) != -1) { return false; }
+    }
+#endif
+
+#if defined(__SSSE3__)
+    {
+        __m128i valid = _mm_set1_epi8(-1);
+        const __m128i weights = _mm_set1_epi16(0x0110);
+        for (; i + 16 <= length; i += 16) {
+            __m128i first = hexNibbles128(_mm_loadu_si128((const __m128i*)&hex[2 * i]), &valid);
+            __m128i second = hexNibbles128(_mm_loadu_si128((const __m128i*)&hex[2 * i + 16]), &valid);
+            __m128i packed = _mm_packus_epi16(_mm_maddubs_epi16(first, weights), _mm_maddubs_epi16(second, weights));
+            _mm_storeu_si128((__m128i*)&output[i], packed);
+        }
+        if (_mm_movemask_epi8(valid) != 0xffff) { return false; }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    {
+        uint8x16_t valid = vdupq_n_u8(0xff);
+        for (; i + 16 <= length; i += 16) {
+            uint8x16x2_t chars = vld2q_u8((const uint8_t*)&hex[2 * i]);
+            uint8x16_t high = hexNibblesNeon(chars.val[0], &valid);
+            uint8x16_t low = hexNibblesNeon(chars.val[1], &valid);
+            vst1q_u8(&output[i], vorrq_u8(vshlq_n_u8(high, 4), low));
+        }
+        if (vminvq_u8(valid) != 0xff) { return false; }
+    }
+#endif
+
+    for (; i < length; i++) {
+        int8_t high = HexNibbles[(uint8_t)hex[2 * i]], low = HexNibbles[(uint8_t)hex[2 * i + 1]];
+        if (high < 0 || low < 0) { return false; }
+        output[i] = (high << 4) | low;
+    }
+    
+    return true;
+}
+
+// Returns a new securely allocated hex string ("0x" prefixed) for the bytes
+static NSString *encodeHexString(const uint8_t *bytes, size_t length) {
+    CFIndex hexLength = 2 + 2 * length;
+    char *chars = CFAllocatorAllocate(SecureAllocator(), hexLength, 0);
+    if (!chars) { return nil; }
+    
+    chars[0] = '0';
+    chars[1] = 'x';
+    hexEncode(bytes, length, &chars[2]);
+    
+    // The string takes ownership of the buffer, and releases it with the secure allocator
+    CFStringRef string = CFStringCreateWithBytesNoCopy(SecureAllocator(), (const UInt8*)chars, hexLength,
+                                                       kCFStringEncodingASCII, false, SecureAllocator());
+    if (!string) { CFAllocatorDeallocate(SecureAllocator(), chars); }
+    
+    return CFBridgingRelease(string);
+}
+
+// Returns new data (from allocator) for a "0x" prefixed hex string, or nil if it is invalid
+static NSMutableData *decodeHexString(NSString *hexString, CFAllocatorRef allocator) {
+    if (![hexString isKindOfClass:[NSString class]]) { return nil; }
+    
+    CFStringRef string = (__bridge CFStringRef)hexString;
+    CFIndex length = CFStringGetLength(string);
+    if (length < 2 || (length % 2)) { return nil; }
+    
+    // Use the string's own storage if possible; otherwise copy out the characters (which
+    // also fails for any non-ASCII string)
+    char *buffer = NULL;
+    const char *chars = CFStringGetCStringPtr(string, kCFStringEncodingASCII);
+    if (!chars) {
+        buffer = CFAllocatorAllocate(SecureAllocator(), length, 0);
+        if (!buffer) { return nil; }
+        
+        CFIndex usedLength = 0;
+        CFIndex converted = CFStringGetBytes(string, CFRangeMake(0, length), kCFStringEncodingASCII, 0, false,
+                                             (UInt8*)buffer, length, &usedLength);
+        if (converted != length || usedLength != length) {
+            CFAllocatorDeallocate(SecureAllocator(), buffer);
+            return nil;
+        }
+        chars = buffer;
+    }
+    
+    NSMutableData *data = nil;
+    if (chars[0] == '0' && chars[1] == 'x') {
+        size_t dataLength = (length - 2) / 2;
+        data = CFBridgingRelease(CFDataCreateMutable(allocator, dataLength));
+        data.length = dataLength;
+        if (!hexDecode(&chars[2], dataLength, data.mutableBytes)) { data = nil; }
+    }
+    
+    if (buffer) { CFAllocatorDeallocate(SecureAllocator(), buffer); }
+    
+    return data;
+}
+
+
 #pragma mark - SecureData
 
 @interface SecureData () {
@@ -108,12 +502,10 @@ CFAllocatorRef SecureAllocator() {
 
 #pragma mark - Life Cycle
 
-static RegEx *RegExHex = nil;
-
 + (void)initialize {
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        RegExHex = [RegEx regExWithPattern:@"^0x([0-9A-Fa-f][0-9A-Fa-f])*$"];
+        initHexNibbles();
     });
 }
 
@@ -124,7 +516,7 @@ static RegEx *RegExHex = nil;
 - (instancetype)initWithCapacity: (NSUInteger)capacity {
     self = [super init];
     if (self) {
-        _secureData = CFBridgingRelease(CFDataCreateMutable(SecureAllocator(), capacity));
+        _secureData = CFBridgingRelease(CFDataCreateMutable(SecureArenaAllocator(), capacity));
     }
     return self;
 }
@@ -132,7 +524,7 @@ static RegEx *RegExHex = nil;
 - (instancetype)initWithData: (NSData*)data {
     self = [super init];
     if (self) {
-        _secureData = CFBridgingRelease(CFDataCreateMutableCopy(SecureAllocator(), 0, (__bridge CFDataRef)data));
+        _secureData = CFBridgingRelease(CFDataCreateMutableCopy(SecureArenaAllocator(), 0, (__bridge CFDataRef)data));
     }
     return self;
 }
@@ -153,48 +545,11 @@ static RegEx *RegExHex = nil;
 }
 
 + (instancetype)secureDataWithHexString:(NSString*)hexString {
+    NSMutableData *data = decodeHexString(hexString, SecureArenaAllocator());
+    if (!data) { return nil; }
     
-    // Make sure we are a valid hex string
-    if (![RegExHex matchesExactly:hexString]) { return nil; }
-    
-    SecureData *secureData = [SecureData secureDataWithCapacity:hexString.length / 2 - 1];
-
-    uint8_t b = 0;
-    unichar c;
-    
-    for (NSUInteger i = 2; i < hexString.length; i++) {
-        c = [hexString characterAtIndex:i];
-        
-        switch (c) {
-            case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
-                b += c - '0';
-                break;
-                
-            case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
-                b += c + 10 - 'A';
-                break;
-                
-            case 'a': case 'b': case 'c': case 'd': case 'e': case 'f':
-                b += c + 10 - 'a';
-                break;
-                
-            default:
-                // Cannot happen as we passed the above regular expression
-                NSLog(@"This should not happen!");
-                return nil;
-        }
-        
-        if (i % 2) {
-            [secureData.secureData appendBytes:&b length:1];
-            b = 0;
-        } else {
-            b <<= 4;
-        }
-    }
-
-    b = 0;
-    CC_XZEROMEM(&c, sizeof(c));
-
+    SecureData *secureData = [[self alloc] init];
+    secureData.secureData = data;
     return secureData;
 }
 
@@ -206,11 +561,13 @@ static RegEx *RegExHex = nil;
 #pragma mark - Convenience Functions
 
 + (NSData*)hexStringToData: (NSString*)hexString {
-    return [SecureData secureDataWithHexString:hexString].data;
+    NSMutableData *data = decodeHexString(hexString, SecureAllocator());
+    if (!data) { return nil; }
+    return CFBridgingRelease(CFDataCreateCopy(SecureAllocator(), (__bridge CFDataRef)data));
 }
 
 + (NSString*)dataToHexString: (NSData*)data {
-    return [[SecureData secureDataWithData:data] hexString];
+    return encodeHexString(data.bytes, data.length);
 }
 
 + (NSData*)SHA256: (NSData*)data {
@@ -296,16 +653,7 @@ static RegEx *RegExHex = nil;
 #pragma mark -
 
 - (NSString*)hexString {
-    const uint8_t *bytes = self.bytes;
-    
-    NSMutableString *hex = CFBridgingRelease(CFStringCreateMutable(SecureAllocator(), self.length * 2 + 2));
-    [hex appendString:@"0x"];
-    
-    for (NSUInteger i = 0; i < self.length; i++) {
-        [hex appendFormat:@"%02x", bytes[i]];
-    }
-    
-    return hex;
+    return encodeHexString(self.bytes, self.length);
 }
 
 - (NSData*)data {
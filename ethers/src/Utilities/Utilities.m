@@ -38,18 +38,19 @@ Hash* namehash(NSString *name) {
         return nil;
     }
     
-    NSMutableData *result = [[Hash zeroHash].data mutableCopy];
+    // Each step hashes the current node followed by the hash of the next label
+    eth_hash32 node[2];
+    memset(&node[0], 0, sizeof(eth_hash32));
     
     NSArray *parts = [name componentsSeparatedByString:@"."];
     for (NSInteger i = parts.count - 1; i >= 0; i--) {
         NSData *label = [[parts objectAtIndex:i] dataUsingEncoding:NSUTF8StringEncoding];
         
-        [result appendData:[SecureData KECCAK256:label]];
-        
-        result = [[SecureData KECCAK256:result] mutableCopy];
+        eth_keccak256(label.bytes, label.length, &node[1]);
+        eth_keccak256(node, sizeof(node), &node[0]);
     }
     
-    return [Hash hashWithData:result];
+    return [Hash hashWithHash32:&node[0]];
 }
 
 NSString *stripHexZeros(NSString *hexString) {
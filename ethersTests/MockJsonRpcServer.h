@@ -0,0 +1,70 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ *  MockJsonRpcServer
+ *
+ *  A minimal HTTP/1.1 JSON-RPC server on the loopback interface, for exercising and
+ *  benchmarking JsonRpcProvider without a network. It supports keep-alive and JSON-RPC
+ *  batches, and answers each method with a fixed result.
+ *
+ *  Connections may also upgrade to a WebSocket (at webSocketUrl), or connect to the Unix
+ *  domain socket at ipcPath (one JSON-RPC request per line, as a node's IPC endpoint),
+ *  which additionally support eth_subscribe for "newHeads" and "logs" (log filters are
+ *  not applied).
+ */
+
+#import <Foundation/Foundation.h>
+
+
+@interface MockJsonRpcServer : NSObject
+
+// Listens on an ephemeral port on 127.0.0.1, and on a Unix domain socket
++ (instancetype)server;
+
+@property (nonatomic, readonly) NSURL *url;
+@property (nonatomic, readonly) NSURL *webSocketUrl;
+@property (nonatomic, readonly) NSString *ipcPath;
+
+// Methods without a result respond with a "method not found" error
+- (void)setResult: (NSObject*)result forMethod: (NSString*)method;
+
+@property (atomic, readonly) NSUInteger httpRequestCount;
+// Requests received over WebSocket and IPC connections
+@property (atomic, readonly) NSUInteger messageCount;
+@property (atomic, readonly) NSUInteger callCount;
+
+// Notifies every newHeads subscription (and updates the eth_blockNumber result)
+- (void)pushNewHead: (NSInteger)blockNumber;
+
+// Notifies every logs subscription
+- (void)pushLog: (NSDictionary*)log;
+
+// Closes every open connection, as a node restarting would
+- (void)dropConnections;
+
+- (void)stop;
+
+@end
@@ -0,0 +1,536 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import "MockJsonRpcServer.h"
+
+#include <CommonCrypto/CommonDigest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+#pragma mark -
+#pragma mark - MockJsonRpcConnection
+
+@interface MockJsonRpcServer (private)
+
+- (NSData*)responseForRequest: (NSData*)body connection: (MockJsonRpcConnection*)connection;
+
+@end
+
+static NSString *webSocketAccept(NSString *key) {
+    NSData *data = [[key stringByAppendingString:@"258EAFA5-E914-47DA-95CA-C5AB0DC11B85"] dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1(data.bytes, (CC_LONG)data.length, digest);
+    return [[NSData dataWithBytes:digest length:sizeof(digest)] base64EncodedStringWithOptions:0];
+}
+
+@interface MockJsonRpcConnection : NSObject
+
+// Line-delimited connections carry one JSON-RPC request (or response) per line, as IPC does
+- (instancetype)initWithSocket: (int)fd server: (MockJsonRpcServer*)server queue: (dispatch_queue_t)queue lineDelimited: (BOOL)lineDelimited;
+
+// Subscription id => eth_subscribe params; only used once upgraded to a WebSocket
+@property (nonatomic, readonly) NSMutableDictionary<NSString*, NSArray*> *subscriptions;
+
+- (BOOL)sendText: (NSData*)payload;
+
+- (void)close;
+
+@end
+
+@implementation MockJsonRpcConnection {
+    int _fd;
+    dispatch_source_t _readSource;
+    NSMutableData *_buffer;
+    __weak MockJsonRpcServer *_server;
+    
+    BOOL _lineDelimited;
+    BOOL _webSocket;
+    NSMutableData *_message;
+}
+
+- (instancetype)initWithSocket: (int)fd server: (MockJsonRpcServer*)server queue: (dispatch_queue_t)queue lineDelimited: (BOOL)lineDelimited {
+    self = [super init];
+    if (self) {
+        _fd = fd;
+        _server = server;
+        _lineDelimited = lineDelimited;
+        _buffer = [NSMutableData data];
+        _message = [NSMutableData data];
+        _subscriptions = [NSMutableDictionary dictionary];
+        
+        int noSigPipe = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSigPipe, sizeof(noSigPipe));
+        
+        _readSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, queue);
+        
+        __weak MockJsonRpcConnection *weakSelf = self;
+        dispatch_source_set_event_handler(_readSource, ^() {
+            [weakSelf readAvailable];
+        });
+        dispatch_source_set_cancel_handler(_readSource, ^() {
+            close(fd);
+        });
+        dispatch_resume(_readSource);
+    }
+    return self;
+}
+
+- (void)close {
+    if (!_readSource) { return; }
+    dispatch_source_cancel(_readSource);
+    _readSource = nil;
+}
+
+- (void)readAvailable {
+    uint8_t chunk[16384];
+    ssize_t length = read(_fd, chunk, sizeof(chunk));
+    if (length <= 0) {
+        [self close];
+        return;
+    }
+    
+    [_buffer appendBytes:chunk length:length];
+    
+    // Handle every complete request (or frame) in the buffer (clients may pipeline)
+    while (_lineDelimited ? [self handleLine]: (_webSocket ? [self handleFrame]: [self handleRequest])) { }
+}
+
+- (BOOL)writeData: (NSData*)data {
+    if (!_readSource) { return NO; }
+    
+    const uint8_t *bytes = data.bytes;
+    size_t remaining = data.length;
+    while (remaining) {
+        ssize_t written = write(_fd, bytes, remaining);
+        if (written <= 0) {
+            [self close];
+            return NO;
+        }
+        bytes += written;
+        remaining -= written;
+    }
+    
+    return YES;
+}
+
+- (BOOL)handleRequest {
+    NSData *separator = [@"\r\n\r\n" dataUsingEncoding:NSUTF8StringEncoding];
+    NSRange headerEnd = [_buffer rangeOfData:separator options:0 range:NSMakeRange(0, _buffer.length)];
+    if (headerEnd.location == NSNotFound) { return NO; }
+    
+    NSString *header = [[NSString alloc] initWithData:[_buffer subdataWithRange:NSMakeRange(0, headerEnd.location)]
+                                             encoding:NSUTF8StringEncoding];
+    
+    NSUInteger contentLength = 0;
+    NSString *webSocketKey = nil;
+    for (NSString *line in [header componentsSeparatedByString:@"\r\n"]) {
+        if ([[line lowercaseString] hasPrefix:@"content-length:"]) {
+            contentLength = (NSUInteger)[[line substringFromIndex:15] integerValue];
+        } else if ([[line lowercaseString] hasPrefix:@"sec-websocket-key:"]) {
+            webSocketKey = [[line substringFromIndex:18] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+        }
+    }
+    
+    // Upgrade to a WebSocket; everything after the header is frames
+    if (webSocketKey) {
+        [_buffer replaceBytesInRange:NSMakeRange(0, headerEnd.location + headerEnd.length) withBytes:NULL length:0];
+        _webSocket = YES;
+        
+        NSString *response = [NSString stringWithFormat:@"HTTP/1.1 101 Switching Protocols\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: Upgrade\r\n"
+                              "Sec-WebSocket-Accept: %@\r\n\r\n", webSocketAccept(webSocketKey)];
+        return [self writeData:[response dataUsingEncoding:NSUTF8StringEncoding]];
+    }
+    
+    NSUInteger bodyStart = headerEnd.location + headerEnd.length;
+    if (_buffer.length < bodyStart + contentLength) { return NO; }
+    
+    NSData *body = [_buffer subdataWithRange:NSMakeRange(bodyStart, contentLength)];
+    [_buffer replaceBytesInRange:NSMakeRange(0, bodyStart + contentLength) withBytes:NULL length:0];
+    
+    NSData *responseBody = [_server responseForRequest:body connection:nil];
+    
+    NSString *responseHeader = [NSString stringWithFormat:@"HTTP/1.1 200 OK\r\n"
+                                "Content-Type: application/json\r\n"
+                                "Content-Length: %d\r\n"
+                                "Connection: keep-alive\r\n\r\n", (int)responseBody.length];
+    
+    NSMutableData *response = [[responseHeader dataUsingEncoding:NSUTF8StringEncoding] mutableCopy];
+    [response appendData:responseBody];
+    
+    return [self writeData:response];
+}
+
+- (BOOL)handleLine {
+    NSRange newline = [_buffer rangeOfData:[NSData dataWithBytes:"\n" length:1] options:0 range:NSMakeRange(0, _buffer.length)];
+    if (newline.location == NSNotFound) { return NO; }
+    
+    NSData *line = [_buffer subdataWithRange:NSMakeRange(0, newline.location)];
+    [_buffer replaceBytesInRange:NSMakeRange(0, newline.location + 1) withBytes:NULL length:0];
+    
+    NSMutableData *response = [[_server responseForRequest:line connection:self] mutableCopy];
+    [response appendBytes:"\n" length:1];
+    return [self writeData:response];
+}
+
+// Client frames are always masked; see RFC 6455, section 5.2
+- (BOOL)handleFrame {
+    const uint8_t *bytes = _buffer.bytes;
+    NSUInteger length = _buffer.length;
+    if (length < 2) { return NO; }
+    
+    BOOL fin = (bytes[0] & 0x80) != 0;
+    uint8_t opcode = bytes[0] & 0x0f;
+    BOOL masked = (bytes[1] & 0x80) != 0;
+    
+    uint64_t payloadLength = bytes[1] & 0x7f;
+    NSUInteger offset = 2;
+    if (payloadLength == 126) {
+        if (length < 4) { return NO; }
+        payloadLength = ((uint64_t)bytes[2] << 8) | bytes[3];
+        offset = 4;
+    } else if (payloadLength == 127) {
+        if (length < 10) { return NO; }
+        payloadLength = 0;
+        for (int i = 0; i < 8; i++) { payloadLength = (payloadLength << 8) | bytes[2 + i]; }
+        offset = 10;
+    }
+    
+    uint8_t mask[4] = { 0, 0, 0, 0 };
+    if (masked) {
+        if (length < offset + 4) { return NO; }
+        memcpy(mask, &bytes[offset], 4);
+        offset += 4;
+    }
+    
+    if (length < offset + payloadLength) { return NO; }
+    
+    NSMutableData *payload = [[_buffer subdataWithRange:NSMakeRange(offset, (NSUInteger)payloadLength)] mutableCopy];
+    uint8_t *payloadBytes = payload.mutableBytes;
+    for (NSUInteger i = 0; i < payload.length; i++) { payloadBytes[i] ^= mask[i % 4]; }
+    
+    [_buffer replaceBytesInRange:NSMakeRange(0, offset + (NSUInteger)payloadLength) withBytes:NULL length:0];
+    
+    switch (opcode) {
+        case 0x0: case 0x1: case 0x2:
+            [_message appendData:payload];
+            if (fin) {
+                NSData *message = _message;
+                _message = [NSMutableData data];
+                return [self sendText:[_server responseForRequest:message connection:self]];
+            }
+            return YES;
+            
+        case 0x8:
+            [self sendFrame:payload opcode:0x8];
+            [self close];
+            return NO;
+            
+        case 0x9:
+            return [self sendFrame:payload opcode:0xa];
+    }
+    
+    return YES;
+}
+
+- (BOOL)sendFrame: (NSData*)payload opcode: (uint8_t)opcode {
+    NSMutableData *frame = [NSMutableData dataWithCapacity:payload.length + 10];
+    
+    uint8_t header[10];
+    NSUInteger headerLength = 2;
+    header[0] = 0x80 | opcode;
+    if (payload.length < 126) {
+        header[1] = (uint8_t)payload.length;
+    } else if (payload.length <= 0xffff) {
+        header[1] = 126;
+        header[2] = (uint8_t)(payload.length >> 8);
+        header[3] = (uint8_t)payload.length;
+        headerLength = 4;
+    } else {
+        header[1] = 127;
+        for (int i = 0; i < 8; i++) { header[2 + i] = (uint8_t)((uint64_t)payload.length >> (56 - 8 * i)); }
+        headerLength = 10;
+    }
+    
+    [frame appendBytes:header length:headerLength];
+    [frame appendData:payload];
+    
+    return [self writeData:frame];
+}
+
+- (BOOL)sendText: (NSData*)payload {
+    return [self sendFrame:payload opcode:0x1];
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark - MockJsonRpcServer
+
+@implementation MockJsonRpcServer {
+    dispatch_queue_t _queue;
+    dispatch_source_t _acceptSource;
+    dispatch_source_t _ipcAcceptSource;
+    
+    NSMutableArray<MockJsonRpcConnection*> *_connections;
+    NSMutableDictionary<NSString*, NSObject*> *_results;
+    
+    NSUInteger _nextSubscriptionId;
+}
+
++ (instancetype)server {
+    return [[MockJsonRpcServer alloc] init];
+}
+
+- (dispatch_source_t)acceptSourceWithSocket: (int)fd lineDelimited: (BOOL)lineDelimited {
+    dispatch_source_t acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, fd, 0, _queue);
+    
+    __weak MockJsonRpcServer *weakSelf = self;
+    dispatch_source_set_event_handler(acceptSource, ^() {
+        int connectionFd = accept(fd, NULL, NULL);
+        if (connectionFd < 0) { return; }
+        
+        MockJsonRpcServer *server = weakSelf;
+        if (!server) {
+            close(connectionFd);
+            return;
+        }
+        
+        [server->_connections addObject:[[MockJsonRpcConnection alloc] initWithSocket:connectionFd
+                                                                               server:server
+                                                                                queue:server->_queue
+                                                                        lineDelimited:lineDelimited]];
+    });
+    dispatch_source_set_cancel_handler(acceptSource, ^() {
+        close(fd);
+    });
+    dispatch_resume(acceptSource);
+    
+    return acceptSource;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("MockJsonRpcServer", DISPATCH_QUEUE_SERIAL);
+        _connections = [NSMutableArray array];
+        _results = [@{
+                      @"eth_blockNumber": @"0x1",
+                      @"eth_gasPrice": @"0x4a817c800",
+                      @"eth_getBalance": @"0xde0b6b3a7640000",
+                      @"eth_getTransactionCount": @"0x7",
+                      } mutableCopy];
+        
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) { return nil; }
+        
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_len = sizeof(address);
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = 0;
+        
+        socklen_t addressLength = sizeof(address);
+        if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 64) != 0 ||
+            getsockname(fd, (struct sockaddr*)&address, &addressLength) != 0) {
+            close(fd);
+            return nil;
+        }
+        
+        _url = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%d/", ntohs(address.sin_port)]];
+        _webSocketUrl = [NSURL URLWithString:[NSString stringWithFormat:@"ws://127.0.0.1:%d/", ntohs(address.sin_port)]];
+        
+        _acceptSource = [self acceptSourceWithSocket:fd lineDelimited:NO];
+        
+        // Unix socket paths are limited to 104 bytes, which the simulator's temporary directory may exceed
+        NSString *ipcName = [NSString stringWithFormat:@"ethers-%@.ipc", [[[NSUUID UUID] UUIDString] substringToIndex:8]];
+        _ipcPath = [NSTemporaryDirectory() stringByAppendingPathComponent:ipcName];
+        if (strlen(_ipcPath.fileSystemRepresentation) >= sizeof(((struct sockaddr_un*)NULL)->sun_path)) {
+            _ipcPath = [@"/tmp" stringByAppendingPathComponent:ipcName];
+        }
+        
+        int ipcFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (ipcFd < 0) { return nil; }
+        
+        struct sockaddr_un ipcAddress;
+        memset(&ipcAddress, 0, sizeof(ipcAddress));
+        ipcAddress.sun_family = AF_UNIX;
+        strlcpy(ipcAddress.sun_path, _ipcPath.fileSystemRepresentation, sizeof(ipcAddress.sun_path));
+        
+        unlink(ipcAddress.sun_path);
+        if (bind(ipcFd, (struct sockaddr*)&ipcAddress, sizeof(ipcAddress)) != 0 || listen(ipcFd, 64) != 0) {
+            close(ipcFd);
+            return nil;
+        }
+        
+        _ipcAcceptSource = [self acceptSourceWithSocket:ipcFd lineDelimited:YES];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self stop];
+}
+
+- (void)stop {
+    dispatch_source_t acceptSource = _acceptSource, ipcAcceptSource = _ipcAcceptSource;
+    _acceptSource = nil;
+    _ipcAcceptSource = nil;
+    if (!acceptSource) { return; }
+    
+    unlink(_ipcPath.fileSystemRepresentation);
+    
+    NSArray<MockJsonRpcConnection*> *connections = _connections;
+    dispatch_async(_queue, ^() {
+        dispatch_source_cancel(acceptSource);
+        if (ipcAcceptSource) { dispatch_source_cancel(ipcAcceptSource); }
+        for (MockJsonRpcConnection *connection in connections) { [connection close]; }
+    });
+}
+
+- (void)setResult: (NSObject*)result forMethod: (NSString*)method {
+    @synchronized (_results) {
+        [_results setObject:result forKey:method];
+    }
+}
+
+- (void)dropConnections {
+    dispatch_async(_queue, ^() {
+        for (MockJsonRpcConnection *connection in _connections) { [connection close]; }
+        [_connections removeAllObjects];
+    });
+}
+
+- (void)pushNotification: (NSDictionary*)result kind: (NSString*)kind {
+    dispatch_async(_queue, ^() {
+        for (MockJsonRpcConnection *connection in _connections) {
+            for (NSString *subscriptionId in [connection.subscriptions allKeys]) {
+                if (![[[connection.subscriptions objectForKey:subscriptionId] firstObject] isEqual:kind]) { continue; }
+                
+                NSDictionary *notification = @{
+                                               @"jsonrpc": @"2.0",
+                                               @"method": @"eth_subscription",
+                                               @"params": @{ @"subscription": subscriptionId, @"result": result },
+                                               };
+                [connection sendText:[NSJSONSerialization dataWithJSONObject:notification options:0 error:nil]];
+            }
+        }
+    });
+}
+
+- (void)pushNewHead: (NSInteger)blockNumber {
+    NSString *number = [NSString stringWithFormat:@"0x%lx", (long)blockNumber];
+    [self setResult:number forMethod:@"eth_blockNumber"];
+    [self pushNotification:@{ @"number": number } kind:@"newHeads"];
+}
+
+- (void)pushLog: (NSDictionary*)log {
+    [self pushNotification:log kind:@"logs"];
+}
+
+// Only called on the queue
+- (NSObject*)subscriptionResultForCall: (NSDictionary*)call connection: (MockJsonRpcConnection*)connection {
+    NSArray *params = [call objectForKey:@"params"];
+    if (![params isKindOfClass:[NSArray class]] || params.count == 0) { return nil; }
+    
+    if ([[call objectForKey:@"method"] isEqual:@"eth_subscribe"]) {
+        NSString *subscriptionId = [NSString stringWithFormat:@"0x%lx", (unsigned long)(++_nextSubscriptionId)];
+        [connection.subscriptions setObject:params forKey:subscriptionId];
+        return subscriptionId;
+    }
+    
+    BOOL subscribed = ([connection.subscriptions objectForKey:[params firstObject]] != nil);
+    [connection.subscriptions removeObjectForKey:[params firstObject]];
+    return @(subscribed);
+}
+
+- (NSDictionary*)responseForCall: (NSDictionary*)call connection: (MockJsonRpcConnection*)connection {
+    NSObject *requestId = [call objectForKey:@"id"];
+    if (!requestId) { requestId = [NSNull null]; }
+    
+    NSObject *method = [call objectForKey:@"method"];
+    
+    NSObject *result = nil;
+    if (connection && ([method isEqual:@"eth_subscribe"] || [method isEqual:@"eth_unsubscribe"])) {
+        result = [self subscriptionResultForCall:call connection:connection];
+    } else {
+        @synchronized (_results) {
+            result = [_results objectForKey:method];
+        }
+    }
+    
+    @synchronized (self) {
+        _callCount++;
+    }
+    
+    if (!result) {
+        return @{@"jsonrpc": @"2.0", @"id": requestId, @"error": @{@"code": @(-32601), @"message": @"method not found"}};
+    }
+    
+    return @{@"jsonrpc": @"2.0", @"id": requestId, @"result": result};
+}
+
+- (NSData*)responseForRequest: (NSData*)body connection: (MockJsonRpcConnection*)connection {
+    @synchronized (self) {
+        if (connection) {
+            _messageCount++;
+        } else {
+            _httpRequestCount++;
+        }
+    }
+    
+    NSObject *response = nil;
+    
+    NSObject *request = [NSJSONSerialization JSONObjectWithData:body options:0 error:nil];
+    if ([request isKindOfClass:[NSArray class]] && [(NSArray*)request count]) {
+        NSMutableArray *responses = [NSMutableArray arrayWithCapacity:[(NSArray*)request count]];
+        for (NSDictionary *call in (NSArray*)request) {
+            if (![call isKindOfClass:[NSDictionary class]]) { continue; }
+            [responses addObject:[self responseForCall:call connection:connection]];
+        }
+        response = responses;
+        
+    } else if ([request isKindOfClass:[NSDictionary class]]) {
+        response = [self responseForCall:(NSDictionary*)request connection:connection];
+        
+    } else {
+        response = @{@"jsonrpc": @"2.0", @"id": [NSNull null], @"error": @{@"code": @(-32600), @"message": @"invalid request"}};
+    }
+    
+    return [NSJSONSerialization dataWithJSONObject:response options:0 error:nil];
+}
+
+@end
@@ -113,6 +113,85 @@
     }
 }
 
+- (void)testAddressEquality {
+    NSString *checksumAddress = @"0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed";
+    Address *lower = [Address addressWithString:[checksumAddress lowercaseString]];
+    Address *checksummed = [Address addressWithString:checksumAddress];
+    
+    XCTAssertEqualObjects(lower, checksummed, @"Failed address equality");
+    XCTAssertEqual(lower.hash, checksummed.hash, @"Failed address hash");
+    XCTAssertEqualObjects(@{ lower: @"value" }[checksummed], @"value", @"Failed address dictionary key");
+    XCTAssertEqualObjects([Address addressWithData:lower.data], checksummed, @"Failed address data");
+    XCTAssertEqualObjects(lower.checksumAddress, checksumAddress, @"Failed lazy checksum");
+    _assertionCount += 5;
+
+    // A bad checksum is still rejected up front
+    XCTAssertNil([Address addressWithString:@"0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAeD"], @"Failed bad checksum");
+    XCTAssertNil([Address addressWithString:@"0x5aaeb6053f3e94c9b9a09f33669435e7ef1bea"], @"Failed short address");
+    XCTAssertTrue([Address addressWithString:@"0000000000000000000000000000000000000000"].isZeroAddress, @"Failed zero address");
+    XCTAssertFalse([lower isEqual:checksumAddress], @"Failed address equals string");
+    _assertionCount += 4;
+}
+
+- (void)testInterning {
+    NSString *checksumAddress = @"0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed";
+    NSString *hashHex = @"0x88df016429689c079f3b2f6ad39fa052532c56795b733da78a91ebe6a713944b";
+    
+    XCTAssertTrue([Address addressWithString:checksumAddress] != [Address addressWithString:checksumAddress], @"Failed interning disabled");
+    _assertionCount++;
+    
+    [Address setInterningEnabled:YES];
+    [Hash setInterningEnabled:YES];
+    [[Address internTable] resetStatistics];
+    
+    Address *address = [Address addressWithString:checksumAddress];
+    XCTAssertTrue([Address addressWithString:[checksumAddress lowercaseString]] == address, @"Failed interned string");
+    XCTAssertTrue([Address addressWithData:address.data] == address, @"Failed interned data");
+    XCTAssertTrue([Hash hashWithHexString:hashHex] == [Hash hashWithData:[SecureData hexStringToData:hashHex]], @"Failed interned hash");
+    XCTAssertEqual([Address internTable].hitCount, 2, @"Failed intern hit count");
+    XCTAssertEqualWithAccuracy([Address internTable].hitRate, 2.0 / 3.0, 0.0001, @"Failed intern hit rate");
+    _assertionCount += 5;
+    
+    // A miss is a single lookup, even though it goes on to intern the new object
+    unsigned char otherBytes[20] = { 0x42 };
+    Address *otherAddress = [Address addressWithData:[NSData dataWithBytes:otherBytes length:sizeof(otherBytes)]];
+    XCTAssertTrue(otherAddress != address, @"Failed interned miss");
+    XCTAssertEqual([Address internTable].lookupCount, 4, @"Failed intern lookup count");
+    XCTAssertEqualWithAccuracy([Address internTable].hitRate, 0.5, 0.0001, @"Failed intern miss hit rate");
+    _assertionCount += 3;
+    
+    // Entries for released addresses are swept, so the table does not grow without bound
+    for (int i = 0; i < 20000; i++) {
+        @autoreleasepool {
+            unsigned char bytes[20] = { 0 };
+            memcpy(bytes, &i, sizeof(i));
+            [Address addressWithData:[NSData dataWithBytes:bytes length:sizeof(bytes)]];
+        }
+    }
+    XCTAssertLessThan([Address internTable].count, 10000, @"Failed intern table sweep");
+    _assertionCount++;
+    
+    [Address setInterningEnabled:NO];
+    [Hash setInterningEnabled:NO];
+}
+
+- (void)testHashes {
+    NSString *emptyKeccak = @"0xc5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470";
+    
+    eth_hash32 hash32;
+    eth_keccak256("", 0, &hash32);
+    Hash *hash = [Hash hashWithHash32:&hash32];
+    XCTAssertEqualObjects(hash.hexString, emptyKeccak, @"Failed eth_keccak256");
+    XCTAssertEqualObjects(hash, [Hash hashWithHexString:emptyKeccak], @"Failed hash equality");
+    XCTAssertEqual(hash.hash, [Hash hashWithData:hash.data].hash, @"Failed hash hash");
+    
+    eth_hash32 roundTrip = hash.hash32;
+    XCTAssertTrue(eth_hash32_equal(&roundTrip, &hash32), @"Failed hash32 round trip");
+    XCTAssertTrue([Hash zeroHash].isZeroHash && !hash.isZeroHash, @"Failed zero hash");
+    XCTAssertNil([Hash hashWithData:[NSData dataWithBytes:hash32.bytes length:31]], @"Failed short hash");
+    _assertionCount += 6;
+}
+
 - (void)testReportedBugs {
     // https://github.com/ethers-io/ethers.objc/pull/8
     // Reported by: https://github.com/zweigraf
@@ -0,0 +1,227 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import <XCTest/XCTest.h>
+
+#include <objc/runtime.h>
+#include <stdatomic.h>
+
+#import "ethers.h"
+
+
+// Whether the value has created its libtommath mp_int (which allocates its digits)
+static BOOL hasBigNumber(BigNumber *value) {
+    Ivar ivar = class_getInstanceVariable([BigNumber class], "_hasBigNumber");
+    return atomic_load((atomic_bool*)((uint8_t*)(__bridge void*)value + ivar_getOffset(ivar)));
+}
+
+
+@interface test_bignumber : XCTestCase {
+    int _assertionCount;
+}
+
+@end
+
+@implementation test_bignumber
+
+- (void)setUp {
+    [super setUp];
+    _assertionCount = 0;
+}
+
+- (void)tearDown {
+    [super tearDown];
+    NSLog(@"test-bignumber: Finished %d assertions.", _assertionCount);
+}
+
+- (void)testArithmetic {
+    BigNumber *maxUint256 = [BigNumber bigNumberWithHexString:@"0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"];
+    BigNumber *twoTo256 = [BigNumber bigNumberWithHexString:@"0x010000000000000000000000000000000000000000000000000000000000000000"];
+    BigNumber *twoTo64 = [BigNumber bigNumberWithHexString:@"0x010000000000000000"];
+    BigNumber *maxUint64 = [BigNumber bigNumberWithHexString:@"0xffffffffffffffff"];
+    
+    // Carry across words and out of the fixed width
+    XCTAssertEqualObjects([maxUint64 add:[BigNumber constantOne]], twoTo64, @"Failed add: word carry");
+    XCTAssertEqualObjects([maxUint256 add:[BigNumber constantOne]], twoTo256, @"Failed add: overflow");
+    XCTAssertEqualObjects([twoTo256 sub:[BigNumber constantOne]], maxUint256, @"Failed sub: from overflow");
+    _assertionCount += 3;
+
+    // Borrow across words and into negative values
+    XCTAssertEqualObjects([twoTo64 sub:[BigNumber constantOne]], maxUint64, @"Failed sub: word borrow");
+    XCTAssertEqualObjects([[BigNumber constantOne] sub:[BigNumber constantTwo]], [BigNumber constantNegativeOne], @"Failed sub: negative");
+    XCTAssertTrue([[BigNumber constantZero] sub:[BigNumber constantOne]].isNegative, @"Failed sub: isNegative");
+    XCTAssertEqualObjects([[BigNumber constantNegativeOne] add:[BigNumber constantOne]], [BigNumber constantZero], @"Failed add: negative to zero");
+    _assertionCount += 4;
+    
+    // Multiplication across words and out of the fixed width
+    XCTAssertEqualObjects([maxUint64 mul:maxUint64],
+                          [BigNumber bigNumberWithHexString:@"0xfffffffffffffffe0000000000000001"], @"Failed mul: cross-word");
+    XCTAssertEqualObjects([maxUint256 mul:[BigNumber constantTwo]],
+                          [twoTo256 add:[maxUint256 sub:[BigNumber constantOne]]], @"Failed mul: overflow");
+    XCTAssertEqualObjects([[BigNumber constantWeiPerEther] mul:[BigNumber bigNumberWithInteger:21000]],
+                          [BigNumber bigNumberWithDecimalString:@"21000000000000000000000"], @"Failed mul: wei");
+    _assertionCount += 3;
+    
+    // Division and modulo
+    BigNumber *value = [BigNumber bigNumberWithDecimalString:@"123456789012345678901234567890123456789"];
+    XCTAssertEqualObjects([value div:[BigNumber bigNumberWithInteger:1000]],
+                          [BigNumber bigNumberWithDecimalString:@"123456789012345678901234567890123456"], @"Failed div: word");
+    XCTAssertEqualObjects([value mod:[BigNumber bigNumberWithInteger:1000]], [BigNumber bigNumberWithInteger:789], @"Failed mod: word");
+    XCTAssertEqualObjects([value div:[BigNumber constantWeiPerEther]],
+                          [BigNumber bigNumberWithDecimalString:@"123456789012345678901"], @"Failed div: wei");
+    XCTAssertEqualObjects([value mod:[BigNumber constantWeiPerEther]],
+                          [BigNumber bigNumberWithDecimalString:@"234567890123456789"], @"Failed mod: wei");
+    _assertionCount += 4;
+    
+    // Comparison and hashing must agree between representations
+    XCTAssertTrue([twoTo256 greaterThan:maxUint256], @"Failed compare: overflow");
+    XCTAssertTrue([[BigNumber constantNegativeOne] lessThan:[BigNumber constantZero]], @"Failed compare: negative");
+    XCTAssertEqual([[twoTo256 sub:[BigNumber constantOne]] hash], [maxUint256 hash], @"Failed hash");
+    _assertionCount += 3;
+}
+
+- (void)testConversions {
+    NSArray *tests = @[
+                       @{@"decimal": @"0", @"hex": @"0x00"},
+                       @{@"decimal": @"1", @"hex": @"0x01"},
+                       @{@"decimal": @"255", @"hex": @"0xFF"},
+                       @{@"decimal": @"256", @"hex": @"0x0100"},
+                       @{@"decimal": @"18446744073709551615", @"hex": @"0xFFFFFFFFFFFFFFFF"},
+                       @{@"decimal": @"18446744073709551616", @"hex": @"0x010000000000000000"},
+                       @{@"decimal": @"10000000000000000000", @"hex": @"0x8AC7230489E80000"},
+                       @{@"decimal": @"115792089237316195423570985008687907853269984665640564039457584007913129639935",
+                         @"hex": @"0xFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF"},
+                       @{@"decimal": @"115792089237316195423570985008687907853269984665640564039457584007913129639936",
+                         @"hex": @"0x010000000000000000000000000000000000000000000000000000000000000000"},
+                       @{@"decimal": @"-1", @"hex": @"-0x01"},
+                       @{@"decimal": @"-18446744073709551616", @"hex": @"-0x010000000000000000"},
+                       ];
+    
+    for (NSDictionary *testcase in tests) {
+        NSString *decimal = [testcase objectForKey:@"decimal"];
+        NSString *hex = [testcase objectForKey:@"hex"];
+        
+        BigNumber *fromDecimal = [BigNumber bigNumberWithDecimalString:decimal];
+        BigNumber *fromHex = [BigNumber bigNumberWithHexString:hex];
+        BigNumber *fromLowerHex = [BigNumber bigNumberWithHexString:[hex lowercaseString]];
+        
+        XCTAssertEqualObjects(fromDecimal, fromHex, @"Failed to parse: %@", decimal);
+        XCTAssertEqualObjects(fromHex, fromLowerHex, @"Failed to parse lowercase: %@", hex);
+        XCTAssertEqualObjects(fromDecimal.decimalString, decimal, @"Failed decimalString: %@", decimal);
+        XCTAssertEqualObjects(fromDecimal.hexString, hex, @"Failed hexString: %@", decimal);
+        _assertionCount += 4;
+        
+        if (!fromDecimal.isNegative) {
+            XCTAssertEqualObjects([BigNumber bigNumberWithData:fromDecimal.data], fromDecimal, @"Failed data: %@", decimal);
+            _assertionCount++;
+        }
+    }
+    
+    // Leading zeros and empty digits
+    XCTAssertEqualObjects([BigNumber bigNumberWithHexString:@"0x0000000000000000000000000000000000000000000000000000000000000000000001"],
+                          [BigNumber constantOne], @"Failed leading zeros");
+    XCTAssertEqualObjects([BigNumber bigNumberWithHexString:@"0x"], [BigNumber constantZero], @"Failed empty hex");
+    XCTAssertEqualObjects([BigNumber bigNumberWithDecimalString:@"-0"], [BigNumber constantZero], @"Failed negative zero");
+    _assertionCount += 3;
+
+    // Invalid strings
+    XCTAssertNil([BigNumber bigNumberWithHexString:@"1234"], @"Failed missing 0x");
+    XCTAssertNil([BigNumber bigNumberWithHexString:@"0x12g4"], @"Failed invalid hex");
+    XCTAssertNil([BigNumber bigNumberWithDecimalString:@"12.5"], @"Failed invalid decimal");
+    XCTAssertNil([BigNumber bigNumberWithDecimalString:@"1e18"], @"Failed invalid decimal");
+    _assertionCount += 4;
+
+    // Data is minimal big-endian
+    XCTAssertEqualObjects([BigNumber constantZero].data, [SecureData hexStringToData:@"0x00"], @"Failed data: zero");
+    XCTAssertEqualObjects([BigNumber bigNumberWithInteger:258].data, [SecureData hexStringToData:@"0x0102"], @"Failed data: 258");
+    XCTAssertNil([BigNumber constantNegativeOne].data, @"Failed data: negative");
+    _assertionCount += 3;
+
+    // Integers and numbers
+    XCTAssertEqualObjects([BigNumber bigNumberWithInteger:NSIntegerMin].decimalString, @"-9223372036854775808", @"Failed integer: min");
+    XCTAssertEqualObjects([BigNumber bigNumberWithNumber:@(UINT64_MAX)].hexString, @"0xFFFFFFFFFFFFFFFF", @"Failed number: max");
+    XCTAssertEqualObjects([BigNumber bigNumberWithNumber:@(-42)], [BigNumber bigNumberWithDecimalString:@"-42"], @"Failed number: negative");
+    XCTAssertEqual([BigNumber bigNumberWithHexString:@"0x0123456789abcdef"].uint64Value, 0x0123456789abcdefULL, @"Failed uint64Value");
+    XCTAssertEqual([BigNumber bigNumberWithDecimalString:@"-42"].integerValue, -42, @"Failed integerValue");
+    XCTAssertEqual([BigNumber bigNumberWithHexString:@"0x10000000000000000000000000000000000000000000000000000000000000001"].uint64Value, 1, @"Failed uint64Value: wide");
+    XCTAssertNil([BigNumber bigNumberWithNumber:nil], @"Failed number: nil");
+    _assertionCount += 7;
+}
+
+- (void)testSharedInstances {
+    
+    // Small values and powers of ten come from the shared cache
+    XCTAssertTrue([BigNumber bigNumberWithInteger:0] == [BigNumber constantZero], @"Failed shared zero");
+    XCTAssertTrue([BigNumber bigNumberWithHexString:@"0xff"] == [BigNumber bigNumberWithInteger:255], @"Failed shared 255");
+    XCTAssertTrue([[BigNumber constantOne] add:[BigNumber constantOne]] == [BigNumber constantTwo], @"Failed shared sum");
+    XCTAssertTrue([BigNumber bigNumberWithDecimalString:@"1000000000"] == [BigNumber bigNumberWithInteger:1000000000], @"Failed shared gwei");
+    XCTAssertTrue([[BigNumber constantWeiPerEther] div:[BigNumber constantWeiPerEther]] == [BigNumber constantOne], @"Failed shared quotient");
+    _assertionCount += 5;
+
+    // Other values are still distinct (but equal) instances
+    BigNumber *a = [BigNumber bigNumberWithInteger:256], *b = [BigNumber bigNumberWithInteger:256];
+    XCTAssertEqualObjects(a, b, @"Failed uncached equality");
+    XCTAssertEqualObjects(a.decimalString, @"256", @"Failed uncached value");
+    _assertionCount += 2;
+}
+
+- (void)testSmallValueAllocations {
+    
+    // Every small result is one of the 256 shared instances, so the loop allocates nothing
+    NSHashTable *instances = [NSHashTable hashTableWithOptions:(NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality)];
+    BigNumber *modulus = [BigNumber bigNumberWithInteger:200];
+    BigNumber *total = [BigNumber constantZero];
+    for (NSInteger i = 0; i < 100000; i++) {
+        BigNumber *value = [BigNumber bigNumberWithInteger:(i & 0xff)];
+        total = [[total add:value] mod:modulus];
+        [instances addObject:value];
+        [instances addObject:total];
+    }
+    XCTAssertLessThanOrEqual(instances.count, 256, @"Failed shared small values");
+    XCTAssertFalse(hasBigNumber(total), @"Failed small value mp_int");
+    _assertionCount += 2;
+    
+    // Larger values that fit in 256 bits are held inline, without an mp_int
+    BigNumber *large = [BigNumber bigNumberWithHexString:@"0x0123456789abcdef0123456789abcdef"];
+    BigNumber *product = [[large mul:large] add:[BigNumber constantWeiPerEther]];
+    XCTAssertFalse(hasBigNumber(large) || hasBigNumber(product), @"Failed inline value mp_int");
+    
+    // Only values outside the inline range need one
+    XCTAssertTrue(hasBigNumber([BigNumber bigNumberWithInteger:-1000]), @"Failed negative value mp_int");
+    _assertionCount += 2;
+}
+
+- (void)testSmallValuePerformance {
+    [self measureBlock:^{
+        BigNumber *total = [BigNumber constantZero];
+        for (NSInteger i = 0; i < 100000; i++) {
+            BigNumber *value = [BigNumber bigNumberWithInteger:(i & 0xff)];
+            total = [[total add:value] mod:[BigNumber bigNumberWithInteger:200]];
+        }
+        XCTAssertNotNil(total);
+    }];
+}
+
+@end
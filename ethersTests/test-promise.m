@@ -0,0 +1,325 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "ethers.h"
+
+
+@interface test_promise : XCTestCase {
+    int _assertionCount;
+}
+
+@end
+
+
+static void countCompletion(Promise *promise, void *context) {
+    (*(NSInteger*)context)++;
+}
+
+
+@implementation test_promise
+
+- (void)setUp {
+    [super setUp];
+    _assertionCount = 0;
+}
+
+- (void)tearDown {
+    [super tearDown];
+    NSLog(@"test-promise: Finished %d assertions.", _assertionCount);
+}
+
+- (void)testCallbackQueues {
+    dispatch_queue_t queue = dispatch_queue_create("test-promise", DISPATCH_QUEUE_SERIAL);
+    static void *QueueKey = &QueueKey;
+    dispatch_queue_set_specific(queue, QueueKey, QueueKey, NULL);
+    
+    XCTestExpectation *expect = [self expectationWithDescription:@"Test/Promise/callbackQueue"];
+    
+    Promise *promise = [Promise promiseWithSetup:^(Promise *promise) { }];
+    promise.callbackQueue = queue;
+    [promise onCompletion:^(Promise *promise) {
+        XCTAssertTrue(dispatch_get_specific(QueueKey) == QueueKey, @"Failed callback queue");
+        [expect fulfill];
+    }];
+    [promise resolve:@"done"];
+    _assertionCount++;
+    
+    [self waitForExpectationsWithTimeout:5.0f handler:nil];
+    
+    // Inline callbacks run on the thread which completes the promise, in order
+    NSMutableArray *order = [NSMutableArray array];
+    Promise *inlinePromise = [Promise promiseWithSetup:^(Promise *promise) { }];
+    inlinePromise.callbackQueue = nil;
+    for (NSInteger i = 0; i < 5; i++) {
+        [inlinePromise onCompletion:^(Promise *promise) { [order addObject:@(i)]; }];
+    }
+    [inlinePromise resolve:nil];
+    XCTAssertEqualObjects(order, (@[ @0, @1, @2, @3, @4 ]), @"Failed inline callback order");
+    
+    [inlinePromise onCompletion:^(Promise *promise) { [order addObject:@5]; }];
+    XCTAssertEqual(order.count, 6, @"Failed inline callback after completion");
+    XCTAssertEqualObjects(inlinePromise.result, [NSNull null], @"Failed resolve with nil");
+    _assertionCount += 3;
+}
+
+- (void)testConcurrentCompletion {
+    dispatch_queue_t concurrentQueue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    
+    for (NSInteger round = 0; round < 100; round++) {
+        Promise *promise = [Promise promiseWithSetup:^(Promise *promise) { }];
+        promise.callbackQueue = concurrentQueue;
+        
+        NSMutableArray *calls = [NSMutableArray array];
+        dispatch_group_t group = dispatch_group_create();
+        for (NSInteger i = 0; i < 8; i++) {
+            dispatch_group_async(group, concurrentQueue, ^() {
+                [promise onCompletion:^(Promise *promise) {
+                    @synchronized (calls) { [calls addObject:@(i)]; }
+                }];
+                if (i % 2) {
+                    [promise resolve:@(i)];
+                } else {
+                    [promise reject:nil];
+                }
+            });
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        
+        // Callbacks are asynchronous on the concurrent queue; wait for them to drain
+        NSUInteger callCount = 0;
+        for (NSInteger i = 0; i < 100; i++) {
+            @synchronized (calls) { callCount = calls.count; }
+            if (callCount == 8) { break; }
+            usleep(1000);
+        }
+        
+        XCTAssertTrue(promise.complete, @"Failed concurrent completion");
+        XCTAssertTrue((promise.result == nil) != (promise.error == nil), @"Failed single outcome");
+        XCTAssertEqual(callCount, 8, @"Failed callback count");
+        _assertionCount += 3;
+    }
+}
+
+- (void)testAllOffMainQueue {
+    dispatch_queue_t concurrentQueue = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    
+    NSMutableArray<Promise*> *promises = [NSMutableArray array];
+    for (NSInteger i = 0; i < 50; i++) {
+        Promise *promise = [Promise promiseWithSetup:^(Promise *promise) {
+            dispatch_async(concurrentQueue, ^() { [promise resolve:@(i)]; });
+        }];
+        promise.callbackQueue = concurrentQueue;
+        [promises addObject:promise];
+    }
+    
+    XCTestExpectation *expect = [self expectationWithDescription:@"Test/Promise/all"];
+    [[Promise all:promises] onCompletion:^(ArrayPromise *promise) {
+        XCTAssertEqual(promise.value.count, 50, @"Failed all count");
+        XCTAssertEqualObjects([promise.value lastObject], @49, @"Failed all order");
+        [expect fulfill];
+    }];
+    _assertionCount += 2;
+    
+    [self waitForExpectationsWithTimeout:5.0f handler:nil];
+}
+
+- (Promise*)promiseResolving: (NSObject*)result after: (NSTimeInterval)delay {
+    return [Promise promiseWithSetup:^(Promise *promise) {
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^() {
+            if ([result isKindOfClass:[NSError class]]) {
+                [promise reject:(NSError*)result];
+            } else {
+                [promise resolve:result];
+            }
+        });
+    }];
+}
+
+- (void)testCombinators {
+    NSError *error = [NSError errorWithDomain:@"test-promise" code:42 userInfo:@{}];
+    
+    XCTestExpectation *expectRace = [self expectationWithDescription:@"Test/Promise/race"];
+    Promise *slow = [self promiseResolving:@"slow" after:2.0f];
+    [[Promise race:@[ slow, [self promiseResolving:error after:0.1f] ]] onCompletion:^(Promise *promise) {
+        XCTAssertEqualObjects(promise.error, error, @"Failed race");
+        XCTAssertTrue(slow.cancelled, @"Failed race cancelling the loser");
+        [expectRace fulfill];
+    }];
+    
+    XCTestExpectation *expectAny = [self expectationWithDescription:@"Test/Promise/any"];
+    [[Promise any:@[ [self promiseResolving:error after:0.1f], [self promiseResolving:@"ok" after:0.2f] ]] onCompletion:^(Promise *promise) {
+        XCTAssertEqualObjects(promise.result, @"ok", @"Failed any");
+        [expectAny fulfill];
+    }];
+    
+    XCTestExpectation *expectAnyRejected = [self expectationWithDescription:@"Test/Promise/any/rejected"];
+    [[Promise any:@[ [Promise rejected:error], [Promise rejected:error] ]] onCompletion:^(Promise *promise) {
+        XCTAssertEqual(promise.error.code, PromiseErrorAllRejected, @"Failed any all rejected");
+        XCTAssertEqual([[promise.error.userInfo objectForKey:@"errors"] count], 2, @"Failed any errors");
+        [expectAnyRejected fulfill];
+    }];
+    
+    XCTestExpectation *expectSettled = [self expectationWithDescription:@"Test/Promise/allSettled"];
+    [[Promise allSettled:@[ [Promise resolved:@1], [Promise rejected:error] ]] onCompletion:^(ArrayPromise *promise) {
+        XCTAssertEqualObjects([[promise.value objectAtIndex:0] result], @1, @"Failed allSettled resolved");
+        XCTAssertEqualObjects([[promise.value objectAtIndex:1] error], error, @"Failed allSettled rejected");
+        [expectSettled fulfill];
+    }];
+    
+    XCTestExpectation *expectTimeout = [self expectationWithDescription:@"Test/Promise/timeout"];
+    Promise *slowTimeout = [self promiseResolving:@"slow" after:2.0f];
+    [[slowTimeout timeout:0.1f] onCompletion:^(Promise *promise) {
+        XCTAssertEqual(promise.error.code, PromiseErrorTimeout, @"Failed timeout");
+        XCTAssertTrue(slowTimeout.cancelled, @"Failed timeout cancelling the source");
+        [expectTimeout fulfill];
+    }];
+    
+    XCTestExpectation *expectNoTimeout = [self expectationWithDescription:@"Test/Promise/timeout/ok"];
+    [[[BigNumberPromise resolved:[BigNumber constantOne]] timeout:1.0f] onCompletion:^(BigNumberPromise *promise) {
+        XCTAssertEqualObjects(promise.value, [BigNumber constantOne], @"Failed timeout result");
+        [expectNoTimeout fulfill];
+    }];
+    
+    _assertionCount += 10;
+    
+    [self waitForExpectationsWithTimeout:5.0f handler:nil];
+}
+
+- (void)testCancellation {
+    __block BOOL abandoned = NO;
+    Promise *promise = [Promise promiseWithSetup:^(Promise *promise) {
+        [promise.cancellationToken onCancel:^() { abandoned = YES; }];
+    }];
+    
+    [promise cancel];
+    XCTAssertTrue(abandoned, @"Failed cancel handler");
+    XCTAssertTrue(promise.cancelled, @"Failed cancelled");
+    XCTAssertEqual(promise.error.code, PromiseErrorCancelled, @"Failed cancel error");
+    
+    // Cancelling a completed promise does nothing
+    Promise *resolved = [Promise resolved:@"done"];
+    [resolved cancel];
+    XCTAssertEqualObjects(resolved.result, @"done", @"Failed cancel after completion");
+    XCTAssertFalse(resolved.cancelled, @"Failed cancelled after completion");
+    _assertionCount += 5;
+}
+
+- (void)testTypedAndUnboxed {
+    TypedPromise<Hash*> *hashPromise = [TypedPromise promiseWithValueClass:[Hash class] setup:^(TypedPromise<Hash*> *promise) {
+        [promise resolve:[Hash zeroHash]];
+    }];
+    XCTAssertEqualObjects(hashPromise.value, [Hash zeroHash], @"Failed typed value");
+    
+    TypedPromise<Hash*> *wrongPromise = [TypedPromise promiseWithValueClass:[Hash class] setup:^(TypedPromise<Hash*> *promise) {
+        [promise resolve:@"not a hash"];
+    }];
+    XCTAssertNotNil(wrongPromise.error, @"Failed typed value check");
+    
+    IntegerPromise *integerPromise = [IntegerPromise promiseWithSetup:^(Promise *promise) {
+        [(IntegerPromise*)promise resolveInteger:-42];
+    }];
+    [integerPromise resolveInteger:7];
+    XCTAssertEqual(integerPromise.value, -42, @"Failed unboxed integer");
+    XCTAssertEqualObjects(integerPromise.result, @(-42), @"Failed boxed integer");
+    
+    FloatPromise *floatPromise = [FloatPromise promiseWithSetup:^(Promise *promise) {
+        [(FloatPromise*)promise resolveFloat:1.5f];
+    }];
+    XCTAssertEqual(floatPromise.value, 1.5f, @"Failed unboxed float");
+    _assertionCount += 5;
+}
+
+- (void)testFunctionContinuations {
+    NSInteger count = 0;
+    
+    Promise *promise = [Promise promiseWithSetup:^(Promise *promise) { }];
+    promise.callbackQueue = nil;
+    
+    // The first continuation is stored inline, the rest are allocated
+    for (NSInteger i = 0; i < 3; i++) {
+        [promise onCompletionFunction:countCompletion context:&count];
+    }
+    XCTAssertEqual(count, 0, @"Failed pending continuation");
+    
+    [promise resolve:nil];
+    XCTAssertEqual(count, 3, @"Failed continuation");
+    
+    [promise onCompletionFunction:countCompletion context:&count];
+    XCTAssertEqual(count, 4, @"Failed continuation after completion");
+    _assertionCount += 3;
+}
+
+- (void)testTracing {
+    PromiseTracer *tracer = [PromiseTracer sharedTracer];
+    [tracer removeAllEvents];
+    
+    Promise *untraced = [Promise resolved:nil];
+    XCTAssertEqual(untraced.traceId, 0, @"Failed untraced");
+    
+    tracer.enabled = YES;
+    
+    __block Promise *child = nil;
+    Promise *parent = [Promise promiseWithSetup:^(Promise *promise) {
+        child = [Promise resolved:nil];
+    }];
+    parent.traceName = @"parent";
+    parent.callbackQueue = nil;
+    
+    __block Promise *grandchild = nil;
+    [parent onCompletion:^(Promise *promise) {
+        grandchild = [Promise resolved:nil];
+    }];
+    [parent resolve:nil];
+    
+    tracer.enabled = NO;
+    
+    XCTAssertNotEqual(parent.traceId, 0, @"Failed traced");
+    XCTAssertEqual(child.parentTraceId, parent.traceId, @"Failed setup parent");
+    XCTAssertEqual(grandchild.parentTraceId, parent.traceId, @"Failed callback parent");
+    
+    NSDictionary *trace = [NSJSONSerialization JSONObjectWithData:[tracer chromeTraceJSON] options:0 error:nil];
+    NSArray *events = [trace objectForKey:@"traceEvents"];
+    
+    NSUInteger promiseEvents = 0, callbackEvents = 0;
+    for (NSDictionary *event in events) {
+        if ([[event objectForKey:@"cat"] isEqual:@"promise"]) {
+            promiseEvents++;
+        } else if ([[event objectForKey:@"cat"] isEqual:@"callback"]) {
+            XCTAssertEqualObjects([event objectForKey:@"name"], @"callback: parent", @"Failed callback name");
+            callbackEvents++;
+        }
+    }
+    
+    // A begin and end for each of the three promises
+    XCTAssertEqual(promiseEvents, 6, @"Failed promise events");
+    XCTAssertEqual(callbackEvents, 1, @"Failed callback events");
+    
+    [tracer removeAllEvents];
+    _assertionCount += 7;
+}
+
+@end
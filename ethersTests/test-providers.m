@@ -26,6 +26,7 @@
 #import <XCTest/XCTest.h>
 
 #import "ethers.h"
+#import "MockJsonRpcServer.h"
 
 
 @interface test_providers : XCTestCase {
@@ -35,6 +36,71 @@
 @end
 
 
+// Answers getBalance: (and getTransaction:) after a fixed delay, for exercising FallbackProvider strategies
+@interface DelayedProvider : Provider
+
+- (instancetype)initWithDelay: (NSTimeInterval)delay balance: (BigNumber*)balance;
+
+@property (atomic, strong) TransactionInfo *transactionInfo;
+
+@property (atomic, readonly) NSUInteger callCount;
+@property (atomic, readonly) NSUInteger cancelCount;
+
+// If non-zero, calls reject with this error code instead
+@property (atomic, assign) ProviderError failure;
+
+@end
+
+@implementation DelayedProvider {
+    NSTimeInterval _delay;
+    BigNumber *_balance;
+}
+
+- (instancetype)initWithDelay: (NSTimeInterval)delay balance: (BigNumber*)balance {
+    self = [super initWithChainId:ChainIdHomestead];
+    if (self) {
+        _delay = delay;
+        _balance = balance;
+    }
+    return self;
+}
+
+- (id)_delayedPromise: (Class)promiseClass result: (NSObject*)result {
+    @synchronized (self) {
+        _callCount++;
+    }
+    
+    return [(Promise*)[promiseClass alloc] initWithSetup:^(Promise *promise) {
+        [promise.cancellationToken onCancel:^() {
+            @synchronized (self) {
+                _cancelCount++;
+            }
+        }];
+        
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_delay * NSEC_PER_SEC)), dispatch_get_main_queue(), ^() {
+            if (promise.complete) { return; }
+            
+            ProviderError failure = self.failure;
+            if (failure) {
+                [promise reject:[NSError errorWithDomain:ProviderErrorDomain code:failure userInfo:@{}]];
+            } else {
+                [promise resolve:result];
+            }
+        });
+    }];
+}
+
+- (BigNumberPromise*)getBalance: (Address*)address blockTag: (BlockTag)blockTag {
+    return [self _delayedPromise:[BigNumberPromise class] result:_balance];
+}
+
+- (TransactionInfoPromise*)getTransaction: (Hash*)transactionHash {
+    return [self _delayedPromise:[TransactionInfoPromise class] result:self.transactionInfo];
+}
+
+@end
+
+
 @implementation test_providers
 
 - (void)setUp {
@@ -102,6 +168,15 @@
     }
 }
 
+// Spins until promise completes (or times out)
+- (void)waitForPromise: (Promise*)promise {
+    XCTestExpectation *expect = [self expectationWithDescription:@"Test/waitForPromise"];
+    [promise onCompletion:^(Promise *promise) {
+        [expect fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10.0f handler:nil];
+}
+
 - (void)testRopstenGetBlock {
     
     // @TODO: Move this into a JSON file and provider test cases for all networks
@@ -305,4 +380,707 @@
     }
 }
 
+- (void)testJsonRpcBatching {
+    MockJsonRpcServer *server = [MockJsonRpcServer server];
+    JsonRpcProvider *provider = [[JsonRpcProvider alloc] initWithChainId:ChainIdHomestead url:server.url];
+    
+    // Wait for the initial block number poll, so it is not part of any batch below
+    {
+        XCTestExpectation *expect = [self expectationWithDescription:@"Test/JsonRpcProvider/poll"];
+        [[provider getBlockNumber] onCompletion:^(IntegerPromise *promise) {
+            [expect fulfill];
+        }];
+        [self waitForExpectationsWithTimeout:10.0f handler:nil];
+    }
+    
+    // Refresh the balance and nonce of 500 addresses in one explicit batch
+    {
+        NSMutableArray<Promise*> *promises = [NSMutableArray array];
+        NSUInteger httpRequestCount = server.httpRequestCount;
+        NSDate *start = [NSDate date];
+        
+        [provider beginBatch];
+        for (int i = 0; i < 500; i++) {
+            unsigned char bytes[20] = { 0 };
+            bytes[18] = (i >> 8);
+            bytes[19] = i;
+            Address *address = [Address addressWithData:[NSData dataWithBytes:bytes length:sizeof(bytes)]];
+            [promises addObject:[provider getBalance:address]];
+            [promises addObject:[provider getTransactionCount:address]];
+        }
+        
+        // The batch only holds calls from this thread; others are still sent within the window
+        {
+            XCTestExpectation *expect = [self expectationWithDescription:@"Test/JsonRpcProvider/otherThread"];
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^() {
+                [[provider getGasPrice] onCompletion:^(BigNumberPromise *promise) {
+                    XCTAssertNil(promise.error, @"Call from another thread failed");
+                    [expect fulfill];
+                }];
+            });
+            [self waitForExpectationsWithTimeout:10.0f handler:nil];
+            _assertionCount++;
+        }
+        
+        [provider flush];
+        
+        XCTestExpectation *expect = [self expectationWithDescription:@"Test/JsonRpcProvider/batch"];
+        [[Promise all:promises] onCompletion:^(ArrayPromise *promise) {
+            XCTAssertNil(promise.error, @"Batch call failed");
+            NSLog(@"JsonRpcProvider: %d calls in %d requests, %.1fms", (int)promises.count,
+                  (int)(server.httpRequestCount - httpRequestCount), -1000.0f * [start timeIntervalSinceNow]);
+            [expect fulfill];
+        }];
+        [self waitForExpectationsWithTimeout:10.0f handler:nil];
+        
+        // 1,000 calls at the default 100 calls per batch, and the call from the other thread
+        XCTAssertEqual(server.httpRequestCount - httpRequestCount, 11, @"Wrong batch count");
+        XCTAssertEqualObjects(((BigNumberPromise*)promises[0]).value, [BigNumber bigNumberWithHexString:@"0xde0b6b3a7640000"], @"Wrong balance");
+        XCTAssertEqual(((IntegerPromise*)promises[1]).value, 7, @"Wrong nonce");
+        _assertionCount += 4;
+    }
+    
+    // Calls made together are coalesced automatically, and errors are matched to their call
+    {
+        NSUInteger httpRequestCount = server.httpRequestCount;
+        
+        XCTestExpectation *expect = [self expectationWithDescription:@"Test/JsonRpcProvider/coalesce"];
+        IntegerPromise *blockNumberPromise = [provider getBlockNumber];
+        BigNumberPromise *gasPricePromise = [provider getGasPrice];
+        HashPromise *storagePromise = [provider getStorageAt:[Address zeroAddress] position:[BigNumber constantZero]];
+        [[Promise allSettled:@[ blockNumberPromise, gasPricePromise, storagePromise ]] onCompletion:^(ArrayPromise *promise) {
+            [expect fulfill];
+        }];
+        [self waitForExpectationsWithTimeout:10.0f handler:nil];
+        
+        XCTAssertEqual(server.httpRequestCount - httpRequestCount, 1, @"Calls not coalesced");
+        XCTAssertEqual(blockNumberPromise.value, 1, @"Wrong block number");
+        XCTAssertEqualObjects(gasPricePromise.value, [BigNumber bigNumberWithDecimalString:@"20000000000"], @"Wrong gas price");
+        XCTAssertNotNil(storagePromise.error, @"Missing method error");
+        _assertionCount += 4;
+    }
+    
+    [server stop];
+}
+
+- (void)testSingleFlight {
+    MockJsonRpcServer *server = [MockJsonRpcServer server];
+    [server setResult:@"0x0000000000000000000000000000000000000000000000000000000000000001" forMethod:@"eth_sendRawTransaction"];
+    
+    JsonRpcProvider *provider = [[JsonRpcProvider alloc] initWithChainId:ChainIdHomestead url:server.url];
+    
+    {
+        XCTestExpectation *expect = [self expectationWithDescription:@"Test/JsonRpcProvider/poll"];
+        [[provider getBlockNumber] onCompletion:^(IntegerPromise *promise) {
+            [expect fulfill];
+        }];
+        [self waitForExpectationsWithTimeout:10.0f handler:nil];
+    }
+    
+    NSUInteger callCount = server.callCount;
+    
+    Address *address = [Address zeroAddress];
+    NSMutableArray<Promise*> *promises = [NSMutableArray array];
+    for (int i = 0; i < 5; i++) {
+        [promises addObject:[provider getBalance:address]];
+        [promises addObject:[provider getGasPrice]];
+    }
+    
+    // Cancelling one caller leaves the others sharing the request
+    BigNumberPromise *cancelled = [provider getBalance:address];
+    [cancelled cancel];
+    
+    // Writes are never shared
+    NSData *signedTransaction = [SecureData hexStringToData:@"0x1234"];
+    [promises addObject:[provider sendTransaction:signedTransaction]];
+    [promises addObject:[provider sendTransaction:signedTransaction]];
+    
+    XCTestExpectation *expect = [self expectationWithDescription:@"Test/JsonRpcProvider/singleFlight"];
+    [[Promise all:promises] onCompletion:^(ArrayPromise *promise) {
+        XCTAssertNil(promise.error, @"Shared call failed");
+        [expect fulfill];
+    }];
+    [self waitForExpectationsWithTimeout:10.0f handler:nil];
+    
+    XCTAssertEqual(server.callCount - callCount, 4, @"Calls not shared");
+    XCTAssertEqual(cancelled.error.code, PromiseErrorCancelled, @"Cancelled caller not cancelled");
+    XCTAssertEqualObjects(((BigNumberPromise*)promises[8]).value, ((BigNumberPromise*)promises[0]).value, @"Shared result mismatch");
+    _assertionCount += 4;
+    
+    [server stop];
+}
+
+- (void)testCachingProvider {
+    MockJsonRpcServer *server = [MockJsonRpcServer server];
+    JsonRpcProvider *jsonRpcProvider = [[JsonRpcProvider alloc] initWithChainId:ChainIdHomestead url:server.url];
+    CachingProvider *provider = [[CachingProvider alloc] initWithProvider:jsonRpcProvider];
+    
+    void (^newBlock)(NSInteger) = ^(NSInteger blockNumber) {
+        [[NSNotificationCenter defaultCenter] postNotificationName:ProviderDidReceiveNewBlockNotification
+                                                            object:jsonRpcProvider
+                                                          userInfo:@{@"blockNumber": @(blockNumber)}];
+    };
+    
+    [self waitForPromise:[jsonRpcProvider getBlockNumber]];
+    newBlock(100);
+    
+    Address *address = [Address zeroAddress];
+    NSUInteger callCount = server.callCount;
+    
+    // Latest results are kept until the next block
+    [self waitForPromise:[provider getBalance:address]];
+    [self waitForPromise:[provider getBalance:address]];
+    XCTAssertEqual(server.callCount - callCount, 1, @"Latest result not cached");
+    XCTAssertEqual(provider.hitCount, 1, @"Wrong hit count");
+    
+    newBlock(101);
+    [self waitForPromise:[provider getBalance:address]];
+    XCTAssertEqual(server.callCount - callCount, 2, @"Latest result not invalidated");
+    
+    // Results at a confirmed block are kept across blocks
+    [self waitForPromise:[provider getBalance:address blockTag:50]];
+    newBlock(102);
+    BigNumberPromise *cached = [provider getBalance:address blockTag:50];
+    [self waitForPromise:cached];
+    XCTAssertEqual(server.callCount - callCount, 3, @"Historic result not cached");
+    XCTAssertEqualObjects(cached.value, [BigNumber bigNumberWithHexString:@"0xde0b6b3a7640000"], @"Wrong cached value");
+    
+    // Pending results are never cached
+    [self waitForPromise:[provider getTransactionCount:address blockTag:BLOCK_TAG_PENDING]];
+    [self waitForPromise:[provider getTransactionCount:address blockTag:BLOCK_TAG_PENDING]];
+    XCTAssertEqual(server.callCount - callCount, 5, @"Pending result cached");
+    
+    // Evicted down to the byte limit
+    provider.maximumBytes = 256;
+    for (NSInteger blockTag = 0; blockTag < 10; blockTag++) {
+        [self waitForPromise:[provider getTransactionCount:address blockTag:blockTag]];
+    }
+    XCTAssertLessThanOrEqual(provider.cachedBytes, 256, @"Cache exceeds limit");
+    _assertionCount += 7;
+    
+    [server stop];
+}
+
+// Blocks only arrive from the wrapped provider itself here (nothing is posted by hand)
+- (void)testCachingProviderBlockTracking {
+    MockJsonRpcServer *server = [MockJsonRpcServer server];
+    Address *address = [Address zeroAddress];
+    
+    // The initial poll fails, so no block ever arrives
+    [server setResult:@"not a block number" forMethod:@"eth_blockNumber"];
+    JsonRpcProvider *jsonRpcProvider = [[JsonRpcProvider alloc] initWithChainId:ChainIdHomestead url:server.url];
+    CachingProvider *provider = [[CachingProvider alloc] initWithProvider:jsonRpcProvider];
+    [self waitForPromise:[jsonRpcProvider getBlockNumber]];
+    
+    NSUInteger callCount = server.callCount;
+    [self waitForPromise:[provider getBalance:address]];
+    [self waitForPromise:[provider getBalance:address]];
+    XCTAssertEqual(server.callCount - callCount, 2, @"Latest result cached without a block");
+    
+    // Once the provider has a block, latest results are cached
+    [server setResult:@"0x10" forMethod:@"eth_blockNumber"];
+    [self expectationForNotification:ProviderDidReceiveNewBlockNotification object:jsonRpcProvider handler:^BOOL(NSNotification *note) {
+        return ([[note.userInfo objectForKey:@"blockNumber"] integerValue] == 16);
+    }];
+    [jsonRpcProvider reset];
+    [self waitForExpectationsWithTimeout:10.0f handler:nil];
+    
+    callCount = server.callCount;
+    [self waitForPromise:[provider getBalance:address]];
+    [self waitForPromise:[provider getBalance:address]];
+    XCTAssertEqual(server.callCount - callCount, 1, @"Latest result not cached");
+    
+    // A null result (e.g. a block not yet mined) is cached too
+    [server setResult:[NSNull null] forMethod:@"eth_getBlockByNumber"];
+    callCount = server.callCount;
+    BlockInfoPromise *block = [provider getBlockByBlockTag:BLOCK_TAG_LATEST];
+    [self waitForPromise:block];
+    XCTAssertNil(block.error, @"Null result failed");
+    XCTAssertNil(block.value, @"Null result not nil");
+    
+    block = [provider getBlockByBlockTag:BLOCK_TAG_LATEST];
+    [self waitForPromise:block];
+    XCTAssertNil(block.value, @"Cached null result not nil");
+    XCTAssertEqual(server.callCount - callCount, 1, @"Null result not cached");
+    
+    // Without another block, they expire
+    provider.maximumBlockAge = 0.2;
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.3]];
+    [server setResult:@"0x2a" forMethod:@"eth_getBalance"];
+    
+    BigNumberPromise *balance = [provider getBalance:address];
+    [self waitForPromise:balance];
+    XCTAssertEqualObjects(balance.value, [BigNumber bigNumberWithInteger:42], @"Stale latest result");
+    _assertionCount += 7;
+    
+    [server stop];
+}
+
+- (void)testWebSocketProvider {
+    if (@available(iOS 13.0, *)) {
+        MockJsonRpcServer *server = [MockJsonRpcServer server];
+        WebSocketProvider *provider = [[WebSocketProvider alloc] initWithChainId:ChainIdHomestead url:server.webSocketUrl];
+        
+        // Callbacks are delivered on the main thread, so spin its run loop while waiting
+        BOOL (^waitUntil)(BOOL (^)(void)) = ^BOOL(BOOL (^done)(void)) {
+            NSDate *timeout = [NSDate dateWithTimeIntervalSinceNow:10.0];
+            while (!done()) {
+                if ([timeout timeIntervalSinceNow] < 0) { return NO; }
+                [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.05]];
+            }
+            return YES;
+        };
+        
+        __block NSInteger blockNumber = -1;
+        id observer = [[NSNotificationCenter defaultCenter] addObserverForName:ProviderDidReceiveNewBlockNotification
+                                                                        object:provider
+                                                                         queue:[NSOperationQueue mainQueue]
+                                                                    usingBlock:^(NSNotification *note) {
+            blockNumber = [[note.userInfo objectForKey:@"blockNumber"] integerValue];
+        }];
+        
+        // Concurrent requests share the one connection
+        IntegerPromise *transactionCount = [provider getTransactionCount:[Address zeroAddress]];
+        BigNumberPromise *gasPrice = [provider getGasPrice];
+        XCTAssertTrue(waitUntil(^BOOL() { return transactionCount.complete && gasPrice.complete; }), @"Requests timed out");
+        XCTAssertEqual(transactionCount.value, 7, @"Wrong transaction count");
+        XCTAssertEqualObjects(gasPrice.value, [BigNumber bigNumberWithHexString:@"0x4a817c800"], @"Wrong gas price");
+        XCTAssertEqual(server.httpRequestCount, 0, @"Request sent over HTTP");
+        
+        // New blocks are pushed (repeated until the subscription is in place)
+        XCTAssertTrue(waitUntil(^BOOL() {
+            [server pushNewHead:100];
+            return (blockNumber == 100);
+        }), @"New head not received");
+        XCTAssertTrue(provider.connected, @"Not connected");
+        
+        __block NSDictionary *receivedLog = nil;
+        NSString *identifier = [provider subscribeLogs:@{ @"address": [Address zeroAddress].checksumAddress } callback:^(NSDictionary *log) {
+            receivedLog = log;
+        }];
+        XCTAssertTrue(waitUntil(^BOOL() {
+            [server pushLog:@{ @"logIndex": @"0x1" }];
+            return [receivedLog isEqual:@{ @"logIndex": @"0x1" }];
+        }), @"Log not received");
+        
+        // Subscriptions are re-created after the connection drops
+        [server dropConnections];
+        XCTAssertTrue(waitUntil(^BOOL() {
+            [server pushLog:@{ @"logIndex": @"0x2" }];
+            return [receivedLog isEqual:@{ @"logIndex": @"0x2" }];
+        }), @"Log subscription not re-created");
+        XCTAssertTrue(waitUntil(^BOOL() {
+            [server pushNewHead:101];
+            return (blockNumber == 101);
+        }), @"Head subscription not re-created");
+        
+        [provider unsubscribe:identifier];
+        [provider disconnect];
+        XCTAssertTrue(waitUntil(^BOOL() { return !provider.connected; }), @"Not disconnected");
+        _assertionCount += 11;
+        
+        [[NSNotificationCenter defaultCenter] removeObserver:observer];
+        [server stop];
+    }
+}
+
+- (void)testIpcProvider {
+    MockJsonRpcServer *server = [MockJsonRpcServer server];
+    IpcProvider *ipcProvider = [[IpcProvider alloc] initWithChainId:ChainIdHomestead path:server.ipcPath];
+    JsonRpcProvider *httpProvider = [[JsonRpcProvider alloc] initWithChainId:ChainIdHomestead url:server.url];
+    
+    // Pipelined calls are matched to their responses, including errors
+    IntegerPromise *transactionCount = [ipcProvider getTransactionCount:[Address zeroAddress]];
+    BigNumberPromise *gasPrice = [ipcProvider getGasPrice];
+    HashPromise *storage = [ipcProvider getStorageAt:[Address zeroAddress] position:[BigNumber constantZero]];
+    [self waitForPromise:[Promise allSettled:@[ transactionCount, gasPrice, storage ]]];
+    XCTAssertEqual(transactionCount.value, 7, @"Wrong transaction count");
+    XCTAssertEqualObjects(gasPrice.value, [BigNumber bigNumberWithHexString:@"0x4a817c800"], @"Wrong gas price");
+    XCTAssertNotNil(storage.error, @"Missing method error");
+    _assertionCount += 3;
+    
+    // Compare sequential round trips and pipelined calls against HTTP on the same host,
+    // without the batching window, so each call is its own request (distinct addresses,
+    // so identical calls are not shared)
+    NSMutableArray<Address*> *addresses = [NSMutableArray arrayWithCapacity:1000];
+    for (int i = 0; i < 1000; i++) {
+        unsigned char bytes[20] = { 0 };
+        bytes[18] = (i >> 8);
+        bytes[19] = i;
+        [addresses addObject:[Address addressWithData:[NSData dataWithBytes:bytes length:sizeof(bytes)]]];
+    }
+    
+    ipcProvider.batchWindow = 0;
+    httpProvider.batchWindow = 0;
+    [self waitForPromise:[httpProvider getBlockNumber]];
+    
+    for (JsonRpcProvider *provider in @[ httpProvider, ipcProvider ]) {
+        NSUInteger callCount = server.callCount;
+        
+        NSDate *start = [NSDate date];
+        for (int i = 0; i < 200; i++) { [self waitForPromise:[provider getGasPrice]]; }
+        NSTimeInterval sequential = -[start timeIntervalSinceNow];
+        
+        NSMutableArray<Promise*> *promises = [NSMutableArray arrayWithCapacity:1000];
+        start = [NSDate date];
+        for (Address *address in addresses) { [promises addObject:[provider getBalance:address]]; }
+        ArrayPromise *all = [Promise all:promises];
+        [self waitForPromise:all];
+        NSTimeInterval pipelined = -[start timeIntervalSinceNow];
+        
+        XCTAssertNil(all.error, @"Call failed");
+        XCTAssertEqual(server.callCount - callCount, 1200, @"Wrong call count");
+        NSLog(@"%@: %.1fus per sequential call, %.1fus per pipelined call", NSStringFromClass([provider class]),
+              1000000.0f * sequential / 200.0f, 1000000.0f * pipelined / 1000.0f);
+        _assertionCount += 2;
+    }
+    
+    // The connection is re-established after the node drops it
+    [server dropConnections];
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
+    IntegerPromise *blockNumber = [ipcProvider getBlockNumber];
+    [self waitForPromise:blockNumber];
+    XCTAssertEqual(blockNumber.value, 1, @"Did not reconnect");
+    _assertionCount += 1;
+    
+    [server stop];
+}
+
+- (void)testFallbackProviderStrategies {
+    BigNumber *one = [BigNumber bigNumberWithInteger:1], *two = [BigNumber bigNumberWithInteger:2];
+    
+    BigNumberPromise* (^getBalance)(FallbackProvider*, NSTimeInterval*) = ^BigNumberPromise*(FallbackProvider *provider, NSTimeInterval *duration) {
+        XCTestExpectation *expect = [self expectationWithDescription:@"Test/FallbackProvider"];
+        NSDate *start = [NSDate date];
+        BigNumberPromise *promise = [provider getBalance:[Address zeroAddress]];
+        [promise onCompletion:^(BigNumberPromise *promise) {
+            [expect fulfill];
+        }];
+        [self waitForExpectationsWithTimeout:10.0f handler:nil];
+        *duration = -[start timeIntervalSinceNow];
+        return promise;
+    };
+    
+    // A slow first provider is hedged against, then cancelled
+    {
+        DelayedProvider *slow = [[DelayedProvider alloc] initWithDelay:3.0 balance:one];
+        DelayedProvider *fast = [[DelayedProvider alloc] initWithDelay:0.01 balance:two];
+        
+        FallbackProvider *provider = [[FallbackProvider alloc] initWithChainId:ChainIdHomestead];
+        [provider addProvider:slow];
+        [provider addProvider:fast];
+        provider.strategy = FallbackProviderStrategyHedged;
+        provider.hedgeDelay = 0.1;
+        
+        NSTimeInterval duration = 0;
+        BigNumberPromise *promise = getBalance(provider, &duration);
+        XCTAssertEqualObjects(promise.value, two, @"Hedged request did not win");
+        XCTAssertLessThan(duration, 1.0, @"Hedged request not sent in time");
+        XCTAssertEqual(slow.cancelCount, 1, @"Slow request not cancelled");
+        _assertionCount += 3;
+    }
+    
+    // Every provider is asked at once
+    {
+        DelayedProvider *slow = [[DelayedProvider alloc] initWithDelay:3.0 balance:one];
+        DelayedProvider *fast = [[DelayedProvider alloc] initWithDelay:0.01 balance:two];
+        
+        FallbackProvider *provider = [[FallbackProvider alloc] initWithChainId:ChainIdHomestead];
+        [provider addProvider:slow];
+        [provider addProvider:fast];
+        provider.strategy = FallbackProviderStrategyRace;
+        
+        NSTimeInterval duration = 0;
+        BigNumberPromise *promise = getBalance(provider, &duration);
+        XCTAssertEqualObjects(promise.value, two, @"Fastest provider did not win");
+        XCTAssertLessThan(duration, 0.5, @"Race waited for the slow provider");
+        XCTAssertEqual(slow.cancelCount, 1, @"Slow request not cancelled");
+        _assertionCount += 3;
+    }
+    
+    // The fastest result is ignored until a majority agree
+    {
+        DelayedProvider *wrong = [[DelayedProvider alloc] initWithDelay:0.01 balance:two];
+        DelayedProvider *right = [[DelayedProvider alloc] initWithDelay:0.05 balance:one];
+        DelayedProvider *rightSlow = [[DelayedProvider alloc] initWithDelay:0.1 balance:one];
+        DelayedProvider *slowest = [[DelayedProvider alloc] initWithDelay:3.0 balance:one];
+        
+        FallbackProvider *provider = [[FallbackProvider alloc] initWithChainId:ChainIdHomestead];
+        for (Provider *child in @[ wrong, right, rightSlow ]) { [provider addProvider:child]; }
+        provider.strategy = FallbackProviderStrategyQuorum;
+        
+        NSTimeInterval duration = 0;
+        BigNumberPromise *promise = getBalance(provider, &duration);
+        XCTAssertEqualObjects(promise.value, one, @"Wrong quorum result");
+        
+        // A larger quorum must wait for more providers
+        [provider addProvider:slowest];
+        provider.quorum = 4;
+        promise = getBalance(provider, &duration);
+        XCTAssertNotNil(promise.error, @"Quorum reached without agreement");
+        XCTAssertEqual(slowest.callCount, 1, @"Provider not called");
+        _assertionCount += 3;
+    }
+    
+    // A pending and a mined copy of the same transaction do not agree
+    {
+        NSDictionary *pendingInfo = @{
+                                      @"hash": @"0x88df016429689c079f3b2f6ad39fa052532c56795b733da78a91ebe6a713944b",
+                                      @"timestamp": @"0",
+                                      @"from": [Address zeroAddress].checksumAddress,
+                                      @"to": [Address zeroAddress].checksumAddress,
+                                      @"gasLimit": @"21000",
+                                      @"gasPrice": @"20000000000",
+                                      @"nonce": @"0",
+                                      @"data": @"0x",
+                                      @"value": @"0",
+                                      };
+        NSMutableDictionary *minedInfo = [pendingInfo mutableCopy];
+        [minedInfo setObject:@"0xc5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470" forKey:@"blockHash"];
+        [minedInfo setObject:@"42" forKey:@"blockNumber"];
+        
+        DelayedProvider *mined = [[DelayedProvider alloc] initWithDelay:0.01 balance:one];
+        DelayedProvider *pending = [[DelayedProvider alloc] initWithDelay:0.05 balance:one];
+        DelayedProvider *minedSlow = [[DelayedProvider alloc] initWithDelay:0.1 balance:one];
+        mined.transactionInfo = [TransactionInfo transactionInfoFromDictionary:minedInfo];
+        pending.transactionInfo = [TransactionInfo transactionInfoFromDictionary:pendingInfo];
+        minedSlow.transactionInfo = [TransactionInfo transactionInfoFromDictionary:minedInfo];
+        
+        FallbackProvider *provider = [[FallbackProvider alloc] initWithChainId:ChainIdHomestead];
+        for (Provider *child in @[ mined, pending, minedSlow ]) { [provider addProvider:child]; }
+        provider.strategy = FallbackProviderStrategyQuorum;
+        
+        XCTestExpectation *expect = [self expectationWithDescription:@"Test/FallbackProvider/quorumTransaction"];
+        TransactionInfoPromise *promise = [provider getTransaction:mined.transactionInfo.transactionHash];
+        [promise onCompletion:^(TransactionInfoPromise *promise) {
+            [expect fulfill];
+        }];
+        [self waitForExpectationsWithTimeout:10.0f handler:nil];
+        
+        XCTAssertEqual(promise.value.blockNumber, 42, @"Pending transaction counted towards quorum");
+        _assertionCount++;
+    }
+}
+
+- (void)testFallbackProviderAdaptive {
+    DelayedProvider *flaky = [[DelayedProvider alloc] initWithDelay:0.01 balance:[BigNumber constantZero]];
+    DelayedProvider *steady = [[DelayedProvider alloc] initWithDelay:0.05 balance:[BigNumber constantZero]];
+    
+    FallbackProvider *provider = [[FallbackProvider alloc] initWithChainId:ChainIdHomestead];
+    [provider addProvider:flaky];
+    [provider addProvider:steady];
+    provider.adaptive = YES;
+    provider.ejectionThreshold = 2;
+    provider.ejectionDuration = 0.5;
+    
+    void (^wait)(void) = ^() {
+        XCTestExpectation *expect = [self expectationWithDescription:@"Test/FallbackProvider/adaptive"];
+        [[provider getBalance:[Address zeroAddress]] onCompletion:^(BigNumberPromise *promise) {
+            XCTAssertNil(promise.error, @"Call failed");
+            [expect fulfill];
+        }];
+        [self waitForExpectationsWithTimeout:10.0f handler:nil];
+    };
+    
+    // The faster provider ranks first
+    wait();
+    wait();
+    XCTAssertEqualObjects([provider rankedProviders], (@[ flaky, steady ]), @"Faster provider not first");
+    
+    // Failing, it falls behind and is then ejected
+    flaky.failure = ProviderErrorServerUnknownError;
+    wait();
+    XCTAssertEqualObjects([provider rankedProviders], (@[ steady, flaky ]), @"Failing provider not demoted");
+    
+    provider.strategy = FallbackProviderStrategyRace;
+    wait();
+    XCTAssertEqualObjects([provider rankedProviders], (@[ steady ]), @"Failing provider not ejected");
+    
+    NSUInteger callCount = flaky.callCount;
+    wait();
+    XCTAssertEqual(flaky.callCount, callCount, @"Ejected provider called");
+    
+    // Once the ejection expires it is probed, and restored once the probe succeeds
+    flaky.failure = 0;
+    [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.6]];
+    wait();
+    XCTAssertEqual(flaky.callCount, callCount + 1, @"Provider not probed");
+    XCTAssertEqual([provider rankedProviders].count, 2, @"Provider not restored");
+    
+    // Being throttled ejects it at once
+    flaky.failure = ProviderErrorThrottled;
+    wait();
+    XCTAssertEqualObjects([provider rankedProviders], (@[ steady ]), @"Throttled provider not ejected");
+    _assertionCount += 7;
+}
+
+- (void)testApiProviderScheduling {
+    MockJsonRpcServer *server = [MockJsonRpcServer server];
+    [server setResult:@"0x0000000000000000000000000000000000000000000000000000000000000001" forMethod:@"eth_sendRawTransaction"];
+    
+    JsonRpcProvider *provider = [[JsonRpcProvider alloc] initWithChainId:ChainIdHomestead url:server.url];
+    provider.batchWindow = 0;
+    
+    Address* (^address)(int) = ^Address*(int index) {
+        unsigned char bytes[20] = { 0 };
+        bytes[19] = index;
+        return [Address addressWithData:[NSData dataWithBytes:bytes length:sizeof(bytes)]];
+    };
+    
+    [self waitForPromise:[provider getBlockNumber]];
+    
+    // Requests are spaced out by the rate limit
+    {
+        provider.requestsPerSecond = 20;
+        provider.burstSize = 1;
+        provider.maximumConcurrentRequests = 2;
+        
+        NSMutableArray<Promise*> *promises = [NSMutableArray array];
+        NSDate *start = [NSDate date];
+        for (int i = 0; i < 10; i++) { [promises addObject:[provider getBalance:address(i)]]; }
+        
+        ArrayPromise *all = [Promise all:promises];
+        [self waitForPromise:all];
+        
+        XCTAssertNil(all.error, @"Call failed");
+        XCTAssertGreaterThan(-[start timeIntervalSinceNow], 0.4, @"Rate limit exceeded");
+        XCTAssertGreaterThanOrEqual(provider.peakQueuedRequestCount, 5, @"Requests not queued");
+        XCTAssertEqual(provider.queuedRequestCount, 0, @"Requests left queued");
+        _assertionCount += 4;
+    }
+    
+    // A transaction jumps ahead of background calls
+    {
+        provider.requestsPerSecond = 5;
+        
+        NSMutableArray<NSString*> *completed = [NSMutableArray array];
+        NSMutableArray<Promise*> *promises = [NSMutableArray array];
+        
+        [ApiProvider performWithPriority:ApiProviderPriorityBackground block:^() {
+            for (int i = 0; i < 5; i++) {
+                BigNumberPromise *promise = [provider getBalance:address(100 + i)];
+                [promise onCompletion:^(BigNumberPromise *promise) {
+                    [completed addObject:@"background"];
+                }];
+                [promises addObject:promise];
+            }
+        }];
+        
+        unsigned char transaction[] = { 0xc0 };
+        HashPromise *sendPromise = [provider sendTransaction:[NSData dataWithBytes:transaction length:sizeof(transaction)]];
+        [sendPromise onCompletion:^(HashPromise *promise) {
+            [completed addObject:@"transaction"];
+        }];
+        [promises addObject:sendPromise];
+        
+        [self waitForPromise:[Promise allSettled:promises]];
+        
+        XCTAssertNil(sendPromise.error, @"Transaction failed");
+        XCTAssertLessThanOrEqual([completed indexOfObject:@"transaction"], 2, @"Transaction not prioritized");
+        _assertionCount += 2;
+    }
+    
+    [server stop];
+}
+
+- (void)testProviderMetrics {
+    
+    // Percentiles of 1ms through 1000ms are within the histogram's precision
+    {
+        LatencyHistogram *histogram = [LatencyHistogram histogram];
+        for (int i = 1; i <= 1000; i++) { [histogram recordValue:(i / 1000.0)]; }
+        
+        XCTAssertEqual(histogram.count, 1000, @"Wrong count");
+        XCTAssertEqualWithAccuracy([histogram valueAtPercentile:50], 0.5, 0.01, @"Wrong p50");
+        XCTAssertEqualWithAccuracy([histogram valueAtPercentile:99], 0.99, 0.02, @"Wrong p99");
+        XCTAssertEqualWithAccuracy(histogram.maximum, 1.0, 0.0001, @"Wrong maximum");
+        _assertionCount += 4;
+    }
+    
+    MockJsonRpcServer *server = [MockJsonRpcServer server];
+    
+    JsonRpcProvider *provider = [[JsonRpcProvider alloc] initWithChainId:ChainIdHomestead url:server.url];
+    
+    [self waitForPromise:[provider getBlockNumber]];
+    [provider.metrics reset];
+    
+    Address *address = [Address addressWithString:@"0x06B5955A67D827CDF91823E3bB8F069e6c89c1D6"];
+    
+    // Identical calls share a request; an unsupported method fails
+    NSMutableArray<Promise*> *promises = [NSMutableArray array];
+    for (int i = 0; i < 3; i++) { [promises addObject:[provider getBalance:address]]; }
+    [promises addObject:[provider getGasPrice]];
+    IntegerPromise *unsupported = [provider sendMethod:@"eth_unsupported" params:@[] fetchType:ApiProviderFetchTypeIntegerHexString];
+    [promises addObject:unsupported];
+    
+    [self waitForPromise:[Promise allSettled:promises]];
+    
+    ProviderMetricsSnapshot *snapshot = [provider.metrics snapshot];
+    ProviderMethodMetrics *getBalance = [snapshot.methods objectForKey:@"eth_getBalance"];
+    ProviderMethodMetrics *failed = [snapshot.methods objectForKey:@"eth_unsupported"];
+    
+    XCTAssertEqual(getBalance.requestCount, 1, @"Shared calls counted as requests");
+    XCTAssertEqual(getBalance.sharedCount, 2, @"Shared calls not counted");
+    XCTAssertEqual(getBalance.inFlightCount, 0, @"Call still in flight");
+    XCTAssertEqual(getBalance.latency.count, 1, @"Latency not recorded");
+    XCTAssertEqual(snapshot.total.requestCount, 3, @"Wrong total");
+    XCTAssertEqual(failed.errorCount, 1, @"Error not counted");
+    XCTAssertEqualObjects([failed.errorCounts objectForKey:@(ProviderErrorBadResponse)], @(1), @"Error code not counted");
+    XCTAssertGreaterThan(snapshot.transferCount, 0, @"Transfers not counted");
+    XCTAssertGreaterThan(snapshot.bytesSent, 0, @"Bytes sent not counted");
+    XCTAssertGreaterThan(snapshot.bytesReceived, 0, @"Bytes received not counted");
+    XCTAssertEqualObjects([snapshot.gauges objectForKey:@"queued_requests"], @(0), @"Gauge missing");
+    _assertionCount += 11;
+    
+    NSString *text = [snapshot prometheusText];
+    XCTAssertTrue([text containsString:@"# TYPE ethers_provider_requests_total counter\n"], @"Missing type");
+    XCTAssertTrue([text containsString:@"ethers_provider_requests_total{provider=\"JsonRpcProvider\",method=\"eth_getBalance\"} 1\n"], @"Missing requests");
+    XCTAssertTrue([text containsString:@"ethers_provider_errors_total{provider=\"JsonRpcProvider\",method=\"eth_unsupported\",error=\"bad_response\"} 1\n"], @"Missing errors");
+    XCTAssertTrue([text containsString:@"ethers_provider_request_duration_seconds_count{provider=\"JsonRpcProvider\",method=\"eth_getBalance\"} 1\n"], @"Missing latency");
+    _assertionCount += 4;
+    
+    // Cache hits and misses are recorded by method
+    CachingProvider *cachingProvider = [[CachingProvider alloc] initWithProvider:provider];
+    [self waitForPromise:[cachingProvider getBlockByBlockHash:[Hash zeroHash]]];
+    [self waitForPromise:[cachingProvider getBlockByBlockHash:[Hash zeroHash]]];
+    
+    ProviderMethodMetrics *getBlock = [[cachingProvider.metrics snapshot].methods objectForKey:@"getBlock"];
+    XCTAssertEqual(getBlock.cacheHitCount + getBlock.cacheMissCount, 2, @"Cache lookups not counted");
+    _assertionCount++;
+    
+    [server stop];
+}
+
+- (void)testQueryPath {
+    NSDictionary *response = @{ @"result": @[ @{ @"nonce": @"0x2a", @"balance": @"1000" } ] };
+    
+    XCTAssertEqualObjects(queryPath(response, @"dictionary:result/array:0/dictionary:nonce/integerHex"), @(42), @"Failed hex integer");
+    XCTAssertEqualObjects(queryPath(response, @"dictionary:result/array:0/dictionary:balance/bigNumberDecimal"),
+                          [BigNumber bigNumberWithInteger:1000], @"Failed decimal BigNumber");
+    XCTAssertNil(queryPath(response, @"dictionary:result/array:1/dictionary:nonce/integerHex"), @"Failed out of range index");
+    XCTAssertNil(queryPath(response, @"dictionary:missing/integer"), @"Failed missing key");
+    XCTAssertNil([QueryPath queryPathWithString:@"dictionary:a:b/integer"], @"Failed invalid path");
+    XCTAssertEqual([QueryPath queryPathWithString:@"dictionary:result/array"], [QueryPath queryPathWithString:@"dictionary:result/array"], @"Failed cache");
+    _assertionCount += 6;
+}
+
+- (void)testBlockInfoParsingPerformance {
+    NSDictionary *info = @{
+                           @"hash": @"0x8a79ebd3b5cf4a51a17e9bc1e2fd6e6b1db2a04ff50b1d9b9e41e8c8a5cbab6b",
+                           @"number": @"0x4b7",
+                           @"parentHash": @"0x0d4b7fc6a5c3b4a51a17e9bc1e2fd6e6b1db2a04ff50b1d9b9e41e8c8a5cbab6",
+                           @"timestamp": @"0x55ba467c",
+                           @"nonce": @"0x1",
+                           @"extraData": @"0x476574682f76312e302e302f6c696e75782f676f312e342e32",
+                           @"gasLimit": @"0x1388",
+                           @"gasUsed": @"0x0",
+                           };
+    
+    [self measureBlock:^{
+        for (NSInteger i = 0; i < 1000; i++) {
+            XCTAssertNotNil([BlockInfo blockInfoFromDictionary:info]);
+        }
+    }];
+}
+
 @end
@@ -0,0 +1,153 @@
+/**
+ *  MIT License
+ *
+ *  Copyright (c) 2017 Richard Moore <me@ricmoo.com>
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining
+ *  a copy of this software and associated documentation files (the
+ *  "Software"), to deal in the Software without restriction, including
+ *  without limitation the rights to use, copy, modify, merge, publish,
+ *  distribute, sublicense, and/or sell copies of the Software, and to
+ *  permit persons to whom the Software is furnished to do so, subject to
+ *  the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included
+ *  in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ *  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+#import <XCTest/XCTest.h>
+
+#import "ethers.h"
+
+
+@interface test_securedata : XCTestCase {
+    int _assertionCount;
+}
+
+@end
+
+@implementation test_securedata
+
+- (void)setUp {
+    [super setUp];
+    _assertionCount = 0;
+}
+
+- (void)tearDown {
+    [super tearDown];
+    NSLog(@"test-securedata: Finished %d assertions.", _assertionCount);
+}
+
+- (NSData*)randomDataWithLength: (NSUInteger)length {
+    NSMutableData *data = [NSMutableData dataWithLength:length];
+    arc4random_buf(data.mutableBytes, length);
+    return data;
+}
+
+- (void)testHexRoundTrip {
+    
+    // Cover the vector loops and the scalar tails at every length
+    for (NSUInteger length = 0; length < 200; length++) {
+        NSData *data = [self randomDataWithLength:length];
+        
+        NSMutableString *expected = [NSMutableString stringWithString:@"0x"];
+        const uint8_t *bytes = data.bytes;
+        for (NSUInteger i = 0; i < length; i++) { [expected appendFormat:@"%02x", bytes[i]]; }
+        
+        NSString *hexString = [SecureData dataToHexString:data];
+        XCTAssertEqualObjects(hexString, expected, @"Failed encode: %d", (int)length);
+        XCTAssertEqualObjects([SecureData hexStringToData:hexString], data, @"Failed decode: %d", (int)length);
+        XCTAssertEqualObjects([SecureData hexStringToData:[@"0x" stringByAppendingString:[[hexString substringFromIndex:2] uppercaseString]]],
+                              data, @"Failed decode uppercase: %d", (int)length);
+        XCTAssertEqualObjects([SecureData secureDataWithHexString:hexString].hexString, hexString, @"Failed secure data: %d", (int)length);
+        _assertionCount += 4;
+    }
+}
+
+- (void)testInvalidHex {
+    NSString *valid = [SecureData dataToHexString:[self randomDataWithLength:64]];
+    
+    // Place a bad character in each position, so both the vector and scalar paths reject it
+    NSArray *badCharacters = @[ @"g", @"G", @"/", @":", @"@", @"`", @" ", @"é" ];
+    for (NSUInteger i = 2; i < valid.length; i += 7) {
+        for (NSString *badCharacter in badCharacters) {
+            NSString *invalid = [valid stringByReplacingCharactersInRange:NSMakeRange(i, 1) withString:badCharacter];
+            XCTAssertNil([SecureData hexStringToData:invalid], @"Failed invalid: %@", invalid);
+            _assertionCount++;
+        }
+    }
+    
+    XCTAssertNil([SecureData hexStringToData:@"1234"], @"Failed missing prefix");
+    XCTAssertNil([SecureData hexStringToData:@"0x123"], @"Failed odd length");
+    XCTAssertNil([SecureData hexStringToData:nil], @"Failed nil");
+    XCTAssertEqualObjects([SecureData hexStringToData:@"0x"], [NSData data], @"Failed empty");
+    _assertionCount += 4;
+}
+
+- (void)testSecureAllocations {
+    
+    // Enough small values to exhaust the secure arena and spill onto the heap
+    NSMutableArray<SecureData*> *values = [NSMutableArray array];
+    NSMutableArray<NSData*> *expected = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 5000; i++) {
+        NSData *data = [self randomDataWithLength:1 + (i % 160)];
+        [expected addObject:data];
+        [values addObject:[SecureData secureDataWithData:data]];
+    }
+    
+    // Grow a few, which moves them between slot sizes (or out of the arena)
+    for (NSUInteger i = 0; i < values.count; i += 50) {
+        [[values objectAtIndex:i] appendData:[expected objectAtIndex:i]];
+    }
+    
+    BOOL matches = YES;
+    for (NSUInteger i = 0; i < values.count; i++) {
+        NSMutableData *data = [[expected objectAtIndex:i] mutableCopy];
+        if ((i % 50) == 0) { [data appendData:[expected objectAtIndex:i]]; }
+        if (![[values objectAtIndex:i] isEqual:data]) { matches = NO; }
+    }
+    XCTAssertTrue(matches, @"Failed secure allocations");
+    _assertionCount++;
+    
+    // Released slots are reused
+    [values removeAllObjects];
+    SecureData *secureData = [SecureData secureDataWithHexString:@"0x0123456789abcdef"];
+    XCTAssertEqualObjects(secureData.hexString, @"0x0123456789abcdef", @"Failed reused allocation");
+    _assertionCount++;
+}
+
+- (void)measureHexWithLength: (NSUInteger)length iterations: (NSUInteger)iterations {
+    NSData *data = [self randomDataWithLength:length];
+    NSString *hexString = [SecureData dataToHexString:data];
+    
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < iterations; i++) {
+            @autoreleasepool {
+                [SecureData dataToHexString:data];
+                [SecureData hexStringToData:hexString];
+            }
+        }
+    }];
+}
+
+- (void)testHexPerformance32B {
+    [self measureHexWithLength:32 iterations:100000];
+}
+
+- (void)testHexPerformance1KB {
+    [self measureHexWithLength:1024 iterations:10000];
+}
+
+- (void)testHexPerformance64KB {
+    [self measureHexWithLength:65536 iterations:200];
+}
+
+@end
@@ -219,4 +219,94 @@
     }
 }
 
+- (void)testCompactTransaction {
+    Account *account = [Account accountWithPrivateKey:[SecureData hexStringToData:@"0x0123456789012345678901234567890123456789012345678901234567890123"]];
+    TransactionDataArena *arena = [TransactionDataArena arena];
+
+    Transaction *transaction = [Transaction transaction];
+    transaction.nonce = 7;
+    transaction.gasPrice = [BigNumber bigNumberWithDecimalString:@"20000000000"];
+    transaction.gasLimit = [BigNumber bigNumberWithDecimalString:@"50000"];
+    transaction.toAddress = account.address;
+    transaction.value = [BigNumber constantWeiPerEther];
+    transaction.data = [SecureData hexStringToData:@"0xa9059cbb0000000000000000000000000000000000000000000000000000000000000001"];
+    transaction.chainId = ChainIdHomestead;
+    
+    // Unsigned, there is no hash
+    CompactTransaction *unsignedTransaction = [CompactTransaction compactTransactionWithTransaction:transaction arena:arena];
+    XCTAssertEqualObjects([unsignedTransaction serialize], [transaction serialize], @"Failed unsigned compact serialize");
+    XCTAssertNil(unsignedTransaction.transactionHash, @"Failed unsigned compact transactionHash");
+    _assertionCount += 2;
+    
+    [account sign:transaction];
+    CompactTransaction *compactTransaction = [CompactTransaction compactTransactionWithTransaction:transaction arena:arena];
+    
+    // Fields round-trip through the inline storage and the arena
+    XCTAssertEqual(compactTransaction.nonce, 7, @"Failed compact nonce");
+    XCTAssertEqualObjects(compactTransaction.gasLimit, transaction.gasLimit, @"Failed compact gasLimit");
+    XCTAssertEqualObjects(compactTransaction.value, transaction.value, @"Failed compact value");
+    XCTAssertEqualObjects(compactTransaction.data, transaction.data, @"Failed compact data");
+    XCTAssertEqualObjects(compactTransaction.fromAddress, account.address, @"Failed compact fromAddress");
+    XCTAssertEqual(arena.usedBytes, 2 * transaction.data.length, @"Failed compact arena");
+    _assertionCount += 6;
+    
+    // The encodings match the Transaction, and are computed once
+    NSData *serialized = [compactTransaction serialize];
+    Hash *transactionHash = compactTransaction.transactionHash;
+    XCTAssertEqualObjects(serialized, [transaction serialize], @"Failed compact serialize");
+    XCTAssertEqualObjects(transactionHash, transaction.transactionHash, @"Failed compact transactionHash");
+    XCTAssertTrue([compactTransaction serialize] == serialized, @"Failed cached compact serialize");
+    XCTAssertTrue(compactTransaction.transactionHash == transactionHash, @"Failed cached compact transactionHash");
+    _assertionCount += 4;
+    
+    // A parsed copy of the signed transaction is equal
+    Transaction *parsed = [Transaction transactionWithData:serialized];
+    XCTAssertEqualObjects(compactTransaction, [CompactTransaction compactTransactionWithTransaction:parsed arena:arena], @"Failed compact equality");
+    XCTAssertEqualObjects([compactTransaction transaction].transactionHash, transactionHash, @"Failed compact transaction");
+    _assertionCount += 2;
+}
+
+- (void)testCachedSerializationInvalidation {
+    Account *account = [Account accountWithPrivateKey:[SecureData hexStringToData:@"0x0123456789012345678901234567890123456789012345678901234567890123"]];
+
+    Transaction *transaction = [Transaction transaction];
+    transaction.nonce = 1;
+    transaction.gasPrice = [BigNumber bigNumberWithDecimalString:@"20000000000"];
+    transaction.gasLimit = [BigNumber bigNumberWithDecimalString:@"21000"];
+    transaction.toAddress = account.address;
+    transaction.value = [BigNumber constantWeiPerEther];
+    transaction.chainId = ChainIdHomestead;
+    
+    [account sign:transaction];
+    
+    NSData *serialized = [transaction serialize];
+    Hash *transactionHash = transaction.transactionHash;
+
+    // Repeated calls must be stable
+    XCTAssertEqualObjects(serialized, [transaction serialize], @"Failed cached serialize");
+    XCTAssertEqualObjects(transactionHash, transaction.transactionHash, @"Failed cached transactionHash");
+    _assertionCount += 2;
+    
+    // A copy carries the same signature and must serialize identically
+    Transaction *copied = [transaction copy];
+    XCTAssertEqualObjects(serialized, [copied serialize], @"Failed copied serialize");
+    _assertionCount++;
+
+    // Changing a field must invalidate the cached encodings
+    transaction.nonce = 2;
+    XCTAssertNotEqualObjects(serialized, [transaction serialize], @"Failed to invalidate serialize");
+    _assertionCount++;
+    
+    [account sign:transaction];
+    XCTAssertEqualObjects([Transaction transactionWithData:[transaction serialize]].fromAddress, account.address, @"Failed re-signed fromAddress");
+    XCTAssertNotEqualObjects(transactionHash, transaction.transactionHash, @"Failed to invalidate transactionHash");
+    _assertionCount += 2;
+
+    // Round-trip through the parser
+    Transaction *parsed = [Transaction transactionWithData:[transaction serialize]];
+    XCTAssertEqualObjects([parsed serialize], [transaction serialize], @"Failed parsed serialize");
+    XCTAssertEqualObjects(parsed.transactionHash, transaction.transactionHash, @"Failed parsed transactionHash");
+    _assertionCount += 2;
+}
+
 @end